@@ -0,0 +1,164 @@
+#define _GNU_SOURCE
+
+#include "atomic-wait.h"
+
+#include <stddef.h>
+
+#if PSNIP_ATOMIC_WAIT_METHOD == PSNIP_ATOMIC_WAIT_METHOD_FUTEX
+#  include <limits.h>
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#elif PSNIP_ATOMIC_WAIT_METHOD == PSNIP_ATOMIC_WAIT_METHOD_WAIT_ON_ADDRESS
+#  include <windows.h>
+#  if defined(_MSC_VER)
+#    pragma comment(lib, "Synchronization.lib")
+#  endif
+#elif PSNIP_ATOMIC_WAIT_METHOD == PSNIP_ATOMIC_WAIT_METHOD_CONDVAR
+#  include <pthread.h>
+#elif PSNIP_ATOMIC_WAIT_METHOD == PSNIP_ATOMIC_WAIT_METHOD_YIELD
+#  if defined(_WIN32)
+#    include <windows.h>
+#  elif defined(__unix__) || defined(__APPLE__)
+#    include <sched.h>
+#  endif
+#else
+#  error Unknown PSNIP_ATOMIC_WAIT_METHOD
+#endif
+
+#define PSNIP_ATOMIC_WAIT__CHANGED(object, expected) \
+  (psnip_atomic_int32_load_explicit (object, PSNIP_ATOMIC_ORDER_ACQUIRE) != (expected))
+
+#if PSNIP_ATOMIC_WAIT_METHOD == PSNIP_ATOMIC_WAIT_METHOD_FUTEX
+
+/* The kernel compares the value and goes to sleep atomically, so if
+ * someone changes it and calls wake between our load and the syscall,
+ * the syscall just returns EAGAIN. */
+#define PSNIP_ATOMIC_WAIT__FUTEX(object, op, value) \
+  syscall (SYS_futex, (int*) (object), op, (int) (value), NULL, NULL, 0)
+
+void
+psnip_atomic_int32_wait (psnip_atomic_int32* object, psnip_int32_t expected) {
+  while (!PSNIP_ATOMIC_WAIT__CHANGED(object, expected))
+    PSNIP_ATOMIC_WAIT__FUTEX(object, FUTEX_WAIT_PRIVATE, expected);
+}
+
+void
+psnip_atomic_int32_notify_one (psnip_atomic_int32* object) {
+  PSNIP_ATOMIC_WAIT__FUTEX(object, FUTEX_WAKE_PRIVATE, 1);
+}
+
+void
+psnip_atomic_int32_notify_all (psnip_atomic_int32* object) {
+  PSNIP_ATOMIC_WAIT__FUTEX(object, FUTEX_WAKE_PRIVATE, INT_MAX);
+}
+
+#elif PSNIP_ATOMIC_WAIT_METHOD == PSNIP_ATOMIC_WAIT_METHOD_WAIT_ON_ADDRESS
+
+void
+psnip_atomic_int32_wait (psnip_atomic_int32* object, psnip_int32_t expected) {
+  while (!PSNIP_ATOMIC_WAIT__CHANGED(object, expected))
+    WaitOnAddress ((volatile VOID*) object, &expected, sizeof(expected), INFINITE);
+}
+
+void
+psnip_atomic_int32_notify_one (psnip_atomic_int32* object) {
+  WakeByAddressSingle ((PVOID) object);
+}
+
+void
+psnip_atomic_int32_notify_all (psnip_atomic_int32* object) {
+  WakeByAddressAll ((PVOID) object);
+}
+
+#elif PSNIP_ATOMIC_WAIT_METHOD == PSNIP_ATOMIC_WAIT_METHOD_CONDVAR
+
+#if !defined(PSNIP_ATOMIC_WAIT_TABLE_SIZE)
+#  define PSNIP_ATOMIC_WAIT_TABLE_SIZE 64
+#endif
+
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} psnip_atomic_wait__table[PSNIP_ATOMIC_WAIT_TABLE_SIZE];
+static pthread_once_t psnip_atomic_wait__table_once = PTHREAD_ONCE_INIT;
+
+static void
+psnip_atomic_wait__table_init (void) {
+  size_t i;
+
+  for (i = 0 ; i < PSNIP_ATOMIC_WAIT_TABLE_SIZE ; i++) {
+    pthread_mutex_init (&(psnip_atomic_wait__table[i].mutex), NULL);
+    pthread_cond_init (&(psnip_atomic_wait__table[i].cond), NULL);
+  }
+}
+
+static size_t
+psnip_atomic_wait__slot (psnip_atomic_int32* object) {
+  /* The low bits are always zero; the multiplication mixes the rest
+   * into the high bits of the (32-bit) product, so neighbouring
+   * objects land in different slots as long as we use those.  Scaling
+   * the top 16 bits by the table size picks a slot from them without
+   * needing the size to be a power of two. */
+  const size_t addr = (size_t) object;
+  const unsigned long h = (unsigned long) (((addr >> 2) * 2654435761U) & 0xffffffffUL);
+  pthread_once (&psnip_atomic_wait__table_once, psnip_atomic_wait__table_init);
+  return (size_t) (((h >> 16) * PSNIP_ATOMIC_WAIT_TABLE_SIZE) >> 16);
+}
+
+/* Waiters check the value with the slot's mutex held, and notifiers
+ * take the same mutex before broadcasting, so a notification can't
+ * slip in between the check and pthread_cond_wait. */
+void
+psnip_atomic_int32_wait (psnip_atomic_int32* object, psnip_int32_t expected) {
+  const size_t slot = psnip_atomic_wait__slot (object);
+
+  if (PSNIP_ATOMIC_WAIT__CHANGED(object, expected))
+    return;
+
+  pthread_mutex_lock (&(psnip_atomic_wait__table[slot].mutex));
+  while (!PSNIP_ATOMIC_WAIT__CHANGED(object, expected))
+    pthread_cond_wait (&(psnip_atomic_wait__table[slot].cond), &(psnip_atomic_wait__table[slot].mutex));
+  pthread_mutex_unlock (&(psnip_atomic_wait__table[slot].mutex));
+}
+
+void
+psnip_atomic_int32_notify_all (psnip_atomic_int32* object) {
+  const size_t slot = psnip_atomic_wait__slot (object);
+
+  pthread_mutex_lock (&(psnip_atomic_wait__table[slot].mutex));
+  pthread_cond_broadcast (&(psnip_atomic_wait__table[slot].cond));
+  pthread_mutex_unlock (&(psnip_atomic_wait__table[slot].mutex));
+}
+
+/* Other addresses may share the condition variable, and if we only
+ * signalled one thread it might be waiting on one of those. */
+void
+psnip_atomic_int32_notify_one (psnip_atomic_int32* object) {
+  psnip_atomic_int32_notify_all (object);
+}
+
+#elif PSNIP_ATOMIC_WAIT_METHOD == PSNIP_ATOMIC_WAIT_METHOD_YIELD
+
+void
+psnip_atomic_int32_wait (psnip_atomic_int32* object, psnip_int32_t expected) {
+  while (!PSNIP_ATOMIC_WAIT__CHANGED(object, expected)) {
+#if defined(_WIN32)
+    SwitchToThread ();
+#elif defined(__unix__) || defined(__APPLE__)
+    sched_yield ();
+#endif
+  }
+}
+
+void
+psnip_atomic_int32_notify_one (psnip_atomic_int32* object) {
+  (void) object;
+}
+
+void
+psnip_atomic_int32_notify_all (psnip_atomic_int32* object) {
+  (void) object;
+}
+
+#endif
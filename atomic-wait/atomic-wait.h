@@ -0,0 +1,84 @@
+/* Waiting on Atomics (v1)
+ * Portable Snippets - https://github.com/nemequ/portable-snippets
+ * Created by Evan Nemerson <evan@nemerson.com>
+ *
+ *   To the extent possible under law, the authors have waived all
+ *   copyright and related or neighboring rights to this code.  For
+ *   details, see the Creative Commons Zero 1.0 Universal license at
+ *   https://creativecommons.org/publicdomain/zero/1.0/
+ *
+ * Block a thread until a psnip_atomic_int32 changes, like C++20's
+ * std::atomic<T>::wait:
+ *
+ *   void psnip_atomic_int32_wait(
+ *       psnip_atomic_int32* object,
+ *       psnip_int32_t expected);
+ *   void psnip_atomic_int32_notify_one(
+ *       psnip_atomic_int32* object);
+ *   void psnip_atomic_int32_notify_all(
+ *       psnip_atomic_int32* object);
+ *
+ * psnip_atomic_int32_wait returns once *object no longer equals
+ * expected (which may be immediately); the load is an acquire.  To wake
+ * waiters, store a new value and then call one of the notify
+ * functions.  Notifying when nobody is waiting is harmless, but it is
+ * not free, so you'll usually want to track whether there are any
+ * waiters in the value itself.
+ *
+ * The implementation (PSNIP_ATOMIC_WAIT_METHOD) is:
+ *
+ *   PSNIP_ATOMIC_WAIT_METHOD_FUTEX: Linux's futex syscall.
+ *   PSNIP_ATOMIC_WAIT_METHOD_WAIT_ON_ADDRESS: WaitOnAddress and
+ *     WakeByAddress* on Windows 8 and later.
+ *   PSNIP_ATOMIC_WAIT_METHOD_CONDVAR: a fixed-size table of pthread
+ *     mutexes and condition variables, indexed by a hash of the
+ *     address.  Since unrelated addresses may share a slot, notify_one
+ *     wakes everyone in the slot, too.
+ *   PSNIP_ATOMIC_WAIT_METHOD_YIELD: no way to sleep, so waiters yield
+ *     the thread between checks.
+ *
+ * You can define PSNIP_ATOMIC_WAIT_METHOD yourself (when compiling
+ * atomic-wait.c) to choose a different one.
+ */
+
+#if !defined(PSNIP_ATOMIC_WAIT_H)
+#define PSNIP_ATOMIC_WAIT_H
+
+#if !defined(PSNIP_ATOMIC_H)
+#  include "../atomic/atomic.h"
+#endif
+
+#if defined(PSNIP_ATOMIC_NOT_FOUND)
+#  error atomic-wait.h requires atomic operations
+#endif
+
+#define PSNIP_ATOMIC_WAIT_METHOD_FUTEX           1
+#define PSNIP_ATOMIC_WAIT_METHOD_WAIT_ON_ADDRESS 2
+#define PSNIP_ATOMIC_WAIT_METHOD_CONDVAR         3
+#define PSNIP_ATOMIC_WAIT_METHOD_YIELD           4
+
+#if !defined(PSNIP_ATOMIC_WAIT_METHOD)
+#  if defined(__linux__)
+#    define PSNIP_ATOMIC_WAIT_METHOD PSNIP_ATOMIC_WAIT_METHOD_FUTEX
+#  elif defined(_WIN32) && defined(_WIN32_WINNT) && (_WIN32_WINNT >= 0x0602)
+#    define PSNIP_ATOMIC_WAIT_METHOD PSNIP_ATOMIC_WAIT_METHOD_WAIT_ON_ADDRESS
+#  elif defined(__unix__) || defined(__APPLE__)
+#    define PSNIP_ATOMIC_WAIT_METHOD PSNIP_ATOMIC_WAIT_METHOD_CONDVAR
+#  else
+#    define PSNIP_ATOMIC_WAIT_METHOD PSNIP_ATOMIC_WAIT_METHOD_YIELD
+#  endif
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+void psnip_atomic_int32_wait       (psnip_atomic_int32* object, psnip_int32_t expected);
+void psnip_atomic_int32_notify_one (psnip_atomic_int32* object);
+void psnip_atomic_int32_notify_all (psnip_atomic_int32* object);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* !defined(PSNIP_ATOMIC_WAIT_H) */
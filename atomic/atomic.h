@@ -43,6 +43,117 @@
  *   psnip_int64_t psnip_atomic_int64_sub(
  *       psnip_atomic_int64* object,
  *       psnip_int64_t operand);
+ *   psnip_int64_t psnip_atomic_int64_exchange(
+ *       psnip_atomic_int64* object,
+ *       psnip_int64_t desired);
+ *   psnip_int64_t psnip_atomic_int64_fetch_add(
+ *       psnip_atomic_int64* object,
+ *       psnip_int64_t operand);
+ *   psnip_int64_t psnip_atomic_int64_fetch_sub(
+ *       psnip_atomic_int64* object,
+ *       psnip_int64_t operand);
+ *   psnip_int64_t psnip_atomic_int64_fetch_or(
+ *       psnip_atomic_int64* object,
+ *       psnip_int64_t operand);
+ *   psnip_int64_t psnip_atomic_int64_fetch_and(
+ *       psnip_atomic_int64* object,
+ *       psnip_int64_t operand);
+ *   psnip_int64_t psnip_atomic_int64_fetch_xor(
+ *       psnip_atomic_int64* object,
+ *       psnip_int64_t operand);
+ *   void psnip_atomic_fence(void);
+ *
+ * exchange and the fetch_* functions return the value the object held
+ * before the operation; add and sub are the same as fetch_add and
+ * fetch_sub.
+ *
+ * All of those are sequentially consistent.  Each also has an
+ * _explicit variant which takes the memory order(s) as extra
+ * arguments, one of PSNIP_ATOMIC_ORDER_RELAXED, _ACQUIRE, _RELEASE,
+ * _ACQ_REL or _SEQ_CST, with the same meaning as in C11:
+ *
+ *   psnip_int64_t psnip_atomic_int64_load_explicit(
+ *       psnip_atomic_int64* object,
+ *       int order);
+ *   void psnip_atomic_int64_store_explicit(
+ *       psnip_atomic_int64* object,
+ *       psnip_int64_t desired,
+ *       int order);
+ *   _Bool psnip_atomic_int64_compare_exchange_explicit(
+ *       psnip_atomic_int64* object,
+ *       psnip_int64_t* expected,
+ *       psnip_int64_t desired,
+ *       int success,
+ *       int failure);
+ *   psnip_int64_t psnip_atomic_int64_add_explicit(
+ *       psnip_atomic_int64* object,
+ *       psnip_int64_t operand,
+ *       int order);
+ *   psnip_int64_t psnip_atomic_int64_sub_explicit(
+ *       psnip_atomic_int64* object,
+ *       psnip_int64_t operand,
+ *       int order);
+ *   void psnip_atomic_fence_explicit(int order);
+ *
+ * As in C11, a load can't be RELEASE or ACQ_REL, a store can't be
+ * ACQUIRE or ACQ_REL, and the failure order of a compare & swap can't
+ * be RELEASE or ACQ_REL or stronger than the success order.  Backends
+ * which can't express a weaker order (GCC's __sync builtins, OpenMP)
+ * just ignore it and use the sequentially consistent version.
+ *
+ * There is also a pointer type, psnip_atomic_ptr, with load, store,
+ * compare_exchange and exchange (and their _explicit variants) which
+ * work the same way with void* values:
+ *
+ *   void* psnip_atomic_ptr_load(
+ *       psnip_atomic_ptr* object);
+ *   void psnip_atomic_ptr_store(
+ *       psnip_atomic_ptr* object,
+ *       void* desired);
+ *   _Bool psnip_atomic_ptr_compare_exchange(
+ *       psnip_atomic_ptr* object,
+ *       void** expected,
+ *       void* desired);
+ *   void* psnip_atomic_ptr_exchange(
+ *       psnip_atomic_ptr* object,
+ *       void* desired);
+ *
+ * psnip_atomic_int16 and psnip_atomic_int8 have all the same
+ * operations as the 32- and 64-bit types (s/64/16/ or s/64/8/).
+ * psnip_atomic_flag is a boolean initialized with
+ * PSNIP_ATOMIC_FLAG_INIT, which only supports:
+ *
+ *   _Bool psnip_atomic_flag_test_and_set(
+ *       psnip_atomic_flag* object);
+ *   void psnip_atomic_flag_clear(
+ *       psnip_atomic_flag* object);
+ *
+ * test_and_set sets the flag and returns its previous value.  Both
+ * have _explicit variants.
+ *
+ * Finally, where the hardware supports a double-width (128-bit)
+ * compare & swap PSNIP_ATOMIC_HAVE_UINT128 is defined, along with:
+ *
+ *   int psnip_atomic_uint128_compare_exchange(
+ *       psnip_atomic_uint128* object,
+ *       psnip_atomic_uint128* expected,
+ *       psnip_atomic_uint128 desired);
+ *   void psnip_atomic_uint128_load(
+ *       psnip_atomic_uint128* object,
+ *       psnip_atomic_uint128* value);
+ *
+ * psnip_atomic_uint128 is a 16-byte aligned struct with lo and hi
+ * psnip_uint64_t members (typically a pointer and an ABA counter).
+ * Both functions are sequentially consistent, and on failure
+ * compare_exchange stores the current value in *expected.  Since the
+ * only way to read 128 bits atomically on most CPUs is a CAS, the load
+ * writes to the object and can't be used on read-only memory.
+ *
+ * On x86_64 this uses cmpxchg16b, which a few very early x86_64 CPUs
+ * lack.  Unless you compile with -mcx16 (or anything which implies it)
+ * PSNIP_ATOMIC_UINT128_NEEDS_CX16 is defined, and you should check
+ * psnip_cpu_feature_check(PSNIP_CPU_FEATURE_X86_CX16) before using
+ * it.
  */
 
 #if !defined(PSNIP_ATOMIC_H)
@@ -52,14 +163,26 @@
    portable snippets. */
 #if \
   !defined(psnip_int64_t) || \
-  !defined(psnip_int32_t)
+  !defined(psnip_uint64_t) || \
+  !defined(psnip_int32_t) || \
+  !defined(psnip_int16_t) || \
+  !defined(psnip_int8_t)
 #  include <stdint.h>
 #  if !defined(psnip_int64_t)
 #    define psnip_int64_t int64_t
 #  endif
+#  if !defined(psnip_uint64_t)
+#    define psnip_uint64_t uint64_t
+#  endif
 #  if !defined(psnip_int32_t)
 #    define psnip_int32_t int32_t
 #  endif
+#  if !defined(psnip_int16_t)
+#    define psnip_int16_t int16_t
+#  endif
+#  if !defined(psnip_int8_t)
+#    define psnip_int8_t int8_t
+#  endif
 #endif
 
 #if !defined(PSNIP_ATOMIC_STATIC_INLINE)
@@ -98,7 +221,14 @@
 #define PSNIP_ATOMIC_IMPL_OPENMP 5
 #define PSNIP_ATOMIC_IMPL_C11 11
 
-#if defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+/* You can force a particular backend by defining PSNIP_ATOMIC_IMPL
+ * to one of the values above before including this header.  There is
+ * no check that the compiler actually supports it. */
+#if defined(PSNIP_ATOMIC_IMPL)
+#  if PSNIP_ATOMIC_IMPL == PSNIP_ATOMIC_IMPL_NONE
+#    define PSNIP_ATOMIC_NOT_FOUND
+#  endif
+#elif defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
 #  define PSNIP_ATOMIC_IMPL PSNIP_ATOMIC_IMPL_GCC
 #elif !defined(__INTEL_COMPILER) && defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_ATOMICS__)
 /* GCC 4.7 and 4.8 sets __STDC_VERSION__ to C11 (if compiling in C11
@@ -133,10 +263,24 @@
 #if PSNIP_ATOMIC_IMPL == PSNIP_ATOMIC_IMPL_C11
 
 #include <stdatomic.h>
-typedef atomic_int_fast64_t psnip_atomic_int64;
-typedef atomic_int_fast32_t psnip_atomic_int32;
+typedef _Atomic(psnip_int64_t) psnip_atomic_int64;
+typedef _Atomic(psnip_int32_t) psnip_atomic_int32;
+typedef _Atomic(psnip_int16_t) psnip_atomic_int16;
+typedef _Atomic(psnip_int8_t) psnip_atomic_int8;
+typedef _Atomic(void*) psnip_atomic_ptr;
+typedef atomic_flag psnip_atomic_flag;
 
 #define PSNIP_ATOMIC_VAR_INIT(value) ATOMIC_VAR_INIT(value)
+#define PSNIP_ATOMIC_FLAG_INIT ATOMIC_FLAG_INIT
+
+#define psnip_atomic_flag_test_and_set(object) \
+  atomic_flag_test_and_set(object)
+#define psnip_atomic_flag_clear(object) \
+  atomic_flag_clear(object)
+#define psnip_atomic_flag_test_and_set_explicit(object, order) \
+  atomic_flag_test_and_set_explicit(object, order)
+#define psnip_atomic_flag_clear_explicit(object, order) \
+  atomic_flag_clear_explicit(object, order)
 
 #define psnip_atomic_int64_load(object) \
   atomic_load(object)
@@ -151,6 +295,51 @@ typedef atomic_int_fast32_t psnip_atomic_int32;
 #define psnip_atomic_fence() \
   atomic_thread_fence(memory_order_seq_cst)
 
+#define PSNIP_ATOMIC_ORDER_RELAXED memory_order_relaxed
+#define PSNIP_ATOMIC_ORDER_ACQUIRE memory_order_acquire
+#define PSNIP_ATOMIC_ORDER_RELEASE memory_order_release
+#define PSNIP_ATOMIC_ORDER_ACQ_REL memory_order_acq_rel
+#define PSNIP_ATOMIC_ORDER_SEQ_CST memory_order_seq_cst
+
+#define psnip_atomic_int64_load_explicit(object, order) \
+  atomic_load_explicit(object, order)
+#define psnip_atomic_int64_store_explicit(object, desired, order) \
+  atomic_store_explicit(object, desired, order)
+#define psnip_atomic_int64_compare_exchange_explicit(object, expected, desired, success, failure) \
+  atomic_compare_exchange_strong_explicit(object, expected, desired, success, failure)
+#define psnip_atomic_int64_add_explicit(object, operand, order) \
+  atomic_fetch_add_explicit(object, operand, order)
+#define psnip_atomic_int64_sub_explicit(object, operand, order) \
+  atomic_fetch_sub_explicit(object, operand, order)
+#define psnip_atomic_fence_explicit(order) \
+  atomic_thread_fence(order)
+
+#define psnip_atomic_int64_exchange(object, desired) \
+  atomic_exchange(object, desired)
+#define psnip_atomic_int64_fetch_add(object, operand) \
+  atomic_fetch_add(object, operand)
+#define psnip_atomic_int64_fetch_sub(object, operand) \
+  atomic_fetch_sub(object, operand)
+#define psnip_atomic_int64_fetch_or(object, operand) \
+  atomic_fetch_or(object, operand)
+#define psnip_atomic_int64_fetch_and(object, operand) \
+  atomic_fetch_and(object, operand)
+#define psnip_atomic_int64_fetch_xor(object, operand) \
+  atomic_fetch_xor(object, operand)
+
+#define psnip_atomic_int64_exchange_explicit(object, desired, order) \
+  atomic_exchange_explicit(object, desired, order)
+#define psnip_atomic_int64_fetch_add_explicit(object, operand, order) \
+  atomic_fetch_add_explicit(object, operand, order)
+#define psnip_atomic_int64_fetch_sub_explicit(object, operand, order) \
+  atomic_fetch_sub_explicit(object, operand, order)
+#define psnip_atomic_int64_fetch_or_explicit(object, operand, order) \
+  atomic_fetch_or_explicit(object, operand, order)
+#define psnip_atomic_int64_fetch_and_explicit(object, operand, order) \
+  atomic_fetch_and_explicit(object, operand, order)
+#define psnip_atomic_int64_fetch_xor_explicit(object, operand, order) \
+  atomic_fetch_xor_explicit(object, operand, order)
+
 #define PSNIP_ATOMIC_IS_TG
 
 #elif PSNIP_ATOMIC_IMPL == PSNIP_ATOMIC_IMPL_CLANG
@@ -158,6 +347,9 @@ typedef atomic_int_fast32_t psnip_atomic_int32;
 #include <stdint.h>
 typedef _Atomic psnip_int64_t psnip_atomic_int64;
 typedef _Atomic psnip_int32_t psnip_atomic_int32;
+typedef _Atomic psnip_int16_t psnip_atomic_int16;
+typedef _Atomic psnip_int8_t psnip_atomic_int8;
+typedef _Atomic(void*) psnip_atomic_ptr;
 
 #define psnip_atomic_int64_load(object) \
   __c11_atomic_load(object, __ATOMIC_SEQ_CST)
@@ -172,6 +364,45 @@ typedef _Atomic psnip_int32_t psnip_atomic_int32;
 #define psnip_atomic_fence() \
   __c11_atomic_thread_fence(__ATOMIC_SEQ_CST)
 
+#define psnip_atomic_int64_load_explicit(object, order) \
+  __c11_atomic_load(object, order)
+#define psnip_atomic_int64_store_explicit(object, desired, order) \
+  __c11_atomic_store(object, desired, order)
+#define psnip_atomic_int64_compare_exchange_explicit(object, expected, desired, success, failure) \
+  __c11_atomic_compare_exchange_strong(object, expected, desired, success, failure)
+#define psnip_atomic_int64_add_explicit(object, operand, order) \
+  __c11_atomic_fetch_add(object, operand, order)
+#define psnip_atomic_int64_sub_explicit(object, operand, order) \
+  __c11_atomic_fetch_sub(object, operand, order)
+#define psnip_atomic_fence_explicit(order) \
+  __c11_atomic_thread_fence(order)
+
+#define psnip_atomic_int64_exchange(object, desired) \
+  __c11_atomic_exchange(object, desired, __ATOMIC_SEQ_CST)
+#define psnip_atomic_int64_fetch_add(object, operand) \
+  __c11_atomic_fetch_add(object, operand, __ATOMIC_SEQ_CST)
+#define psnip_atomic_int64_fetch_sub(object, operand) \
+  __c11_atomic_fetch_sub(object, operand, __ATOMIC_SEQ_CST)
+#define psnip_atomic_int64_fetch_or(object, operand) \
+  __c11_atomic_fetch_or(object, operand, __ATOMIC_SEQ_CST)
+#define psnip_atomic_int64_fetch_and(object, operand) \
+  __c11_atomic_fetch_and(object, operand, __ATOMIC_SEQ_CST)
+#define psnip_atomic_int64_fetch_xor(object, operand) \
+  __c11_atomic_fetch_xor(object, operand, __ATOMIC_SEQ_CST)
+
+#define psnip_atomic_int64_exchange_explicit(object, desired, order) \
+  __c11_atomic_exchange(object, desired, order)
+#define psnip_atomic_int64_fetch_add_explicit(object, operand, order) \
+  __c11_atomic_fetch_add(object, operand, order)
+#define psnip_atomic_int64_fetch_sub_explicit(object, operand, order) \
+  __c11_atomic_fetch_sub(object, operand, order)
+#define psnip_atomic_int64_fetch_or_explicit(object, operand, order) \
+  __c11_atomic_fetch_or(object, operand, order)
+#define psnip_atomic_int64_fetch_and_explicit(object, operand, order) \
+  __c11_atomic_fetch_and(object, operand, order)
+#define psnip_atomic_int64_fetch_xor_explicit(object, operand, order) \
+  __c11_atomic_fetch_xor(object, operand, order)
+
 #define PSNIP_ATOMIC_IS_TG
 
 #elif PSNIP_ATOMIC_IMPL == PSNIP_ATOMIC_IMPL_GCC
@@ -180,9 +411,15 @@ typedef _Atomic psnip_int32_t psnip_atomic_int32;
 #if !defined(__INTEL_COMPILER) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && !defined(_OPENMP)
 typedef _Atomic psnip_int64_t psnip_atomic_int64;
 typedef _Atomic psnip_int32_t psnip_atomic_int32;
+typedef _Atomic psnip_int16_t psnip_atomic_int16;
+typedef _Atomic psnip_int8_t psnip_atomic_int8;
+typedef void* _Atomic psnip_atomic_ptr;
 #else
 typedef psnip_int64_t psnip_atomic_int64;
 typedef psnip_int32_t psnip_atomic_int32;
+typedef psnip_int16_t psnip_atomic_int16;
+typedef psnip_int8_t psnip_atomic_int8;
+typedef void* psnip_atomic_ptr;
 #endif
 
 #define psnip_atomic_int64_load(object) \
@@ -192,12 +429,51 @@ typedef psnip_int32_t psnip_atomic_int32;
 #define psnip_atomic_int64_compare_exchange(object, expected, desired) \
   __atomic_compare_exchange_n(object, expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
 #define psnip_atomic_int64_add(object, operand) \
-  __atomic_add_fetch(object, operand, __ATOMIC_SEQ_CST)
+  __atomic_fetch_add(object, operand, __ATOMIC_SEQ_CST)
 #define psnip_atomic_int64_sub(object, operand) \
-  __atomic_sub_fetch(object, operand, __ATOMIC_SEQ_CST)
+  __atomic_fetch_sub(object, operand, __ATOMIC_SEQ_CST)
 #define psnip_atomic_fence() \
   __atomic_thread_fence(__ATOMIC_SEQ_CST)
 
+#define psnip_atomic_int64_load_explicit(object, order) \
+  __atomic_load_n(object, order)
+#define psnip_atomic_int64_store_explicit(object, desired, order) \
+  __atomic_store_n(object, desired, order)
+#define psnip_atomic_int64_compare_exchange_explicit(object, expected, desired, success, failure) \
+  __atomic_compare_exchange_n(object, expected, desired, 0, success, failure)
+#define psnip_atomic_int64_add_explicit(object, operand, order) \
+  __atomic_fetch_add(object, operand, order)
+#define psnip_atomic_int64_sub_explicit(object, operand, order) \
+  __atomic_fetch_sub(object, operand, order)
+#define psnip_atomic_fence_explicit(order) \
+  __atomic_thread_fence(order)
+
+#define psnip_atomic_int64_exchange(object, desired) \
+  __atomic_exchange_n(object, desired, __ATOMIC_SEQ_CST)
+#define psnip_atomic_int64_fetch_add(object, operand) \
+  __atomic_fetch_add(object, operand, __ATOMIC_SEQ_CST)
+#define psnip_atomic_int64_fetch_sub(object, operand) \
+  __atomic_fetch_sub(object, operand, __ATOMIC_SEQ_CST)
+#define psnip_atomic_int64_fetch_or(object, operand) \
+  __atomic_fetch_or(object, operand, __ATOMIC_SEQ_CST)
+#define psnip_atomic_int64_fetch_and(object, operand) \
+  __atomic_fetch_and(object, operand, __ATOMIC_SEQ_CST)
+#define psnip_atomic_int64_fetch_xor(object, operand) \
+  __atomic_fetch_xor(object, operand, __ATOMIC_SEQ_CST)
+
+#define psnip_atomic_int64_exchange_explicit(object, desired, order) \
+  __atomic_exchange_n(object, desired, order)
+#define psnip_atomic_int64_fetch_add_explicit(object, operand, order) \
+  __atomic_fetch_add(object, operand, order)
+#define psnip_atomic_int64_fetch_sub_explicit(object, operand, order) \
+  __atomic_fetch_sub(object, operand, order)
+#define psnip_atomic_int64_fetch_or_explicit(object, operand, order) \
+  __atomic_fetch_or(object, operand, order)
+#define psnip_atomic_int64_fetch_and_explicit(object, operand, order) \
+  __atomic_fetch_and(object, operand, order)
+#define psnip_atomic_int64_fetch_xor_explicit(object, operand, order) \
+  __atomic_fetch_xor(object, operand, order)
+
 #define PSNIP_ATOMIC_IS_TG
 
 #elif PSNIP_ATOMIC_IMPL == PSNIP_ATOMIC_IMPL_GCC_SYNC
@@ -205,7 +481,12 @@ typedef psnip_int32_t psnip_atomic_int32;
 #include <stdint.h>
 typedef psnip_int64_t psnip_atomic_int64;
 typedef psnip_int32_t psnip_atomic_int32;
+typedef psnip_int16_t psnip_atomic_int16;
+typedef psnip_int8_t psnip_atomic_int8;
+typedef void* psnip_atomic_ptr;
 
+/* __sync_lock_test_and_set is only an acquire barrier, and some
+ * targets can only store 1 with it, so exchange is a CAS loop. */
 PSNIP_ATOMIC__FUNCTION
 psnip_int64_t
 psnip_atomic_int64_load(psnip_atomic_int64* object) {
@@ -220,12 +501,39 @@ psnip_atomic_int64_store(psnip_atomic_int64* object, psnip_int64_t desired) {
   __sync_synchronize();
 }
 
-#define psnip_atomic_int64_compare_exchange(object, expected, desired)  \
-  __sync_bool_compare_and_swap(object, *(expected), desired)
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_int64_compare_exchange(psnip_atomic_int64* object, psnip_int64_t* expected, psnip_int64_t desired) {
+  const psnip_int64_t e = *expected;
+  const psnip_int64_t v = __sync_val_compare_and_swap(object, e, desired);
+  if (v == e)
+    return 1;
+  *expected = v;
+  return 0;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int64_t
+psnip_atomic_int64_exchange(psnip_atomic_int64* object, psnip_int64_t desired) {
+  psnip_int64_t v = *object;
+  while (!psnip_atomic_int64_compare_exchange(object, &v, desired)) { }
+  return v;
+}
+
 #define psnip_atomic_int64_add(object, operand) \
   __sync_fetch_and_add(object, operand)
 #define psnip_atomic_int64_sub(object, operand) \
   __sync_fetch_and_sub(object, operand)
+#define psnip_atomic_int64_fetch_add(object, operand) \
+  __sync_fetch_and_add(object, operand)
+#define psnip_atomic_int64_fetch_sub(object, operand) \
+  __sync_fetch_and_sub(object, operand)
+#define psnip_atomic_int64_fetch_or(object, operand) \
+  __sync_fetch_and_or(object, operand)
+#define psnip_atomic_int64_fetch_and(object, operand) \
+  __sync_fetch_and_and(object, operand)
+#define psnip_atomic_int64_fetch_xor(object, operand) \
+  __sync_fetch_and_xor(object, operand)
 
 PSNIP_ATOMIC__FUNCTION
 psnip_int32_t
@@ -241,59 +549,755 @@ psnip_atomic_int32_store(psnip_atomic_int32* object, psnip_int32_t desired) {
   __sync_synchronize();
 }
 
-#define psnip_atomic_int32_compare_exchange(object, expected, desired)  \
-  __sync_bool_compare_and_swap(object, *(expected), desired)
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_int32_compare_exchange(psnip_atomic_int32* object, psnip_int32_t* expected, psnip_int32_t desired) {
+  const psnip_int32_t e = *expected;
+  const psnip_int32_t v = __sync_val_compare_and_swap(object, e, desired);
+  if (v == e)
+    return 1;
+  *expected = v;
+  return 0;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int32_t
+psnip_atomic_int32_exchange(psnip_atomic_int32* object, psnip_int32_t desired) {
+  psnip_int32_t v = *object;
+  while (!psnip_atomic_int32_compare_exchange(object, &v, desired)) { }
+  return v;
+}
+
 #define psnip_atomic_int32_add(object, operand) \
   __sync_fetch_and_add(object, operand)
 #define psnip_atomic_int32_sub(object, operand) \
   __sync_fetch_and_sub(object, operand)
+#define psnip_atomic_int32_fetch_add(object, operand) \
+  __sync_fetch_and_add(object, operand)
+#define psnip_atomic_int32_fetch_sub(object, operand) \
+  __sync_fetch_and_sub(object, operand)
+#define psnip_atomic_int32_fetch_or(object, operand) \
+  __sync_fetch_and_or(object, operand)
+#define psnip_atomic_int32_fetch_and(object, operand) \
+  __sync_fetch_and_and(object, operand)
+#define psnip_atomic_int32_fetch_xor(object, operand) \
+  __sync_fetch_and_xor(object, operand)
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int16_t
+psnip_atomic_int16_load(psnip_atomic_int16* object) {
+  __sync_synchronize();
+  return (psnip_int16_t) *object;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_int16_store(psnip_atomic_int16* object, psnip_int16_t desired) {
+  *object = desired;
+  __sync_synchronize();
+}
+
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_int16_compare_exchange(psnip_atomic_int16* object, psnip_int16_t* expected, psnip_int16_t desired) {
+  const psnip_int16_t e = *expected;
+  const psnip_int16_t v = __sync_val_compare_and_swap(object, e, desired);
+  if (v == e)
+    return 1;
+  *expected = v;
+  return 0;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int16_t
+psnip_atomic_int16_exchange(psnip_atomic_int16* object, psnip_int16_t desired) {
+  psnip_int16_t v = *object;
+  while (!psnip_atomic_int16_compare_exchange(object, &v, desired)) { }
+  return v;
+}
+
+#define psnip_atomic_int16_add(object, operand) \
+  __sync_fetch_and_add(object, operand)
+#define psnip_atomic_int16_sub(object, operand) \
+  __sync_fetch_and_sub(object, operand)
+#define psnip_atomic_int16_fetch_add(object, operand) \
+  __sync_fetch_and_add(object, operand)
+#define psnip_atomic_int16_fetch_sub(object, operand) \
+  __sync_fetch_and_sub(object, operand)
+#define psnip_atomic_int16_fetch_or(object, operand) \
+  __sync_fetch_and_or(object, operand)
+#define psnip_atomic_int16_fetch_and(object, operand) \
+  __sync_fetch_and_and(object, operand)
+#define psnip_atomic_int16_fetch_xor(object, operand) \
+  __sync_fetch_and_xor(object, operand)
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int8_t
+psnip_atomic_int8_load(psnip_atomic_int8* object) {
+  __sync_synchronize();
+  return (psnip_int8_t) *object;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_int8_store(psnip_atomic_int8* object, psnip_int8_t desired) {
+  *object = desired;
+  __sync_synchronize();
+}
+
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_int8_compare_exchange(psnip_atomic_int8* object, psnip_int8_t* expected, psnip_int8_t desired) {
+  const psnip_int8_t e = *expected;
+  const psnip_int8_t v = __sync_val_compare_and_swap(object, e, desired);
+  if (v == e)
+    return 1;
+  *expected = v;
+  return 0;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int8_t
+psnip_atomic_int8_exchange(psnip_atomic_int8* object, psnip_int8_t desired) {
+  psnip_int8_t v = *object;
+  while (!psnip_atomic_int8_compare_exchange(object, &v, desired)) { }
+  return v;
+}
+
+#define psnip_atomic_int8_add(object, operand) \
+  __sync_fetch_and_add(object, operand)
+#define psnip_atomic_int8_sub(object, operand) \
+  __sync_fetch_and_sub(object, operand)
+#define psnip_atomic_int8_fetch_add(object, operand) \
+  __sync_fetch_and_add(object, operand)
+#define psnip_atomic_int8_fetch_sub(object, operand) \
+  __sync_fetch_and_sub(object, operand)
+#define psnip_atomic_int8_fetch_or(object, operand) \
+  __sync_fetch_and_or(object, operand)
+#define psnip_atomic_int8_fetch_and(object, operand) \
+  __sync_fetch_and_and(object, operand)
+#define psnip_atomic_int8_fetch_xor(object, operand) \
+  __sync_fetch_and_xor(object, operand)
+
+PSNIP_ATOMIC__FUNCTION
+void*
+psnip_atomic_ptr_load(psnip_atomic_ptr* object) {
+  __sync_synchronize();
+  return *object;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_ptr_store(psnip_atomic_ptr* object, void* desired) {
+  *object = desired;
+  __sync_synchronize();
+}
+
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_ptr_compare_exchange(psnip_atomic_ptr* object, void** expected, void* desired) {
+  void* const e = *expected;
+  void* const v = __sync_val_compare_and_swap(object, e, desired);
+  if (v == e)
+    return 1;
+  *expected = v;
+  return 0;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void*
+psnip_atomic_ptr_exchange(psnip_atomic_ptr* object, void* desired) {
+  void* v = *object;
+  while (!psnip_atomic_ptr_compare_exchange(object, &v, desired)) { }
+  return v;
+}
 
 #define psnip_atomic_fence() \
   __sync_synchronize()
 
+/* The __sync builtins are all full barriers. */
+#define psnip_atomic_int64_load_explicit(object, order) \
+  psnip_atomic_int64_load(object)
+#define psnip_atomic_int64_store_explicit(object, desired, order) \
+  psnip_atomic_int64_store(object, desired)
+#define psnip_atomic_int64_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_int64_compare_exchange(object, expected, desired)
+#define psnip_atomic_int64_add_explicit(object, operand, order) \
+  psnip_atomic_int64_add(object, operand)
+#define psnip_atomic_int64_sub_explicit(object, operand, order) \
+  psnip_atomic_int64_sub(object, operand)
+#define psnip_atomic_int64_exchange_explicit(object, desired, order) \
+  psnip_atomic_int64_exchange(object, desired)
+#define psnip_atomic_int64_fetch_add_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_add(object, operand)
+#define psnip_atomic_int64_fetch_sub_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_sub(object, operand)
+#define psnip_atomic_int64_fetch_or_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_or(object, operand)
+#define psnip_atomic_int64_fetch_and_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_and(object, operand)
+#define psnip_atomic_int64_fetch_xor_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_xor(object, operand)
+
+#define psnip_atomic_int32_load_explicit(object, order) \
+  psnip_atomic_int32_load(object)
+#define psnip_atomic_int32_store_explicit(object, desired, order) \
+  psnip_atomic_int32_store(object, desired)
+#define psnip_atomic_int32_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_int32_compare_exchange(object, expected, desired)
+#define psnip_atomic_int32_add_explicit(object, operand, order) \
+  psnip_atomic_int32_add(object, operand)
+#define psnip_atomic_int32_sub_explicit(object, operand, order) \
+  psnip_atomic_int32_sub(object, operand)
+#define psnip_atomic_int32_exchange_explicit(object, desired, order) \
+  psnip_atomic_int32_exchange(object, desired)
+#define psnip_atomic_int32_fetch_add_explicit(object, operand, order) \
+  psnip_atomic_int32_fetch_add(object, operand)
+#define psnip_atomic_int32_fetch_sub_explicit(object, operand, order) \
+  psnip_atomic_int32_fetch_sub(object, operand)
+#define psnip_atomic_int32_fetch_or_explicit(object, operand, order) \
+  psnip_atomic_int32_fetch_or(object, operand)
+#define psnip_atomic_int32_fetch_and_explicit(object, operand, order) \
+  psnip_atomic_int32_fetch_and(object, operand)
+#define psnip_atomic_int32_fetch_xor_explicit(object, operand, order) \
+  psnip_atomic_int32_fetch_xor(object, operand)
+
+#define psnip_atomic_int16_load_explicit(object, order) \
+  psnip_atomic_int16_load(object)
+#define psnip_atomic_int16_store_explicit(object, desired, order) \
+  psnip_atomic_int16_store(object, desired)
+#define psnip_atomic_int16_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_int16_compare_exchange(object, expected, desired)
+#define psnip_atomic_int16_add_explicit(object, operand, order) \
+  psnip_atomic_int16_add(object, operand)
+#define psnip_atomic_int16_sub_explicit(object, operand, order) \
+  psnip_atomic_int16_sub(object, operand)
+#define psnip_atomic_int16_exchange_explicit(object, desired, order) \
+  psnip_atomic_int16_exchange(object, desired)
+#define psnip_atomic_int16_fetch_add_explicit(object, operand, order) \
+  psnip_atomic_int16_fetch_add(object, operand)
+#define psnip_atomic_int16_fetch_sub_explicit(object, operand, order) \
+  psnip_atomic_int16_fetch_sub(object, operand)
+#define psnip_atomic_int16_fetch_or_explicit(object, operand, order) \
+  psnip_atomic_int16_fetch_or(object, operand)
+#define psnip_atomic_int16_fetch_and_explicit(object, operand, order) \
+  psnip_atomic_int16_fetch_and(object, operand)
+#define psnip_atomic_int16_fetch_xor_explicit(object, operand, order) \
+  psnip_atomic_int16_fetch_xor(object, operand)
+
+#define psnip_atomic_int8_load_explicit(object, order) \
+  psnip_atomic_int8_load(object)
+#define psnip_atomic_int8_store_explicit(object, desired, order) \
+  psnip_atomic_int8_store(object, desired)
+#define psnip_atomic_int8_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_int8_compare_exchange(object, expected, desired)
+#define psnip_atomic_int8_add_explicit(object, operand, order) \
+  psnip_atomic_int8_add(object, operand)
+#define psnip_atomic_int8_sub_explicit(object, operand, order) \
+  psnip_atomic_int8_sub(object, operand)
+#define psnip_atomic_int8_exchange_explicit(object, desired, order) \
+  psnip_atomic_int8_exchange(object, desired)
+#define psnip_atomic_int8_fetch_add_explicit(object, operand, order) \
+  psnip_atomic_int8_fetch_add(object, operand)
+#define psnip_atomic_int8_fetch_sub_explicit(object, operand, order) \
+  psnip_atomic_int8_fetch_sub(object, operand)
+#define psnip_atomic_int8_fetch_or_explicit(object, operand, order) \
+  psnip_atomic_int8_fetch_or(object, operand)
+#define psnip_atomic_int8_fetch_and_explicit(object, operand, order) \
+  psnip_atomic_int8_fetch_and(object, operand)
+#define psnip_atomic_int8_fetch_xor_explicit(object, operand, order) \
+  psnip_atomic_int8_fetch_xor(object, operand)
+
+#define psnip_atomic_ptr_load_explicit(object, order) \
+  psnip_atomic_ptr_load(object)
+#define psnip_atomic_ptr_store_explicit(object, desired, order) \
+  psnip_atomic_ptr_store(object, desired)
+#define psnip_atomic_ptr_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_ptr_compare_exchange(object, expected, desired)
+#define psnip_atomic_ptr_exchange_explicit(object, desired, order) \
+  psnip_atomic_ptr_exchange(object, desired)
+
+#define psnip_atomic_fence_explicit(order) \
+  __sync_synchronize()
+
 #elif PSNIP_ATOMIC_IMPL == PSNIP_ATOMIC_IMPL_MS
 
 #include <Windows.h>
+#include <intrin.h>
 
 typedef long long volatile psnip_atomic_int64;
 typedef long volatile psnip_atomic_int32;
+typedef short volatile psnip_atomic_int16;
+typedef char volatile psnip_atomic_int8;
+typedef void* volatile psnip_atomic_ptr;
+
+#define PSNIP_ATOMIC_ORDER_RELAXED 0
+#define PSNIP_ATOMIC_ORDER_ACQUIRE 2
+#define PSNIP_ATOMIC_ORDER_RELEASE 3
+#define PSNIP_ATOMIC_ORDER_ACQ_REL 4
+#define PSNIP_ATOMIC_ORDER_SEQ_CST 5
+
+/* On x86 every Interlocked* function is a full barrier, and plain
+ * loads and stores already have acquire/release semantics, so we
+ * only need to stop the compiler from reordering things.  ARM has
+ * _nf (no fence), _acq, and _rel variants of the intrinsics, and
+ * needs a real barrier around plain loads and stores. */
+#if defined(_M_ARM64)
+#  define PSNIP_ATOMIC__MS_ARM
+#  define PSNIP_ATOMIC__MS_BARRIER() __dmb(_ARM64_BARRIER_ISH)
+#elif defined(_M_ARM)
+#  define PSNIP_ATOMIC__MS_ARM
+#  define PSNIP_ATOMIC__MS_BARRIER() __dmb(_ARM_BARRIER_ISH)
+#else
+#  define PSNIP_ATOMIC__MS_BARRIER() _ReadWriteBarrier()
+#endif
+
+/* name is the <Windows.h> function; on ARM the intrinsic with an
+ * underscore prefix has the weaker variants.  The 64-bit intrinsics
+ * don't all exist on 32-bit x86, but <Windows.h> provides inline
+ * replacements. */
+#if defined(PSNIP_ATOMIC__MS_ARM)
+#  define PSNIP_ATOMIC__MS_INTERLOCKED(name, order, ...) \
+  (((order) == PSNIP_ATOMIC_ORDER_RELAXED) ? _##name##_nf(__VA_ARGS__) : \
+   ((order) == PSNIP_ATOMIC_ORDER_ACQUIRE) ? _##name##_acq(__VA_ARGS__) : \
+   ((order) == PSNIP_ATOMIC_ORDER_RELEASE) ? _##name##_rel(__VA_ARGS__) : \
+   name(__VA_ARGS__))
+#else
+#  define PSNIP_ATOMIC__MS_INTERLOCKED(name, order, ...) \
+  name(__VA_ARGS__)
+#endif
+
+/* <Windows.h> doesn't have names for all of the 8- and 16-bit
+ * intrinsics, so those are used directly. */
+#if defined(PSNIP_ATOMIC__MS_ARM)
+#  define PSNIP_ATOMIC__MS_INTRINSIC(name, order, ...) \
+  (((order) == PSNIP_ATOMIC_ORDER_RELAXED) ? name##_nf(__VA_ARGS__) : \
+   ((order) == PSNIP_ATOMIC_ORDER_ACQUIRE) ? name##_acq(__VA_ARGS__) : \
+   ((order) == PSNIP_ATOMIC_ORDER_RELEASE) ? name##_rel(__VA_ARGS__) : \
+   name(__VA_ARGS__))
+#else
+#  define PSNIP_ATOMIC__MS_INTRINSIC(name, order, ...) \
+  name(__VA_ARGS__)
+#endif
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int32_t
+psnip_atomic_int32_load_explicit(psnip_atomic_int32* object, int order) {
+  psnip_int32_t v;
+#if defined(PSNIP_ATOMIC__MS_ARM)
+  v = (psnip_int32_t) __iso_volatile_load32((const volatile __int32*) object);
+#else
+#pragma warning(push)
+#pragma warning(disable:28112)
+  v = (psnip_int32_t) *object;
+#pragma warning(pop)
+#endif
+  if (order != PSNIP_ATOMIC_ORDER_RELAXED)
+    PSNIP_ATOMIC__MS_BARRIER();
+  return v;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_int32_store_explicit(psnip_atomic_int32* object, psnip_int32_t desired, int order) {
+  if (order == PSNIP_ATOMIC_ORDER_RELAXED || order == PSNIP_ATOMIC_ORDER_RELEASE) {
+    if (order == PSNIP_ATOMIC_ORDER_RELEASE)
+      PSNIP_ATOMIC__MS_BARRIER();
+#if defined(PSNIP_ATOMIC__MS_ARM)
+    __iso_volatile_store32((volatile __int32*) object, (__int32) desired);
+#else
+    *object = desired;
+#endif
+  } else {
+    InterlockedExchange(object, desired);
+  }
+}
+
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_int32_compare_exchange_explicit(psnip_atomic_int32* object, psnip_int32_t* expected, psnip_int32_t desired, int success, int failure) {
+  const psnip_int32_t e = *expected;
+  const psnip_int32_t v = (psnip_int32_t) PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedCompareExchange, success, object, desired, e);
+  (void) failure;
+  if (v == e)
+    return 1;
+  *expected = v;
+  return 0;
+}
+
+#define psnip_atomic_int32_add_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedExchangeAdd, order, object, operand)
+#define psnip_atomic_int32_sub_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedExchangeAdd, order, object, -(operand))
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int64_t
+psnip_atomic_int64_load_explicit(psnip_atomic_int64* object, int order) {
+  psnip_int64_t v;
+#if defined(PSNIP_ATOMIC__MS_ARM)
+  v = (psnip_int64_t) __iso_volatile_load64((const volatile __int64*) object);
+#else
+#pragma warning(push)
+#pragma warning(disable:28112)
+  v = (psnip_int64_t) *object;
+#pragma warning(pop)
+#endif
+  if (order != PSNIP_ATOMIC_ORDER_RELAXED)
+    PSNIP_ATOMIC__MS_BARRIER();
+  return v;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_int64_store_explicit(psnip_atomic_int64* object, psnip_int64_t desired, int order) {
+  if (order == PSNIP_ATOMIC_ORDER_RELAXED || order == PSNIP_ATOMIC_ORDER_RELEASE) {
+    if (order == PSNIP_ATOMIC_ORDER_RELEASE)
+      PSNIP_ATOMIC__MS_BARRIER();
+#if defined(PSNIP_ATOMIC__MS_ARM)
+    __iso_volatile_store64((volatile __int64*) object, (__int64) desired);
+#else
+    *object = desired;
+#endif
+  } else {
+    InterlockedExchange64(object, desired);
+  }
+}
+
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_int64_compare_exchange_explicit(psnip_atomic_int64* object, psnip_int64_t* expected, psnip_int64_t desired, int success, int failure) {
+  const psnip_int64_t e = *expected;
+  const psnip_int64_t v = (psnip_int64_t) PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedCompareExchange64, success, object, desired, e);
+  (void) failure;
+  if (v == e)
+    return 1;
+  *expected = v;
+  return 0;
+}
+
+#define psnip_atomic_int64_add_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedExchangeAdd64, order, object, operand)
+#define psnip_atomic_int64_sub_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedExchangeAdd64, order, object, -(operand))
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int16_t
+psnip_atomic_int16_load_explicit(psnip_atomic_int16* object, int order) {
+  psnip_int16_t v;
+#if defined(PSNIP_ATOMIC__MS_ARM)
+  v = (psnip_int16_t) __iso_volatile_load16((const volatile __int16*) object);
+#else
+#pragma warning(push)
+#pragma warning(disable:28112)
+  v = (psnip_int16_t) *object;
+#pragma warning(pop)
+#endif
+  if (order != PSNIP_ATOMIC_ORDER_RELAXED)
+    PSNIP_ATOMIC__MS_BARRIER();
+  return v;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_int16_store_explicit(psnip_atomic_int16* object, psnip_int16_t desired, int order) {
+  if (order == PSNIP_ATOMIC_ORDER_RELAXED || order == PSNIP_ATOMIC_ORDER_RELEASE) {
+    if (order == PSNIP_ATOMIC_ORDER_RELEASE)
+      PSNIP_ATOMIC__MS_BARRIER();
+#if defined(PSNIP_ATOMIC__MS_ARM)
+    __iso_volatile_store16((volatile __int16*) object, (__int16) desired);
+#else
+    *object = desired;
+#endif
+  } else {
+    _InterlockedExchange16(object, desired);
+  }
+}
+
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_int16_compare_exchange_explicit(psnip_atomic_int16* object, psnip_int16_t* expected, psnip_int16_t desired, int success, int failure) {
+  const psnip_int16_t e = *expected;
+  const psnip_int16_t v = (psnip_int16_t) PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedCompareExchange16, success, object, desired, e);
+  (void) failure;
+  if (v == e)
+    return 1;
+  *expected = v;
+  return 0;
+}
+
+#define psnip_atomic_int16_add_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedExchangeAdd16, order, object, operand)
+#define psnip_atomic_int16_sub_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedExchangeAdd16, order, object, -(operand))
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int8_t
+psnip_atomic_int8_load_explicit(psnip_atomic_int8* object, int order) {
+  psnip_int8_t v;
+#if defined(PSNIP_ATOMIC__MS_ARM)
+  v = (psnip_int8_t) __iso_volatile_load8((const volatile __int8*) object);
+#else
+#pragma warning(push)
+#pragma warning(disable:28112)
+  v = (psnip_int8_t) *object;
+#pragma warning(pop)
+#endif
+  if (order != PSNIP_ATOMIC_ORDER_RELAXED)
+    PSNIP_ATOMIC__MS_BARRIER();
+  return v;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_int8_store_explicit(psnip_atomic_int8* object, psnip_int8_t desired, int order) {
+  if (order == PSNIP_ATOMIC_ORDER_RELAXED || order == PSNIP_ATOMIC_ORDER_RELEASE) {
+    if (order == PSNIP_ATOMIC_ORDER_RELEASE)
+      PSNIP_ATOMIC__MS_BARRIER();
+#if defined(PSNIP_ATOMIC__MS_ARM)
+    __iso_volatile_store8((volatile __int8*) object, (__int8) desired);
+#else
+    *object = desired;
+#endif
+  } else {
+    _InterlockedExchange8(object, desired);
+  }
+}
+
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_int8_compare_exchange_explicit(psnip_atomic_int8* object, psnip_int8_t* expected, psnip_int8_t desired, int success, int failure) {
+  const psnip_int8_t e = *expected;
+  const psnip_int8_t v = (psnip_int8_t) PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedCompareExchange8, success, object, desired, e);
+  (void) failure;
+  if (v == e)
+    return 1;
+  *expected = v;
+  return 0;
+}
+
+#define psnip_atomic_int8_add_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedExchangeAdd8, order, object, operand)
+#define psnip_atomic_int8_sub_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedExchangeAdd8, order, object, -(operand))
+
+PSNIP_ATOMIC__FUNCTION
+void*
+psnip_atomic_ptr_load_explicit(psnip_atomic_ptr* object, int order) {
+  void* v;
+#pragma warning(push)
+#pragma warning(disable:28112)
+  v = *object;
+#pragma warning(pop)
+  if (order != PSNIP_ATOMIC_ORDER_RELAXED)
+    PSNIP_ATOMIC__MS_BARRIER();
+  return v;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_ptr_store_explicit(psnip_atomic_ptr* object, void* desired, int order) {
+  if (order == PSNIP_ATOMIC_ORDER_RELAXED || order == PSNIP_ATOMIC_ORDER_RELEASE) {
+    if (order == PSNIP_ATOMIC_ORDER_RELEASE)
+      PSNIP_ATOMIC__MS_BARRIER();
+    *object = desired;
+  } else {
+    InterlockedExchangePointer(object, desired);
+  }
+}
+
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_ptr_compare_exchange_explicit(psnip_atomic_ptr* object, void** expected, void* desired, int success, int failure) {
+  void* const e = *expected;
+  void* const v = PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedCompareExchangePointer, success, object, desired, e);
+  (void) failure;
+  if (v == e)
+    return 1;
+  *expected = v;
+  return 0;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_fence_explicit(int order) {
+  if (order == PSNIP_ATOMIC_ORDER_SEQ_CST)
+    MemoryBarrier();
+  else if (order != PSNIP_ATOMIC_ORDER_RELAXED)
+    PSNIP_ATOMIC__MS_BARRIER();
+}
 
 #define psnip_atomic_int32_load(object) \
-  __pragma(warning(push)) \
-  __pragma(warning(disable:28112)) \
-  (*(object)) \
-  __pragma(warning(pop))
+  psnip_atomic_int32_load_explicit(object, PSNIP_ATOMIC_ORDER_SEQ_CST)
 #define psnip_atomic_int32_store(object, desired) \
-  InterlockedExchange(object, desired)
+  psnip_atomic_int32_store_explicit(object, desired, PSNIP_ATOMIC_ORDER_SEQ_CST)
 #define psnip_atomic_int32_compare_exchange(object, expected, desired) \
-  InterlockedCompareExchange(object, desired, *(expected))
+  psnip_atomic_int32_compare_exchange_explicit(object, expected, desired, PSNIP_ATOMIC_ORDER_SEQ_CST, PSNIP_ATOMIC_ORDER_SEQ_CST)
 #define psnip_atomic_int32_add(object, operand) \
   InterlockedExchangeAdd(object, operand)
 #define psnip_atomic_int32_sub(object, operand) \
   InterlockedExchangeAdd(object, -(operand))
 
 #define psnip_atomic_int64_load(object) \
-  __pragma(warning(push)) \
-  __pragma(warning(disable:28112)) \
-  (*(object)) \
-  __pragma(warning(pop))
+  psnip_atomic_int64_load_explicit(object, PSNIP_ATOMIC_ORDER_SEQ_CST)
 #define psnip_atomic_int64_store(object, desired) \
-  InterlockedExchange64(object, desired)
+  psnip_atomic_int64_store_explicit(object, desired, PSNIP_ATOMIC_ORDER_SEQ_CST)
 #define psnip_atomic_int64_compare_exchange(object, expected, desired)  \
-  InterlockedCompareExchange64(object, desired, *(expected))
+  psnip_atomic_int64_compare_exchange_explicit(object, expected, desired, PSNIP_ATOMIC_ORDER_SEQ_CST, PSNIP_ATOMIC_ORDER_SEQ_CST)
 #define psnip_atomic_int64_add(object, operand) \
   InterlockedExchangeAdd64(object, operand)
 #define psnip_atomic_int64_sub(object, operand) \
   InterlockedExchangeAdd64(object, -(operand))
 
+#define psnip_atomic_int16_load(object) \
+  psnip_atomic_int16_load_explicit(object, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int16_store(object, desired) \
+  psnip_atomic_int16_store_explicit(object, desired, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int16_compare_exchange(object, expected, desired) \
+  psnip_atomic_int16_compare_exchange_explicit(object, expected, desired, PSNIP_ATOMIC_ORDER_SEQ_CST, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int16_add(object, operand) \
+  _InterlockedExchangeAdd16(object, operand)
+#define psnip_atomic_int16_sub(object, operand) \
+  _InterlockedExchangeAdd16(object, -(operand))
+
+#define psnip_atomic_int8_load(object) \
+  psnip_atomic_int8_load_explicit(object, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int8_store(object, desired) \
+  psnip_atomic_int8_store_explicit(object, desired, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int8_compare_exchange(object, expected, desired) \
+  psnip_atomic_int8_compare_exchange_explicit(object, expected, desired, PSNIP_ATOMIC_ORDER_SEQ_CST, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int8_add(object, operand) \
+  _InterlockedExchangeAdd8(object, operand)
+#define psnip_atomic_int8_sub(object, operand) \
+  _InterlockedExchangeAdd8(object, -(operand))
+
+#define psnip_atomic_ptr_load(object) \
+  psnip_atomic_ptr_load_explicit(object, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_ptr_store(object, desired) \
+  psnip_atomic_ptr_store_explicit(object, desired, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_ptr_compare_exchange(object, expected, desired)  \
+  psnip_atomic_ptr_compare_exchange_explicit(object, expected, desired, PSNIP_ATOMIC_ORDER_SEQ_CST, PSNIP_ATOMIC_ORDER_SEQ_CST)
+
 #define psnip_atomic_fence() \
   MemoryBarrier()
 
+#define psnip_atomic_int32_exchange_explicit(object, desired, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedExchange, order, object, desired)
+#define psnip_atomic_int32_fetch_add_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedExchangeAdd, order, object, operand)
+#define psnip_atomic_int32_fetch_sub_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedExchangeAdd, order, object, -(operand))
+#define psnip_atomic_int32_fetch_or_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedOr, order, object, operand)
+#define psnip_atomic_int32_fetch_and_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedAnd, order, object, operand)
+#define psnip_atomic_int32_fetch_xor_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedXor, order, object, operand)
+
+#define psnip_atomic_int64_exchange_explicit(object, desired, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedExchange64, order, object, desired)
+#define psnip_atomic_int64_fetch_add_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedExchangeAdd64, order, object, operand)
+#define psnip_atomic_int64_fetch_sub_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedExchangeAdd64, order, object, -(operand))
+#define psnip_atomic_int64_fetch_or_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedOr64, order, object, operand)
+#define psnip_atomic_int64_fetch_and_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedAnd64, order, object, operand)
+#define psnip_atomic_int64_fetch_xor_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedXor64, order, object, operand)
+
+#define psnip_atomic_int16_exchange_explicit(object, desired, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedExchange16, order, object, desired)
+#define psnip_atomic_int16_fetch_add_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedExchangeAdd16, order, object, operand)
+#define psnip_atomic_int16_fetch_sub_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedExchangeAdd16, order, object, -(operand))
+#define psnip_atomic_int16_fetch_or_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedOr16, order, object, operand)
+#define psnip_atomic_int16_fetch_and_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedAnd16, order, object, operand)
+#define psnip_atomic_int16_fetch_xor_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedXor16, order, object, operand)
+
+#define psnip_atomic_int8_exchange_explicit(object, desired, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedExchange8, order, object, desired)
+#define psnip_atomic_int8_fetch_add_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedExchangeAdd8, order, object, operand)
+#define psnip_atomic_int8_fetch_sub_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedExchangeAdd8, order, object, -(operand))
+#define psnip_atomic_int8_fetch_or_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedOr8, order, object, operand)
+#define psnip_atomic_int8_fetch_and_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedAnd8, order, object, operand)
+#define psnip_atomic_int8_fetch_xor_explicit(object, operand, order) \
+  PSNIP_ATOMIC__MS_INTRINSIC(_InterlockedXor8, order, object, operand)
+
+#define psnip_atomic_ptr_exchange_explicit(object, desired, order) \
+  PSNIP_ATOMIC__MS_INTERLOCKED(InterlockedExchangePointer, order, object, desired)
+
+#define psnip_atomic_int32_exchange(object, desired) \
+  psnip_atomic_int32_exchange_explicit(object, desired, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int32_fetch_add(object, operand) \
+  psnip_atomic_int32_fetch_add_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int32_fetch_sub(object, operand) \
+  psnip_atomic_int32_fetch_sub_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int32_fetch_or(object, operand) \
+  psnip_atomic_int32_fetch_or_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int32_fetch_and(object, operand) \
+  psnip_atomic_int32_fetch_and_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int32_fetch_xor(object, operand) \
+  psnip_atomic_int32_fetch_xor_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+
+#define psnip_atomic_int64_exchange(object, desired) \
+  psnip_atomic_int64_exchange_explicit(object, desired, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int64_fetch_add(object, operand) \
+  psnip_atomic_int64_fetch_add_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int64_fetch_sub(object, operand) \
+  psnip_atomic_int64_fetch_sub_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int64_fetch_or(object, operand) \
+  psnip_atomic_int64_fetch_or_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int64_fetch_and(object, operand) \
+  psnip_atomic_int64_fetch_and_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int64_fetch_xor(object, operand) \
+  psnip_atomic_int64_fetch_xor_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+
+#define psnip_atomic_int16_exchange(object, desired) \
+  psnip_atomic_int16_exchange_explicit(object, desired, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int16_fetch_add(object, operand) \
+  psnip_atomic_int16_fetch_add_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int16_fetch_sub(object, operand) \
+  psnip_atomic_int16_fetch_sub_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int16_fetch_or(object, operand) \
+  psnip_atomic_int16_fetch_or_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int16_fetch_and(object, operand) \
+  psnip_atomic_int16_fetch_and_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int16_fetch_xor(object, operand) \
+  psnip_atomic_int16_fetch_xor_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+
+#define psnip_atomic_int8_exchange(object, desired) \
+  psnip_atomic_int8_exchange_explicit(object, desired, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int8_fetch_add(object, operand) \
+  psnip_atomic_int8_fetch_add_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int8_fetch_sub(object, operand) \
+  psnip_atomic_int8_fetch_sub_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int8_fetch_or(object, operand) \
+  psnip_atomic_int8_fetch_or_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int8_fetch_and(object, operand) \
+  psnip_atomic_int8_fetch_and_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_int8_fetch_xor(object, operand) \
+  psnip_atomic_int8_fetch_xor_explicit(object, operand, PSNIP_ATOMIC_ORDER_SEQ_CST)
+
+#define psnip_atomic_ptr_exchange(object, desired) \
+  psnip_atomic_ptr_exchange_explicit(object, desired, PSNIP_ATOMIC_ORDER_SEQ_CST)
+
 #elif PSNIP_ATOMIC_IMPL == PSNIP_ATOMIC_IMPL_OPENMP
 
 #include <stdint.h>
 typedef psnip_int64_t psnip_atomic_int64;
 typedef psnip_int32_t psnip_atomic_int32;
+typedef psnip_int16_t psnip_atomic_int16;
+typedef psnip_int8_t psnip_atomic_int8;
+typedef void* psnip_atomic_ptr;
 
 PSNIP_ATOMIC__FUNCTION
 psnip_int64_t
@@ -316,7 +1320,7 @@ int
 psnip_atomic_int64_compare_exchange_(psnip_atomic_int64* object, psnip_int64_t* expected, psnip_int64_t desired) {
   int ret;
 #pragma omp critical(psnip_atomic)
-  ret = (*object == *expected) ? ((*object = desired), 1) : 0;
+  ret = (*object == *expected) ? ((*object = desired), 1) : ((*expected = *object), 0);
   return ret;
 }
 
@@ -325,21 +1329,63 @@ psnip_atomic_int64_compare_exchange_(psnip_atomic_int64* object, psnip_int64_t*
 
 PSNIP_ATOMIC__FUNCTION
 psnip_int64_t
-psnip_atomic_int64_add(psnip_atomic_int64* object, psnip_int64_t operand) {
-  int ret;
+psnip_atomic_int64_exchange(psnip_atomic_int64* object, psnip_int64_t desired) {
+  psnip_int64_t ret;
 #pragma omp critical(psnip_atomic)
-  *object = (ret = *object) + operand;
+  { ret = *object; *object = desired; }
   return ret;
 }
 
 PSNIP_ATOMIC__FUNCTION
 psnip_int64_t
-psnip_atomic_int64_sub(psnip_atomic_int64* object, psnip_int64_t operand) {
-  int ret;
+psnip_atomic_int64_fetch_add(psnip_atomic_int64* object, psnip_int64_t operand) {
+  psnip_int64_t ret;
 #pragma omp critical(psnip_atomic)
-  *object = (ret = *object) - operand;
+  *object = (ret = *object) + operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int64_t
+psnip_atomic_int64_fetch_sub(psnip_atomic_int64* object, psnip_int64_t operand) {
+  psnip_int64_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) - operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int64_t
+psnip_atomic_int64_fetch_or(psnip_atomic_int64* object, psnip_int64_t operand) {
+  psnip_int64_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) | operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int64_t
+psnip_atomic_int64_fetch_and(psnip_atomic_int64* object, psnip_int64_t operand) {
+  psnip_int64_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) & operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int64_t
+psnip_atomic_int64_fetch_xor(psnip_atomic_int64* object, psnip_int64_t operand) {
+  psnip_int64_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) ^ operand;
   return ret;
 }
+
+#define psnip_atomic_int64_add(object, operand) \
+  psnip_atomic_int64_fetch_add(object, operand)
+#define psnip_atomic_int64_sub(object, operand) \
+  psnip_atomic_int64_fetch_sub(object, operand)
+
 PSNIP_ATOMIC__FUNCTION
 psnip_int32_t
 psnip_atomic_int32_load(psnip_atomic_int32* object) {
@@ -359,9 +1405,9 @@ psnip_atomic_int32_store(psnip_atomic_int32* object, psnip_int32_t desired) {
 PSNIP_ATOMIC__FUNCTION
 int
 psnip_atomic_int32_compare_exchange_(psnip_atomic_int32* object, psnip_int32_t* expected, psnip_int32_t desired) {
-  int ret = 1;
+  int ret;
 #pragma omp critical(psnip_atomic)
-  ret = (*object == *expected) ? ((*object = desired), 1) : 0;
+  ret = (*object == *expected) ? ((*object = desired), 1) : ((*expected = *object), 0);
   return ret;
 }
 
@@ -370,8 +1416,17 @@ psnip_atomic_int32_compare_exchange_(psnip_atomic_int32* object, psnip_int32_t*
 
 PSNIP_ATOMIC__FUNCTION
 psnip_int32_t
-psnip_atomic_int32_add(psnip_atomic_int32* object, psnip_int32_t operand) {
-  int ret;
+psnip_atomic_int32_exchange(psnip_atomic_int32* object, psnip_int32_t desired) {
+  psnip_int32_t ret;
+#pragma omp critical(psnip_atomic)
+  { ret = *object; *object = desired; }
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int32_t
+psnip_atomic_int32_fetch_add(psnip_atomic_int32* object, psnip_int32_t operand) {
+  psnip_int32_t ret;
 #pragma omp critical(psnip_atomic)
   *object = (ret = *object) + operand;
   return ret;
@@ -379,20 +1434,368 @@ psnip_atomic_int32_add(psnip_atomic_int32* object, psnip_int32_t operand) {
 
 PSNIP_ATOMIC__FUNCTION
 psnip_int32_t
-psnip_atomic_int32_sub(psnip_atomic_int32* object, psnip_int32_t operand) {
+psnip_atomic_int32_fetch_sub(psnip_atomic_int32* object, psnip_int32_t operand) {
+  psnip_int32_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) - operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int32_t
+psnip_atomic_int32_fetch_or(psnip_atomic_int32* object, psnip_int32_t operand) {
+  psnip_int32_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) | operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int32_t
+psnip_atomic_int32_fetch_and(psnip_atomic_int32* object, psnip_int32_t operand) {
+  psnip_int32_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) & operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int32_t
+psnip_atomic_int32_fetch_xor(psnip_atomic_int32* object, psnip_int32_t operand) {
+  psnip_int32_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) ^ operand;
+  return ret;
+}
+
+#define psnip_atomic_int32_add(object, operand) \
+  psnip_atomic_int32_fetch_add(object, operand)
+#define psnip_atomic_int32_sub(object, operand) \
+  psnip_atomic_int32_fetch_sub(object, operand)
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int16_t
+psnip_atomic_int16_load(psnip_atomic_int16* object) {
+  psnip_int16_t ret;
+#pragma omp critical(psnip_atomic)
+  ret = *object;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_int16_store(psnip_atomic_int16* object, psnip_int16_t desired) {
+#pragma omp critical(psnip_atomic)
+  *object = desired;
+}
+
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_int16_compare_exchange_(psnip_atomic_int16* object, psnip_int16_t* expected, psnip_int16_t desired) {
+  int ret;
+#pragma omp critical(psnip_atomic)
+  ret = (*object == *expected) ? ((*object = desired), 1) : ((*expected = *object), 0);
+  return ret;
+}
+
+#define psnip_atomic_int16_compare_exchange(object, expected, desired) \
+  psnip_atomic_int16_compare_exchange_(object, expected, desired)
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int16_t
+psnip_atomic_int16_exchange(psnip_atomic_int16* object, psnip_int16_t desired) {
+  psnip_int16_t ret;
+#pragma omp critical(psnip_atomic)
+  { ret = *object; *object = desired; }
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int16_t
+psnip_atomic_int16_fetch_add(psnip_atomic_int16* object, psnip_int16_t operand) {
+  psnip_int16_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) + operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int16_t
+psnip_atomic_int16_fetch_sub(psnip_atomic_int16* object, psnip_int16_t operand) {
+  psnip_int16_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) - operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int16_t
+psnip_atomic_int16_fetch_or(psnip_atomic_int16* object, psnip_int16_t operand) {
+  psnip_int16_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) | operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int16_t
+psnip_atomic_int16_fetch_and(psnip_atomic_int16* object, psnip_int16_t operand) {
+  psnip_int16_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) & operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int16_t
+psnip_atomic_int16_fetch_xor(psnip_atomic_int16* object, psnip_int16_t operand) {
+  psnip_int16_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) ^ operand;
+  return ret;
+}
+
+#define psnip_atomic_int16_add(object, operand) \
+  psnip_atomic_int16_fetch_add(object, operand)
+#define psnip_atomic_int16_sub(object, operand) \
+  psnip_atomic_int16_fetch_sub(object, operand)
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int8_t
+psnip_atomic_int8_load(psnip_atomic_int8* object) {
+  psnip_int8_t ret;
+#pragma omp critical(psnip_atomic)
+  ret = *object;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_int8_store(psnip_atomic_int8* object, psnip_int8_t desired) {
+#pragma omp critical(psnip_atomic)
+  *object = desired;
+}
+
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_int8_compare_exchange_(psnip_atomic_int8* object, psnip_int8_t* expected, psnip_int8_t desired) {
   int ret;
+#pragma omp critical(psnip_atomic)
+  ret = (*object == *expected) ? ((*object = desired), 1) : ((*expected = *object), 0);
+  return ret;
+}
+
+#define psnip_atomic_int8_compare_exchange(object, expected, desired) \
+  psnip_atomic_int8_compare_exchange_(object, expected, desired)
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int8_t
+psnip_atomic_int8_exchange(psnip_atomic_int8* object, psnip_int8_t desired) {
+  psnip_int8_t ret;
+#pragma omp critical(psnip_atomic)
+  { ret = *object; *object = desired; }
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int8_t
+psnip_atomic_int8_fetch_add(psnip_atomic_int8* object, psnip_int8_t operand) {
+  psnip_int8_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) + operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int8_t
+psnip_atomic_int8_fetch_sub(psnip_atomic_int8* object, psnip_int8_t operand) {
+  psnip_int8_t ret;
 #pragma omp critical(psnip_atomic)
   *object = (ret = *object) - operand;
   return ret;
 }
 
+PSNIP_ATOMIC__FUNCTION
+psnip_int8_t
+psnip_atomic_int8_fetch_or(psnip_atomic_int8* object, psnip_int8_t operand) {
+  psnip_int8_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) | operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int8_t
+psnip_atomic_int8_fetch_and(psnip_atomic_int8* object, psnip_int8_t operand) {
+  psnip_int8_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) & operand;
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+psnip_int8_t
+psnip_atomic_int8_fetch_xor(psnip_atomic_int8* object, psnip_int8_t operand) {
+  psnip_int8_t ret;
+#pragma omp critical(psnip_atomic)
+  *object = (ret = *object) ^ operand;
+  return ret;
+}
+
+#define psnip_atomic_int8_add(object, operand) \
+  psnip_atomic_int8_fetch_add(object, operand)
+#define psnip_atomic_int8_sub(object, operand) \
+  psnip_atomic_int8_fetch_sub(object, operand)
+
+PSNIP_ATOMIC__FUNCTION
+void*
+psnip_atomic_ptr_load(psnip_atomic_ptr* object) {
+  void* ret;
+#pragma omp critical(psnip_atomic)
+  ret = *object;
+  return ret;
+}
+
 PSNIP_ATOMIC__FUNCTION
 void
-psnip_atomic_fence() {
+psnip_atomic_ptr_store(psnip_atomic_ptr* object, void* desired) {
+#pragma omp critical(psnip_atomic)
+  *object = desired;
+}
+
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_ptr_compare_exchange_(psnip_atomic_ptr* object, void** expected, void* desired) {
+  int ret;
+#pragma omp critical(psnip_atomic)
+  ret = (*object == *expected) ? ((*object = desired), 1) : ((*expected = *object), 0);
+  return ret;
+}
+
+#define psnip_atomic_ptr_compare_exchange(object, expected, desired) \
+  psnip_atomic_ptr_compare_exchange_(object, expected, desired)
+
+PSNIP_ATOMIC__FUNCTION
+void*
+psnip_atomic_ptr_exchange(psnip_atomic_ptr* object, void* desired) {
+  void* ret;
+#pragma omp critical(psnip_atomic)
+  { ret = *object; *object = desired; }
+  return ret;
+}
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_fence(void) {
 #pragma omp critical(psnip_atomic)
   { }
 }
 
+/* Everything goes through the same critical section, so the memory
+ * order doesn't matter. */
+#define psnip_atomic_int64_load_explicit(object, order) \
+  psnip_atomic_int64_load(object)
+#define psnip_atomic_int64_store_explicit(object, desired, order) \
+  psnip_atomic_int64_store(object, desired)
+#define psnip_atomic_int64_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_int64_compare_exchange(object, expected, desired)
+#define psnip_atomic_int64_add_explicit(object, operand, order) \
+  psnip_atomic_int64_add(object, operand)
+#define psnip_atomic_int64_sub_explicit(object, operand, order) \
+  psnip_atomic_int64_sub(object, operand)
+#define psnip_atomic_int64_exchange_explicit(object, desired, order) \
+  psnip_atomic_int64_exchange(object, desired)
+#define psnip_atomic_int64_fetch_add_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_add(object, operand)
+#define psnip_atomic_int64_fetch_sub_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_sub(object, operand)
+#define psnip_atomic_int64_fetch_or_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_or(object, operand)
+#define psnip_atomic_int64_fetch_and_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_and(object, operand)
+#define psnip_atomic_int64_fetch_xor_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_xor(object, operand)
+
+#define psnip_atomic_int32_load_explicit(object, order) \
+  psnip_atomic_int32_load(object)
+#define psnip_atomic_int32_store_explicit(object, desired, order) \
+  psnip_atomic_int32_store(object, desired)
+#define psnip_atomic_int32_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_int32_compare_exchange(object, expected, desired)
+#define psnip_atomic_int32_add_explicit(object, operand, order) \
+  psnip_atomic_int32_add(object, operand)
+#define psnip_atomic_int32_sub_explicit(object, operand, order) \
+  psnip_atomic_int32_sub(object, operand)
+#define psnip_atomic_int32_exchange_explicit(object, desired, order) \
+  psnip_atomic_int32_exchange(object, desired)
+#define psnip_atomic_int32_fetch_add_explicit(object, operand, order) \
+  psnip_atomic_int32_fetch_add(object, operand)
+#define psnip_atomic_int32_fetch_sub_explicit(object, operand, order) \
+  psnip_atomic_int32_fetch_sub(object, operand)
+#define psnip_atomic_int32_fetch_or_explicit(object, operand, order) \
+  psnip_atomic_int32_fetch_or(object, operand)
+#define psnip_atomic_int32_fetch_and_explicit(object, operand, order) \
+  psnip_atomic_int32_fetch_and(object, operand)
+#define psnip_atomic_int32_fetch_xor_explicit(object, operand, order) \
+  psnip_atomic_int32_fetch_xor(object, operand)
+
+#define psnip_atomic_int16_load_explicit(object, order) \
+  psnip_atomic_int16_load(object)
+#define psnip_atomic_int16_store_explicit(object, desired, order) \
+  psnip_atomic_int16_store(object, desired)
+#define psnip_atomic_int16_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_int16_compare_exchange(object, expected, desired)
+#define psnip_atomic_int16_add_explicit(object, operand, order) \
+  psnip_atomic_int16_add(object, operand)
+#define psnip_atomic_int16_sub_explicit(object, operand, order) \
+  psnip_atomic_int16_sub(object, operand)
+#define psnip_atomic_int16_exchange_explicit(object, desired, order) \
+  psnip_atomic_int16_exchange(object, desired)
+#define psnip_atomic_int16_fetch_add_explicit(object, operand, order) \
+  psnip_atomic_int16_fetch_add(object, operand)
+#define psnip_atomic_int16_fetch_sub_explicit(object, operand, order) \
+  psnip_atomic_int16_fetch_sub(object, operand)
+#define psnip_atomic_int16_fetch_or_explicit(object, operand, order) \
+  psnip_atomic_int16_fetch_or(object, operand)
+#define psnip_atomic_int16_fetch_and_explicit(object, operand, order) \
+  psnip_atomic_int16_fetch_and(object, operand)
+#define psnip_atomic_int16_fetch_xor_explicit(object, operand, order) \
+  psnip_atomic_int16_fetch_xor(object, operand)
+
+#define psnip_atomic_int8_load_explicit(object, order) \
+  psnip_atomic_int8_load(object)
+#define psnip_atomic_int8_store_explicit(object, desired, order) \
+  psnip_atomic_int8_store(object, desired)
+#define psnip_atomic_int8_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_int8_compare_exchange(object, expected, desired)
+#define psnip_atomic_int8_add_explicit(object, operand, order) \
+  psnip_atomic_int8_add(object, operand)
+#define psnip_atomic_int8_sub_explicit(object, operand, order) \
+  psnip_atomic_int8_sub(object, operand)
+#define psnip_atomic_int8_exchange_explicit(object, desired, order) \
+  psnip_atomic_int8_exchange(object, desired)
+#define psnip_atomic_int8_fetch_add_explicit(object, operand, order) \
+  psnip_atomic_int8_fetch_add(object, operand)
+#define psnip_atomic_int8_fetch_sub_explicit(object, operand, order) \
+  psnip_atomic_int8_fetch_sub(object, operand)
+#define psnip_atomic_int8_fetch_or_explicit(object, operand, order) \
+  psnip_atomic_int8_fetch_or(object, operand)
+#define psnip_atomic_int8_fetch_and_explicit(object, operand, order) \
+  psnip_atomic_int8_fetch_and(object, operand)
+#define psnip_atomic_int8_fetch_xor_explicit(object, operand, order) \
+  psnip_atomic_int8_fetch_xor(object, operand)
+
+#define psnip_atomic_ptr_load_explicit(object, order) \
+  psnip_atomic_ptr_load(object)
+#define psnip_atomic_ptr_store_explicit(object, desired, order) \
+  psnip_atomic_ptr_store(object, desired)
+#define psnip_atomic_ptr_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_ptr_compare_exchange(object, expected, desired)
+#define psnip_atomic_ptr_exchange_explicit(object, desired, order) \
+  psnip_atomic_ptr_exchange(object, desired)
+
+#define psnip_atomic_fence_explicit(order) \
+  psnip_atomic_fence()
 
 #endif
 
@@ -400,6 +1803,22 @@ psnip_atomic_fence() {
 #  define PSNIP_ATOMIC_VAR_INIT(value) (value)
 #endif
 
+#if !defined(PSNIP_ATOMIC_ORDER_RELAXED)
+#  if defined(__ATOMIC_RELAXED)
+#    define PSNIP_ATOMIC_ORDER_RELAXED __ATOMIC_RELAXED
+#    define PSNIP_ATOMIC_ORDER_ACQUIRE __ATOMIC_ACQUIRE
+#    define PSNIP_ATOMIC_ORDER_RELEASE __ATOMIC_RELEASE
+#    define PSNIP_ATOMIC_ORDER_ACQ_REL __ATOMIC_ACQ_REL
+#    define PSNIP_ATOMIC_ORDER_SEQ_CST __ATOMIC_SEQ_CST
+#  else
+#    define PSNIP_ATOMIC_ORDER_RELAXED 0
+#    define PSNIP_ATOMIC_ORDER_ACQUIRE 2
+#    define PSNIP_ATOMIC_ORDER_RELEASE 3
+#    define PSNIP_ATOMIC_ORDER_ACQ_REL 4
+#    define PSNIP_ATOMIC_ORDER_SEQ_CST 5
+#  endif
+#endif
+
 /* Most compilers have type-generic atomic implementations. */
 #if defined(PSNIP_ATOMIC_IS_TG)
 #define psnip_atomic_int32_load(object) \
@@ -412,8 +1831,324 @@ psnip_atomic_fence() {
   psnip_atomic_int64_add(object, operand)
 #define psnip_atomic_int32_sub(object, operand) \
   psnip_atomic_int64_sub(object, operand)
+
+#define psnip_atomic_int32_load_explicit(object, order) \
+  psnip_atomic_int64_load_explicit(object, order)
+#define psnip_atomic_int32_store_explicit(object, desired, order) \
+  psnip_atomic_int64_store_explicit(object, desired, order)
+#define psnip_atomic_int32_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_int64_compare_exchange_explicit(object, expected, desired, success, failure)
+#define psnip_atomic_int32_add_explicit(object, operand, order) \
+  psnip_atomic_int64_add_explicit(object, operand, order)
+#define psnip_atomic_int32_sub_explicit(object, operand, order) \
+  psnip_atomic_int64_sub_explicit(object, operand, order)
+
+#define psnip_atomic_ptr_load(object) \
+  psnip_atomic_int64_load(object)
+#define psnip_atomic_ptr_store(object, desired)  \
+  psnip_atomic_int64_store(object, desired)
+#define psnip_atomic_ptr_compare_exchange(object, expected, desired)  \
+  psnip_atomic_int64_compare_exchange(object, expected, desired)
+
+#define psnip_atomic_ptr_load_explicit(object, order) \
+  psnip_atomic_int64_load_explicit(object, order)
+#define psnip_atomic_ptr_store_explicit(object, desired, order) \
+  psnip_atomic_int64_store_explicit(object, desired, order)
+#define psnip_atomic_ptr_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_int64_compare_exchange_explicit(object, expected, desired, success, failure)
+
+#define psnip_atomic_int32_exchange(object, desired) \
+  psnip_atomic_int64_exchange(object, desired)
+#define psnip_atomic_int32_fetch_add(object, operand) \
+  psnip_atomic_int64_fetch_add(object, operand)
+#define psnip_atomic_int32_fetch_sub(object, operand) \
+  psnip_atomic_int64_fetch_sub(object, operand)
+#define psnip_atomic_int32_fetch_or(object, operand) \
+  psnip_atomic_int64_fetch_or(object, operand)
+#define psnip_atomic_int32_fetch_and(object, operand) \
+  psnip_atomic_int64_fetch_and(object, operand)
+#define psnip_atomic_int32_fetch_xor(object, operand) \
+  psnip_atomic_int64_fetch_xor(object, operand)
+
+#define psnip_atomic_int32_exchange_explicit(object, desired, order) \
+  psnip_atomic_int64_exchange_explicit(object, desired, order)
+#define psnip_atomic_int32_fetch_add_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_add_explicit(object, operand, order)
+#define psnip_atomic_int32_fetch_sub_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_sub_explicit(object, operand, order)
+#define psnip_atomic_int32_fetch_or_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_or_explicit(object, operand, order)
+#define psnip_atomic_int32_fetch_and_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_and_explicit(object, operand, order)
+#define psnip_atomic_int32_fetch_xor_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_xor_explicit(object, operand, order)
+
+#define psnip_atomic_ptr_exchange(object, desired) \
+  psnip_atomic_int64_exchange(object, desired)
+#define psnip_atomic_ptr_exchange_explicit(object, desired, order) \
+  psnip_atomic_int64_exchange_explicit(object, desired, order)
+
+#define psnip_atomic_int16_load(object) \
+  psnip_atomic_int64_load(object)
+#define psnip_atomic_int16_store(object, desired)  \
+  psnip_atomic_int64_store(object, desired)
+#define psnip_atomic_int16_compare_exchange(object, expected, desired)  \
+  psnip_atomic_int64_compare_exchange(object, expected, desired)
+#define psnip_atomic_int16_add(object, operand) \
+  psnip_atomic_int64_add(object, operand)
+#define psnip_atomic_int16_sub(object, operand) \
+  psnip_atomic_int64_sub(object, operand)
+#define psnip_atomic_int16_load_explicit(object, order) \
+  psnip_atomic_int64_load_explicit(object, order)
+#define psnip_atomic_int16_store_explicit(object, desired, order) \
+  psnip_atomic_int64_store_explicit(object, desired, order)
+#define psnip_atomic_int16_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_int64_compare_exchange_explicit(object, expected, desired, success, failure)
+#define psnip_atomic_int16_add_explicit(object, operand, order) \
+  psnip_atomic_int64_add_explicit(object, operand, order)
+#define psnip_atomic_int16_sub_explicit(object, operand, order) \
+  psnip_atomic_int64_sub_explicit(object, operand, order)
+#define psnip_atomic_int16_exchange(object, desired) \
+  psnip_atomic_int64_exchange(object, desired)
+#define psnip_atomic_int16_fetch_add(object, operand) \
+  psnip_atomic_int64_fetch_add(object, operand)
+#define psnip_atomic_int16_fetch_sub(object, operand) \
+  psnip_atomic_int64_fetch_sub(object, operand)
+#define psnip_atomic_int16_fetch_or(object, operand) \
+  psnip_atomic_int64_fetch_or(object, operand)
+#define psnip_atomic_int16_fetch_and(object, operand) \
+  psnip_atomic_int64_fetch_and(object, operand)
+#define psnip_atomic_int16_fetch_xor(object, operand) \
+  psnip_atomic_int64_fetch_xor(object, operand)
+#define psnip_atomic_int16_exchange_explicit(object, desired, order) \
+  psnip_atomic_int64_exchange_explicit(object, desired, order)
+#define psnip_atomic_int16_fetch_add_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_add_explicit(object, operand, order)
+#define psnip_atomic_int16_fetch_sub_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_sub_explicit(object, operand, order)
+#define psnip_atomic_int16_fetch_or_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_or_explicit(object, operand, order)
+#define psnip_atomic_int16_fetch_and_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_and_explicit(object, operand, order)
+#define psnip_atomic_int16_fetch_xor_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_xor_explicit(object, operand, order)
+
+#define psnip_atomic_int8_load(object) \
+  psnip_atomic_int64_load(object)
+#define psnip_atomic_int8_store(object, desired)  \
+  psnip_atomic_int64_store(object, desired)
+#define psnip_atomic_int8_compare_exchange(object, expected, desired)  \
+  psnip_atomic_int64_compare_exchange(object, expected, desired)
+#define psnip_atomic_int8_add(object, operand) \
+  psnip_atomic_int64_add(object, operand)
+#define psnip_atomic_int8_sub(object, operand) \
+  psnip_atomic_int64_sub(object, operand)
+#define psnip_atomic_int8_load_explicit(object, order) \
+  psnip_atomic_int64_load_explicit(object, order)
+#define psnip_atomic_int8_store_explicit(object, desired, order) \
+  psnip_atomic_int64_store_explicit(object, desired, order)
+#define psnip_atomic_int8_compare_exchange_explicit(object, expected, desired, success, failure) \
+  psnip_atomic_int64_compare_exchange_explicit(object, expected, desired, success, failure)
+#define psnip_atomic_int8_add_explicit(object, operand, order) \
+  psnip_atomic_int64_add_explicit(object, operand, order)
+#define psnip_atomic_int8_sub_explicit(object, operand, order) \
+  psnip_atomic_int64_sub_explicit(object, operand, order)
+#define psnip_atomic_int8_exchange(object, desired) \
+  psnip_atomic_int64_exchange(object, desired)
+#define psnip_atomic_int8_fetch_add(object, operand) \
+  psnip_atomic_int64_fetch_add(object, operand)
+#define psnip_atomic_int8_fetch_sub(object, operand) \
+  psnip_atomic_int64_fetch_sub(object, operand)
+#define psnip_atomic_int8_fetch_or(object, operand) \
+  psnip_atomic_int64_fetch_or(object, operand)
+#define psnip_atomic_int8_fetch_and(object, operand) \
+  psnip_atomic_int64_fetch_and(object, operand)
+#define psnip_atomic_int8_fetch_xor(object, operand) \
+  psnip_atomic_int64_fetch_xor(object, operand)
+#define psnip_atomic_int8_exchange_explicit(object, desired, order) \
+  psnip_atomic_int64_exchange_explicit(object, desired, order)
+#define psnip_atomic_int8_fetch_add_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_add_explicit(object, operand, order)
+#define psnip_atomic_int8_fetch_sub_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_sub_explicit(object, operand, order)
+#define psnip_atomic_int8_fetch_or_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_or_explicit(object, operand, order)
+#define psnip_atomic_int8_fetch_and_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_and_explicit(object, operand, order)
+#define psnip_atomic_int8_fetch_xor_explicit(object, operand, order) \
+  psnip_atomic_int64_fetch_xor_explicit(object, operand, order)
 #endif /* defined(PSNIP_ATOMIC_IS_TG) */
 
+/* Everything except C11 builds the flag on top of an int8; exchange
+ * is as cheap as a real test-and-set instruction almost everywhere. */
+#if !defined(PSNIP_ATOMIC_FLAG_INIT)
+typedef psnip_atomic_int8 psnip_atomic_flag;
+
+#define PSNIP_ATOMIC_FLAG_INIT PSNIP_ATOMIC_VAR_INIT(0)
+
+#define psnip_atomic_flag_test_and_set_explicit(object, order) \
+  (psnip_atomic_int8_exchange_explicit(object, 1, order) != 0)
+#define psnip_atomic_flag_clear_explicit(object, order) \
+  psnip_atomic_int8_store_explicit(object, 0, order)
+#define psnip_atomic_flag_test_and_set(object) \
+  psnip_atomic_flag_test_and_set_explicit(object, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#define psnip_atomic_flag_clear(object) \
+  psnip_atomic_flag_clear_explicit(object, PSNIP_ATOMIC_ORDER_SEQ_CST)
+#endif
+
 #endif /* !defined(PSNIP_ATOMIC_NOT_FOUND) */
 
+/* Double-width compare & swap.  This doesn't depend on the backend
+ * selected above; it's either an instruction we can use directly or
+ * it isn't available. */
+
+#if defined(_MSC_VER)
+#  define PSNIP_ATOMIC__ALIGN16 __declspec(align(16))
+#else
+#  define PSNIP_ATOMIC__ALIGN16 __attribute__((__aligned__(16)))
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#  define PSNIP_ATOMIC_HAVE_UINT128
+#  define PSNIP_ATOMIC__UINT128_CMPXCHG16B
+#  if !defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+#    define PSNIP_ATOMIC_UINT128_NEEDS_CX16
+#  endif
+#elif defined(__GNUC__) && defined(__aarch64__)
+#  define PSNIP_ATOMIC_HAVE_UINT128
+#  if defined(__ARM_FEATURE_ATOMICS)
+#    define PSNIP_ATOMIC__UINT128_CASP
+#  else
+#    define PSNIP_ATOMIC__UINT128_LDAXP
+#  endif
+#elif defined(_MSC_VER) && (_MSC_VER >= 1500) && (defined(_M_AMD64) || defined(_M_ARM64))
+#  define PSNIP_ATOMIC_HAVE_UINT128
+#  define PSNIP_ATOMIC__UINT128_MS
+#  if defined(_M_AMD64)
+#    define PSNIP_ATOMIC_UINT128_NEEDS_CX16
+#  endif
+#elif defined(__GNUC__) && defined(__SIZEOF_INT128__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+#  define PSNIP_ATOMIC_HAVE_UINT128
+#  define PSNIP_ATOMIC__UINT128_SYNC
+#endif
+
+#if defined(PSNIP_ATOMIC_HAVE_UINT128)
+
+#if defined(PSNIP_ATOMIC__UINT128_MS)
+#  include <intrin.h>
+#endif
+
+typedef struct PSNIP_ATOMIC__ALIGN16 {
+  psnip_uint64_t lo;
+  psnip_uint64_t hi;
+} psnip_atomic_uint128;
+
+#if defined(PSNIP_ATOMIC__UINT128_CMPXCHG16B)
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_uint128_compare_exchange(psnip_atomic_uint128* object, psnip_atomic_uint128* expected, psnip_atomic_uint128 desired) {
+  unsigned char r;
+
+  /* On failure cmpxchg16b leaves the current value in rdx:rax. */
+  __asm__ __volatile__ (
+    "lock; cmpxchg16b %1\n\t"
+    "sete %0"
+    : "=q" (r), "+m" (*object), "+a" (expected->lo), "+d" (expected->hi)
+    : "b" (desired.lo), "c" (desired.hi)
+    : "memory", "cc");
+
+  return r;
+}
+#elif defined(PSNIP_ATOMIC__UINT128_CASP)
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_uint128_compare_exchange(psnip_atomic_uint128* object, psnip_atomic_uint128* expected, psnip_atomic_uint128 desired) {
+  /* casp needs each pair in consecutive registers, starting with an
+   * even one. */
+  register psnip_uint64_t x0 __asm__("x0") = expected->lo;
+  register psnip_uint64_t x1 __asm__("x1") = expected->hi;
+  register psnip_uint64_t x2 __asm__("x2") = desired.lo;
+  register psnip_uint64_t x3 __asm__("x3") = desired.hi;
+  const psnip_uint64_t lo = x0, hi = x1;
+
+  __asm__ __volatile__ (
+    "caspal %0, %1, %3, %4, %2"
+    : "+r" (x0), "+r" (x1), "+Q" (*object)
+    : "r" (x2), "r" (x3)
+    : "memory");
+
+  expected->lo = x0;
+  expected->hi = x1;
+  return (x0 == lo) && (x1 == hi);
+}
+#elif defined(PSNIP_ATOMIC__UINT128_LDAXP)
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_uint128_compare_exchange(psnip_atomic_uint128* object, psnip_atomic_uint128* expected, psnip_atomic_uint128 desired) {
+  psnip_uint64_t lo, hi;
+  unsigned int failed;
+
+  /* If the comparison fails we still store the value we loaded;
+   * that's the only way to know the 128-bit load was atomic. */
+  __asm__ __volatile__ (
+    "1:\n\t"
+    "ldaxp %0, %1, %3\n\t"
+    "cmp %0, %4\n\t"
+    "ccmp %1, %5, #0, eq\n\t"
+    "b.ne 2f\n\t"
+    "stlxp %w2, %6, %7, %3\n\t"
+    "cbnz %w2, 1b\n\t"
+    "b 3f\n"
+    "2:\n\t"
+    "stlxp %w2, %0, %1, %3\n\t"
+    "cbnz %w2, 1b\n"
+    "3:"
+    : "=&r" (lo), "=&r" (hi), "=&r" (failed), "+Q" (*object)
+    : "r" (expected->lo), "r" (expected->hi), "r" (desired.lo), "r" (desired.hi)
+    : "memory", "cc");
+
+  if (lo == expected->lo && hi == expected->hi)
+    return 1;
+  expected->lo = lo;
+  expected->hi = hi;
+  return 0;
+}
+#elif defined(PSNIP_ATOMIC__UINT128_MS)
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_uint128_compare_exchange(psnip_atomic_uint128* object, psnip_atomic_uint128* expected, psnip_atomic_uint128 desired) {
+  /* Writes the current value to *expected whether or not it
+   * succeeds, which is exactly what we want. */
+  return _InterlockedCompareExchange128((__int64 volatile*) object, (__int64) desired.hi, (__int64) desired.lo, (__int64*) expected) != 0;
+}
+#elif defined(PSNIP_ATOMIC__UINT128_SYNC)
+__extension__ typedef unsigned __int128 psnip_atomic__uint128_t;
+
+PSNIP_ATOMIC__FUNCTION
+int
+psnip_atomic_uint128_compare_exchange(psnip_atomic_uint128* object, psnip_atomic_uint128* expected, psnip_atomic_uint128 desired) {
+  const psnip_atomic__uint128_t e = (((psnip_atomic__uint128_t) expected->hi) << 64) | expected->lo;
+  const psnip_atomic__uint128_t d = (((psnip_atomic__uint128_t) desired.hi) << 64) | desired.lo;
+  const psnip_atomic__uint128_t v = __sync_val_compare_and_swap((psnip_atomic__uint128_t*) object, e, d);
+
+  if (v == e)
+    return 1;
+  expected->lo = (psnip_uint64_t) v;
+  expected->hi = (psnip_uint64_t) (v >> 64);
+  return 0;
+}
+#endif
+
+PSNIP_ATOMIC__FUNCTION
+void
+psnip_atomic_uint128_load(psnip_atomic_uint128* object, psnip_atomic_uint128* value) {
+  /* If the object happens to hold zero this stores zero over it,
+   * which is harmless; otherwise it fails and gives us the value. */
+  value->lo = 0;
+  value->hi = 0;
+  psnip_atomic_uint128_compare_exchange(object, value, *value);
+}
+
+#endif /* defined(PSNIP_ATOMIC_HAVE_UINT128) */
+
 #endif /* defined(PSNIP_ATOMIC_H) */
@@ -0,0 +1,211 @@
+/* Bitset Iteration (v1)
+ * Portable Snippets - https://github.com/nemequ/portable-snippets
+ * Created by Evan Nemerson <evan@nemerson.com>
+ *
+ *   To the extent possible under law, the authors have waived all
+ *   copyright and related or neighboring rights to this code.  For
+ *   details, see the Creative Commons Zero 1.0 Universal license at
+ *   https://creativecommons.org/publicdomain/zero/1.0/
+ *
+ * Decodes the positions of the set bits in an array of 64-bit words
+ * into an array of 32-bit indices, a batch at a time:
+ *
+ *   struct PsnipBitsetIter iter;
+ *   psnip_uint32_t batch[256];
+ *   size_t n, i;
+ *
+ *   psnip_bitset_iter_init (&iter, words, n_words);
+ *   while ((n = psnip_bitset_iter_next (&iter, batch, 256)) != 0)
+ *     for (i = 0 ; i < n ; i++)
+ *       visit (batch[i]);
+ *
+ * Bit b of words[w] has index (w * 64) + b, so the bitset can hold at
+ * most 2^32 bits.  Indices come out in ascending order.
+ *
+ * With AVX-512 each word is decoded 16 bits at a time with
+ * vpcompressd; otherwise it's ctz and x &= x - 1.  As with
+ * psnip_builtin_popcount_array, including cpu.h before this header
+ * (and linking cpu.c) lets the AVX-512 version be chosen at run
+ * time, if the CPU supports it and the OS has enabled it.
+ */
+
+#if !defined(PSNIP_BITSET_H)
+#define PSNIP_BITSET_H
+
+#if !defined(PSNIP_BUILTIN_H)
+#  include "../builtin/builtin.h"
+#endif
+
+#include <stddef.h>
+
+#if !defined(PSNIP_BITSET_STATIC_INLINE)
+#  if defined(__GNUC__)
+#    define PSNIP_BITSET__COMPILER_ATTRIBUTES __attribute__((__unused__))
+#  else
+#    define PSNIP_BITSET__COMPILER_ATTRIBUTES
+#  endif
+
+#  if defined(HEDLEY_INLINE)
+#    define PSNIP_BITSET__INLINE HEDLEY_INLINE
+#  elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#    define PSNIP_BITSET__INLINE inline
+#  elif defined(__GNUC_STDC_INLINE__)
+#    define PSNIP_BITSET__INLINE __inline__
+#  elif defined(_MSC_VER) && _MSC_VER >= 1200
+#    define PSNIP_BITSET__INLINE __inline
+#  else
+#    define PSNIP_BITSET__INLINE
+#  endif
+
+#  define PSNIP_BITSET__FUNCTION PSNIP_BITSET__COMPILER_ATTRIBUTES static PSNIP_BITSET__INLINE
+#endif
+
+#if defined(__i386) || defined(_M_IX86) || defined(__amd64) || defined(_M_AMD64) || defined(__x86_64)
+#  if defined(__AVX512F__)
+#    define PSNIP_BITSET__AVX512
+#    define PSNIP_BITSET__TARGET_AVX512
+#  elif \
+  (defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) && (__GNUC__ >= 5)) || \
+  (defined(__clang__) && ((__clang_major__ > 3) || (__clang_major__ == 3 && __clang_minor__ >= 9)))
+#    define PSNIP_BITSET__AVX512
+#    define PSNIP_BITSET__TARGET_AVX512 __attribute__((__target__("avx512f")))
+#  elif defined(_MSC_VER) && (_MSC_VER >= 1910) && !defined(__clang__)
+#    define PSNIP_BITSET__AVX512
+#    define PSNIP_BITSET__TARGET_AVX512
+#  endif
+
+#  if defined(PSNIP_BITSET__AVX512)
+#    include <immintrin.h>
+#  endif
+#endif
+
+struct PsnipBitsetIter {
+  const psnip_uint64_t* words;
+  size_t n_words;
+  /* Index of the word we're working on, and its bits which haven't
+   * been returned yet. */
+  size_t word;
+  psnip_uint64_t current;
+};
+
+PSNIP_BITSET__FUNCTION
+void
+psnip_bitset_iter_init (struct PsnipBitsetIter* iter, const psnip_uint64_t* words, size_t n_words) {
+  iter->words = words;
+  iter->n_words = n_words;
+  iter->word = 0;
+  iter->current = (n_words > 0) ? words[0] : 0;
+}
+
+PSNIP_BITSET__FUNCTION
+size_t
+psnip_bitset__decode_word_portable (psnip_uint64_t w, psnip_uint32_t base, psnip_uint32_t* out) {
+  size_t n = 0;
+
+  while (w != 0) {
+    out[n++] = base + (psnip_uint32_t) psnip_builtin_ctz64 (w);
+    w &= w - 1;
+  }
+
+  return n;
+}
+
+#if defined(PSNIP_BITSET__AVX512)
+/* Writes 16 indices for every 16 bits, whether or not they're set, so
+ * out needs room for 64 entries no matter how few bits w has. */
+PSNIP_BITSET__FUNCTION PSNIP_BITSET__TARGET_AVX512
+size_t
+psnip_bitset__decode_word_avx512 (psnip_uint64_t w, psnip_uint32_t base, psnip_uint32_t* out) {
+  const __m512i step = _mm512_set1_epi32 (16);
+  __m512i idx = _mm512_add_epi32 (_mm512_set1_epi32 ((int) base),
+                                   _mm512_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+  __mmask16 m;
+  size_t n = 0;
+  int i;
+
+  for (i = 0 ; i < 4 ; i++) {
+    m = (__mmask16) (w >> (i * 16));
+    _mm512_storeu_si512 ((void*) (out + n), _mm512_maskz_compress_epi32 (m, idx));
+    n += (size_t) psnip_builtin_popcount32 ((psnip_uint32_t) m);
+    idx = _mm512_add_epi32 (idx, step);
+  }
+
+  return n;
+}
+
+#  if !defined(__AVX512F__) && defined(PSNIP_CPU__H)
+/* Whether the CPU and OS support AVX-512, checked on the first call
+ * so psnip_bitset_iter_next doesn't call into cpu.c for every batch.
+ * Threads which race to set it all store the same value. */
+PSNIP_BITSET__FUNCTION
+int
+psnip_bitset__avx512_usable (void) {
+  static int usable = -1;
+
+  if (usable < 0)
+    usable = psnip_cpu_feature_usable (PSNIP_CPU_FEATURE_X86_AVX512F);
+
+  return usable;
+}
+#  endif
+#endif
+
+/* Store the indices of up to max set bits in out, continuing from
+ * where the last call left off.  Returns the number stored, which is
+ * only 0 once every bit has been returned.  Whole words are decoded
+ * at once while there are at least 64 free slots, and the batch ends
+ * early once there aren't, so use a max of at least 64 (preferably a
+ * few hundred). */
+PSNIP_BITSET__FUNCTION
+size_t
+psnip_bitset_iter_next (struct PsnipBitsetIter* iter, psnip_uint32_t* out, size_t max) {
+  psnip_uint64_t w = iter->current;
+  size_t word = iter->word;
+  size_t n = 0;
+  psnip_uint32_t base;
+#if defined(PSNIP_BITSET__AVX512)
+#  if defined(__AVX512F__)
+  const int simd = 1;
+#  elif defined(PSNIP_CPU__H)
+  const int simd = psnip_bitset__avx512_usable ();
+#  else
+  const int simd = 0;
+#  endif
+#endif
+
+  while (n < max) {
+    if (w == 0) {
+      if (word + 1 >= iter->n_words)
+        break;
+      w = iter->words[++word];
+      continue;
+    }
+
+    base = (psnip_uint32_t) (word * 64);
+    if ((max - n) >= 64) {
+#if defined(PSNIP_BITSET__AVX512)
+      /* Always, even for sparse words: choosing based on the popcount
+       * costs more in mispredicted branches than it saves. */
+      if (simd)
+        n += psnip_bitset__decode_word_avx512 (w, base, out + n);
+      else
+#endif
+        n += psnip_bitset__decode_word_portable (w, base, out + n);
+      w = 0;
+    } else if (max >= 64) {
+      /* Leave the word for the next call rather than decoding it a
+       * bit at a time. */
+      break;
+    } else {
+      out[n++] = base + (psnip_uint32_t) psnip_builtin_ctz64 (w);
+      w &= w - 1;
+    }
+  }
+
+  iter->word = word;
+  iter->current = w;
+
+  return n;
+}
+
+#endif /* !defined(PSNIP_BITSET_H) */
@@ -50,6 +50,7 @@
 #endif
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if defined(__i386) || defined(_M_IX86) || \
   defined(__amd64) || defined(_M_AMD64) || defined(__x86_64)
@@ -801,6 +802,240 @@ PSNIP_BUILTIN__POPCOUNT_DEFINE_PORTABLE(popcountll, unsigned long long)
 #  define psnip_builtin_popcount64(x) PSNIP_BUILTIN__VARIANT_INT64(psnip,popcount)(x)
 #endif
 
+/*** popcount_array ***/
+
+/* Number of set bits in size bytes starting at data, which doesn't
+ * need to be aligned.  This uses Harley-Seal with AVX2, VPOPCNTDQ
+ * with AVX-512, or vcnt with NEON when they are available at compile
+ * time.  If cpu.h was included before builtin.h (in which case you
+ * need to link in cpu.c) the x86 versions are also chosen at run
+ * time, even if the compiler isn't targeting them. */
+
+#if defined(PSNIP_BUILTIN__ENABLE_X86)
+#  if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+#    define PSNIP_BUILTIN__POPCOUNT_AVX512
+#    define PSNIP_BUILTIN__TARGET_AVX512
+#  elif \
+  (defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) && (__GNUC__ >= 8)) || \
+  (defined(__clang__) && (__clang_major__ >= 6))
+#    define PSNIP_BUILTIN__POPCOUNT_AVX512
+#    define PSNIP_BUILTIN__TARGET_AVX512 __attribute__((__target__("avx512f,avx512vpopcntdq")))
+#  elif defined(_MSC_VER) && (_MSC_VER >= 1920) && !defined(__clang__)
+#    define PSNIP_BUILTIN__POPCOUNT_AVX512
+#    define PSNIP_BUILTIN__TARGET_AVX512
+#  endif
+
+#  if defined(__AVX2__)
+#    define PSNIP_BUILTIN__POPCOUNT_AVX2
+#    define PSNIP_BUILTIN__TARGET_AVX2
+#  elif \
+  (defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || \
+  (defined(__clang__) && ((__clang_major__ > 3) || (__clang_major__ == 3 && __clang_minor__ >= 8)))
+#    define PSNIP_BUILTIN__POPCOUNT_AVX2
+#    define PSNIP_BUILTIN__TARGET_AVX2 __attribute__((__target__("avx2")))
+#  elif defined(_MSC_VER) && (_MSC_VER >= 1700) && !defined(__clang__)
+#    define PSNIP_BUILTIN__POPCOUNT_AVX2
+#    define PSNIP_BUILTIN__TARGET_AVX2
+#  endif
+
+#  if defined(PSNIP_BUILTIN__POPCOUNT_AVX512) || defined(PSNIP_BUILTIN__POPCOUNT_AVX2)
+#    include <immintrin.h>
+#  endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define PSNIP_BUILTIN__POPCOUNT_NEON
+#endif
+
+/* Four words at a time so the additions can overlap. */
+PSNIP_BUILTIN__FUNCTION
+psnip_uint64_t
+psnip_builtin__popcount_array_portable(const unsigned char* data, size_t size) {
+  psnip_uint64_t total = 0;
+  psnip_uint64_t w[4];
+  size_t i = 0;
+
+  for ( ; i + sizeof(w) <= size ; i += sizeof(w)) {
+    memcpy(w, data + i, sizeof(w));
+    total +=
+      (psnip_uint64_t) (psnip_builtin_popcount64(w[0]) + psnip_builtin_popcount64(w[1]) +
+                        psnip_builtin_popcount64(w[2]) + psnip_builtin_popcount64(w[3]));
+  }
+
+  for ( ; i + sizeof(w[0]) <= size ; i += sizeof(w[0])) {
+    memcpy(w, data + i, sizeof(w[0]));
+    total += (psnip_uint64_t) psnip_builtin_popcount64(w[0]);
+  }
+
+  for ( ; i < size ; i++)
+    total += (psnip_uint64_t) psnip_builtin_popcount32(data[i]);
+
+  return total;
+}
+
+#if defined(PSNIP_BUILTIN__POPCOUNT_AVX512)
+PSNIP_BUILTIN__FUNCTION PSNIP_BUILTIN__TARGET_AVX512
+psnip_uint64_t
+psnip_builtin__popcount_array_avx512(const unsigned char* data, size_t size) {
+  __m512i total = _mm512_setzero_si512();
+  psnip_uint64_t lanes[8];
+  size_t i = 0;
+
+  for ( ; i + 64 <= size ; i += 64)
+    total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_loadu_si512((const void*) (data + i))));
+
+  /* Not _mm512_reduce_add_epi64; some versions of GCC warn about
+   * uninitialized variables inside it. */
+  _mm512_storeu_si512((void*) lanes, total);
+  return
+    lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7] +
+    psnip_builtin__popcount_array_portable(data + i, size - i);
+}
+#endif
+
+#if defined(PSNIP_BUILTIN__POPCOUNT_AVX2)
+/* Per-nibble lookup with vpshufb, summed into four 64-bit lanes. */
+PSNIP_BUILTIN__FUNCTION PSNIP_BUILTIN__TARGET_AVX2
+__m256i
+psnip_builtin__popcount_avx2_m256i(__m256i v) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  const __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_mask));
+  const __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask));
+
+  return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+/* Carry-save adder: h:l = a + b + c, bit by bit. */
+#define PSNIP_BUILTIN__CSA256(h, l, a, b, c) do {				\
+    const __m256i psnip_builtin__csa_u = _mm256_xor_si256(a, b);		\
+    h = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(psnip_builtin__csa_u, c)); \
+    l = _mm256_xor_si256(psnip_builtin__csa_u, c);				\
+  } while (0)
+
+#define PSNIP_BUILTIN__LOADU256(ptr, n) _mm256_loadu_si256(((const __m256i*) (ptr)) + (n))
+
+/* Harley-Seal: a tree of carry-save adders reduces each 16 vectors to
+ * one vector of "sixteens" which needs counting, plus the leftover
+ * ones, twos, fours and eights which are counted at the end.  See
+ * Muła, Kurz & Lemire, "Faster Population Counts Using AVX2
+ * Instructions" (https://arxiv.org/abs/1611.07612). */
+PSNIP_BUILTIN__FUNCTION PSNIP_BUILTIN__TARGET_AVX2
+psnip_uint64_t
+psnip_builtin__popcount_array_avx2(const unsigned char* data, size_t size) {
+  __m256i total = _mm256_setzero_si256();
+  __m256i ones = _mm256_setzero_si256(), twos = _mm256_setzero_si256();
+  __m256i fours = _mm256_setzero_si256(), eights = _mm256_setzero_si256();
+  __m256i sixteens, twos_a, twos_b, fours_a, fours_b, eights_a, eights_b;
+  psnip_uint64_t lanes[4];
+  size_t i = 0;
+
+  for ( ; i + (16 * 32) <= size ; i += 16 * 32) {
+    PSNIP_BUILTIN__CSA256(twos_a, ones, ones, PSNIP_BUILTIN__LOADU256(data + i, 0), PSNIP_BUILTIN__LOADU256(data + i, 1));
+    PSNIP_BUILTIN__CSA256(twos_b, ones, ones, PSNIP_BUILTIN__LOADU256(data + i, 2), PSNIP_BUILTIN__LOADU256(data + i, 3));
+    PSNIP_BUILTIN__CSA256(fours_a, twos, twos, twos_a, twos_b);
+    PSNIP_BUILTIN__CSA256(twos_a, ones, ones, PSNIP_BUILTIN__LOADU256(data + i, 4), PSNIP_BUILTIN__LOADU256(data + i, 5));
+    PSNIP_BUILTIN__CSA256(twos_b, ones, ones, PSNIP_BUILTIN__LOADU256(data + i, 6), PSNIP_BUILTIN__LOADU256(data + i, 7));
+    PSNIP_BUILTIN__CSA256(fours_b, twos, twos, twos_a, twos_b);
+    PSNIP_BUILTIN__CSA256(eights_a, fours, fours, fours_a, fours_b);
+    PSNIP_BUILTIN__CSA256(twos_a, ones, ones, PSNIP_BUILTIN__LOADU256(data + i, 8), PSNIP_BUILTIN__LOADU256(data + i, 9));
+    PSNIP_BUILTIN__CSA256(twos_b, ones, ones, PSNIP_BUILTIN__LOADU256(data + i, 10), PSNIP_BUILTIN__LOADU256(data + i, 11));
+    PSNIP_BUILTIN__CSA256(fours_a, twos, twos, twos_a, twos_b);
+    PSNIP_BUILTIN__CSA256(twos_a, ones, ones, PSNIP_BUILTIN__LOADU256(data + i, 12), PSNIP_BUILTIN__LOADU256(data + i, 13));
+    PSNIP_BUILTIN__CSA256(twos_b, ones, ones, PSNIP_BUILTIN__LOADU256(data + i, 14), PSNIP_BUILTIN__LOADU256(data + i, 15));
+    PSNIP_BUILTIN__CSA256(fours_b, twos, twos, twos_a, twos_b);
+    PSNIP_BUILTIN__CSA256(eights_b, fours, fours, fours_a, fours_b);
+    PSNIP_BUILTIN__CSA256(sixteens, eights, eights, eights_a, eights_b);
+    total = _mm256_add_epi64(total, psnip_builtin__popcount_avx2_m256i(sixteens));
+  }
+
+  total = _mm256_slli_epi64(total, 4);
+  total = _mm256_add_epi64(total, _mm256_slli_epi64(psnip_builtin__popcount_avx2_m256i(eights), 3));
+  total = _mm256_add_epi64(total, _mm256_slli_epi64(psnip_builtin__popcount_avx2_m256i(fours), 2));
+  total = _mm256_add_epi64(total, _mm256_slli_epi64(psnip_builtin__popcount_avx2_m256i(twos), 1));
+  total = _mm256_add_epi64(total, psnip_builtin__popcount_avx2_m256i(ones));
+
+  for ( ; i + 32 <= size ; i += 32)
+    total = _mm256_add_epi64(total, psnip_builtin__popcount_avx2_m256i(PSNIP_BUILTIN__LOADU256(data + i, 0)));
+
+  _mm256_storeu_si256((__m256i*) lanes, total);
+  return
+    lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+    psnip_builtin__popcount_array_portable(data + i, size - i);
+}
+#endif
+
+#if defined(PSNIP_BUILTIN__POPCOUNT_NEON)
+PSNIP_BUILTIN__FUNCTION
+psnip_uint64_t
+psnip_builtin__popcount_array_neon(const unsigned char* data, size_t size) {
+  uint64x2_t total = vdupq_n_u64(0);
+  uint8x16_t c;
+  size_t i = 0;
+
+  /* Each byte of c is at most 4 * 8, so it can't overflow before
+   * being widened. */
+  for ( ; i + 64 <= size ; i += 64) {
+    c = vcntq_u8(vld1q_u8(data + i));
+    c = vaddq_u8(c, vcntq_u8(vld1q_u8(data + i + 16)));
+    c = vaddq_u8(c, vcntq_u8(vld1q_u8(data + i + 32)));
+    c = vaddq_u8(c, vcntq_u8(vld1q_u8(data + i + 48)));
+    total = vpadalq_u32(total, vpaddlq_u16(vpaddlq_u8(c)));
+  }
+
+  return
+    vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1) +
+    psnip_builtin__popcount_array_portable(data + i, size - i);
+}
+#endif
+
+typedef psnip_uint64_t (* psnip_builtin__popcount_array_func)(const unsigned char* data, size_t size);
+
+/* The version psnip_builtin_popcount_array will use.  The run-time
+ * checks go through psnip_cpu_feature_usable, which also makes sure
+ * the OS saves the AVX or AVX-512 registers. */
+PSNIP_BUILTIN__FUNCTION
+psnip_builtin__popcount_array_func
+psnip_builtin__popcount_array_select(void) {
+#if defined(PSNIP_BUILTIN__POPCOUNT_AVX512)
+#  if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+  return psnip_builtin__popcount_array_avx512;
+#  elif defined(PSNIP_CPU__H)
+  if (psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX512F) &&
+      psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX512VPOPCNTDQ))
+    return psnip_builtin__popcount_array_avx512;
+#  endif
+#endif
+
+#if defined(PSNIP_BUILTIN__POPCOUNT_AVX2)
+#  if defined(__AVX2__)
+  return psnip_builtin__popcount_array_avx2;
+#  elif defined(PSNIP_CPU__H)
+  if (psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX2))
+    return psnip_builtin__popcount_array_avx2;
+#  endif
+#endif
+
+#if defined(PSNIP_BUILTIN__POPCOUNT_NEON)
+  return psnip_builtin__popcount_array_neon;
+#else
+  return psnip_builtin__popcount_array_portable;
+#endif
+}
+
+PSNIP_BUILTIN__FUNCTION
+psnip_uint64_t
+psnip_builtin_popcount_array(const void* data, size_t size) {
+  /* Chosen on the first call.  Threads which race to set it all store
+   * the same pointer. */
+  static psnip_builtin__popcount_array_func func = NULL;
+
+  if (func == NULL)
+    func = psnip_builtin__popcount_array_select();
+
+  return func((const unsigned char*) data, size);
+}
+
 /*** __builtin_clrsb ***/
 
 #define PSNIP_BUILTIN__CLRSB_DEFINE_PORTABLE(f_n, clzfn, T) \
@@ -1477,6 +1712,126 @@ psnip_uint64_t psnip_intrin_shiftright128(psnip_uint64_t LowPart, psnip_uint64_t
 #  endif
 #endif
 
+/*** umul128 ***/
+
+#if PSNIP_BUILTIN_MSVC_HAS_INTRIN(_umul128, 14, 0) && defined(_M_AMD64)
+#  pragma intrinsic(_umul128)
+#  define psnip_intrin_umul128(Multiplier, Multiplicand, HighProduct) _umul128(Multiplier, Multiplicand, HighProduct)
+#else
+#  if defined(__SIZEOF_INT128__)
+PSNIP_BUILTIN__FUNCTION
+psnip_uint64_t psnip_intrin_umul128(psnip_uint64_t Multiplier, psnip_uint64_t Multiplicand, psnip_uint64_t* HighProduct) {
+  const unsigned __int128 r = ((unsigned __int128) Multiplier) * Multiplicand;
+  *HighProduct = (psnip_uint64_t) (r >> 64);
+  return (psnip_uint64_t) r;
+}
+#  else
+/* Schoolbook multiplication on 32-bit halves.  The middle sum can't
+ * overflow: each term is at most (2^32 - 1)^2, and adding two values
+ * < 2^32 to that still fits in 64 bits, so only one carry is needed. */
+PSNIP_BUILTIN__FUNCTION
+psnip_uint64_t psnip_intrin_umul128(psnip_uint64_t Multiplier, psnip_uint64_t Multiplicand, psnip_uint64_t* HighProduct) {
+  const psnip_uint64_t mask = (psnip_uint64_t) 0xffffffffUL;
+  const psnip_uint64_t al = Multiplier & mask, ah = Multiplier >> 32;
+  const psnip_uint64_t bl = Multiplicand & mask, bh = Multiplicand >> 32;
+  const psnip_uint64_t ll = al * bl;
+  const psnip_uint64_t hl = ah * bl;
+  const psnip_uint64_t lh = al * bh;
+  const psnip_uint64_t mid = (ll >> 32) + (hl & mask) + lh;
+
+  *HighProduct = (ah * bh) + (hl >> 32) + (mid >> 32);
+  return (mid << 32) | (ll & mask);
+}
+#  endif
+#  if defined(PSNIP_BUILTIN_EMULATE_NATIVE)
+#    define _umul128(Multiplier, Multiplicand, HighProduct) psnip_intrin_umul128(Multiplier, Multiplicand, HighProduct)
+#  endif
+#endif
+
+/*** mul128 ***/
+
+#if PSNIP_BUILTIN_MSVC_HAS_INTRIN(_mul128, 14, 0) && defined(_M_AMD64)
+#  pragma intrinsic(_mul128)
+#  define psnip_intrin_mul128(Multiplier, Multiplicand, HighProduct) _mul128(Multiplier, Multiplicand, HighProduct)
+#else
+#  if defined(__SIZEOF_INT128__)
+PSNIP_BUILTIN__FUNCTION
+psnip_int64_t psnip_intrin_mul128(psnip_int64_t Multiplier, psnip_int64_t Multiplicand, psnip_int64_t* HighProduct) {
+  const __int128 r = ((__int128) Multiplier) * Multiplicand;
+  *HighProduct = (psnip_int64_t) (r >> 64);
+  return (psnip_int64_t) r;
+}
+#  else
+/* The unsigned product of the two's complement representations is
+ * off by 2^64 * b for a negative a (and vice versa), which only
+ * affects the high half. */
+PSNIP_BUILTIN__FUNCTION
+psnip_int64_t psnip_intrin_mul128(psnip_int64_t Multiplier, psnip_int64_t Multiplicand, psnip_int64_t* HighProduct) {
+  psnip_uint64_t high;
+  const psnip_uint64_t low = psnip_intrin_umul128((psnip_uint64_t) Multiplier, (psnip_uint64_t) Multiplicand, &high);
+
+  if (Multiplier < 0)
+    high -= (psnip_uint64_t) Multiplicand;
+  if (Multiplicand < 0)
+    high -= (psnip_uint64_t) Multiplier;
+
+  *HighProduct = (psnip_int64_t) high;
+  return (psnip_int64_t) low;
+}
+#  endif
+#  if defined(PSNIP_BUILTIN_EMULATE_NATIVE)
+#    define _mul128(Multiplier, Multiplicand, HighProduct) psnip_intrin_mul128(Multiplier, Multiplicand, HighProduct)
+#  endif
+#endif
+
+/*** umulh ***/
+
+#if PSNIP_BUILTIN_MSVC_HAS_INTRIN(__umulh, 14, 0) && (defined(_M_AMD64) || defined(_M_ARM64))
+#  pragma intrinsic(__umulh)
+#  define psnip_intrin_umulh(a, b) __umulh(a, b)
+#else
+#  if defined(__SIZEOF_INT128__)
+PSNIP_BUILTIN__FUNCTION
+psnip_uint64_t psnip_intrin_umulh(psnip_uint64_t a, psnip_uint64_t b) {
+  return (psnip_uint64_t) ((((unsigned __int128) a) * b) >> 64);
+}
+#  else
+PSNIP_BUILTIN__FUNCTION
+psnip_uint64_t psnip_intrin_umulh(psnip_uint64_t a, psnip_uint64_t b) {
+  psnip_uint64_t high;
+  (void) psnip_intrin_umul128(a, b, &high);
+  return high;
+}
+#  endif
+#  if defined(PSNIP_BUILTIN_EMULATE_NATIVE)
+#    define __umulh(a, b) psnip_intrin_umulh(a, b)
+#  endif
+#endif
+
+/*** mulh ***/
+
+#if PSNIP_BUILTIN_MSVC_HAS_INTRIN(__mulh, 14, 0) && (defined(_M_AMD64) || defined(_M_ARM64))
+#  pragma intrinsic(__mulh)
+#  define psnip_intrin_mulh(a, b) __mulh(a, b)
+#else
+#  if defined(__SIZEOF_INT128__)
+PSNIP_BUILTIN__FUNCTION
+psnip_int64_t psnip_intrin_mulh(psnip_int64_t a, psnip_int64_t b) {
+  return (psnip_int64_t) ((((__int128) a) * b) >> 64);
+}
+#  else
+PSNIP_BUILTIN__FUNCTION
+psnip_int64_t psnip_intrin_mulh(psnip_int64_t a, psnip_int64_t b) {
+  psnip_int64_t high;
+  (void) psnip_intrin_mul128(a, b, &high);
+  return high;
+}
+#  endif
+#  if defined(PSNIP_BUILTIN_EMULATE_NATIVE)
+#    define __mulh(a, b) psnip_intrin_mulh(a, b)
+#  endif
+#endif
+
 /*** byteswap ***/
 
 #if PSNIP_BUILTIN_MSVC_HAS_INTRIN(_byteswap_ushort,13,10)
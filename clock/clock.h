@@ -53,7 +53,11 @@ enum PsnipClockType {
   /* Monotonic time is always running (unlike CPU time), but it only
      ever moves forward unless you reboot the system.  Things like NTP
      adjustments have no effect on this clock. */
-  PSNIP_CLOCK_TYPE_MONOTONIC = 3
+  PSNIP_CLOCK_TYPE_MONOTONIC = 3,
+  /* Like the monotonic clock, but it keeps counting while the system
+   * is suspended, so a timeout measured with it still expires at the
+   * right time after a laptop (or VM) is resumed. */
+  PSNIP_CLOCK_TYPE_BOOTTIME = 4
 };
 
 struct PsnipClockTimespec {
@@ -73,8 +77,14 @@ struct PsnipClockTimespec {
 #define PSNIP_CLOCK_METHOD_GETRUSAGE                       8
 #define PSNIP_CLOCK_METHOD_GETSYSTEMTIMEPRECISEASFILETIME  9
 #define PSNIP_CLOCK_METHOD_GETTICKCOUNT64                 10
+#define PSNIP_CLOCK_METHOD_MACH_CONTINUOUS_TIME           11
 
 #include <assert.h>
+#include <stddef.h>
+
+#if !defined(PSNIP_CPU_PAUSE_H)
+#  include "../cpu/pause.h"
+#endif
 
 #if defined(HEDLEY_UNREACHABLE)
 #  define PSNIP_CLOCK_UNREACHABLE() HEDLEY_UNREACHABLE()
@@ -87,6 +97,7 @@ struct PsnipClockTimespec {
 /* #undef PSNIP_CLOCK_WALL_METHOD */
 /* #undef PSNIP_CLOCK_CPU_METHOD */
 /* #undef PSNIP_CLOCK_MONOTONIC_METHOD */
+/* #undef PSNIP_CLOCK_BOOTTIME_METHOD */
 
 /* We want to be able to detect the libc implementation, so we include
    <limits.h> (<features.h> isn't available everywhere). */
@@ -119,12 +130,23 @@ struct PsnipClockTimespec {
 #  if !defined(PSNIP_CLOCK_MONOTONIC_METHOD)
 #    define PSNIP_CLOCK_MONOTONIC_METHOD PSNIP_CLOCK_METHOD_QUERYPERFORMANCECOUNTER
 #  endif
+/* QueryPerformanceCounter may or may not count while suspended
+   depending on the hardware, but GetTickCount64 always does. */
+#  if !defined(PSNIP_CLOCK_BOOTTIME_METHOD)
+#    define PSNIP_CLOCK_BOOTTIME_METHOD PSNIP_CLOCK_METHOD_GETTICKCOUNT64
+#  endif
 #endif
 
 #if defined(__MACH__) && !defined(__gnu_hurd__)
 #  if !defined(PSNIP_CLOCK_MONOTONIC_METHOD)
 #    define PSNIP_CLOCK_MONOTONIC_METHOD PSNIP_CLOCK_METHOD_MACH_ABSOLUTE_TIME
 #  endif
+/* mach_continuous_time is new in macOS 10.12 / iOS 10. */
+#  if !defined(PSNIP_CLOCK_BOOTTIME_METHOD) && \
+  ((defined(__ENVIRONMENT_MAC_OS_X_VERSION_MIN_REQUIRED__) && (__ENVIRONMENT_MAC_OS_X_VERSION_MIN_REQUIRED__ >= 101200)) || \
+   (defined(__ENVIRONMENT_IPHONE_OS_VERSION_MIN_REQUIRED__) && (__ENVIRONMENT_IPHONE_OS_VERSION_MIN_REQUIRED__ >= 100000)))
+#    define PSNIP_CLOCK_BOOTTIME_METHOD PSNIP_CLOCK_METHOD_MACH_CONTINUOUS_TIME
+#  endif
 #endif
 
 #if defined(PSNIP_CLOCK_HAVE_CLOCK_GETTIME)
@@ -153,6 +175,12 @@ struct PsnipClockTimespec {
 #      define PSNIP_CLOCK_CLOCK_GETTIME_MONOTONIC CLOCK_MONOTONIC
 #    endif
 #  endif
+#  if !defined(PSNIP_CLOCK_BOOTTIME_METHOD)
+#    if defined(CLOCK_BOOTTIME)
+#      define PSNIP_CLOCK_BOOTTIME_METHOD PSNIP_CLOCK_METHOD_CLOCK_GETTIME
+#      define PSNIP_CLOCK_CLOCK_GETTIME_BOOTTIME CLOCK_BOOTTIME
+#    endif
+#  endif
 #endif
 
 #if defined(_POSIX_VERSION) && (_POSIX_VERSION >= 200112L)
@@ -180,19 +208,23 @@ struct PsnipClockTimespec {
   (defined(PSNIP_CLOCK_CPU_METHOD)       && (PSNIP_CLOCK_CPU_METHOD       == PSNIP_CLOCK_METHOD_CLOCK_GETTIME)) || \
   (defined(PSNIP_CLOCK_WALL_METHOD)      && (PSNIP_CLOCK_WALL_METHOD      == PSNIP_CLOCK_METHOD_CLOCK_GETTIME)) || \
   (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_CLOCK_GETTIME)) || \
+  (defined(PSNIP_CLOCK_BOOTTIME_METHOD)  && (PSNIP_CLOCK_BOOTTIME_METHOD  == PSNIP_CLOCK_METHOD_CLOCK_GETTIME)) || \
   (defined(PSNIP_CLOCK_CPU_METHOD)       && (PSNIP_CLOCK_CPU_METHOD       == PSNIP_CLOCK_METHOD_CLOCK)) || \
   (defined(PSNIP_CLOCK_WALL_METHOD)      && (PSNIP_CLOCK_WALL_METHOD      == PSNIP_CLOCK_METHOD_CLOCK)) || \
   (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_CLOCK)) || \
+  (defined(PSNIP_CLOCK_BOOTTIME_METHOD)  && (PSNIP_CLOCK_BOOTTIME_METHOD  == PSNIP_CLOCK_METHOD_CLOCK)) || \
   (defined(PSNIP_CLOCK_CPU_METHOD)       && (PSNIP_CLOCK_CPU_METHOD       == PSNIP_CLOCK_METHOD_TIME)) || \
   (defined(PSNIP_CLOCK_WALL_METHOD)      && (PSNIP_CLOCK_WALL_METHOD      == PSNIP_CLOCK_METHOD_TIME)) || \
-  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_TIME))
+  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_TIME)) || \
+  (defined(PSNIP_CLOCK_BOOTTIME_METHOD)  && (PSNIP_CLOCK_BOOTTIME_METHOD  == PSNIP_CLOCK_METHOD_TIME))
 #  include <time.h>
 #endif
 
 #if \
   (defined(PSNIP_CLOCK_CPU_METHOD)       && (PSNIP_CLOCK_CPU_METHOD       == PSNIP_CLOCK_METHOD_GETTIMEOFDAY)) || \
   (defined(PSNIP_CLOCK_WALL_METHOD)      && (PSNIP_CLOCK_WALL_METHOD      == PSNIP_CLOCK_METHOD_GETTIMEOFDAY)) || \
-  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_GETTIMEOFDAY))
+  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_GETTIMEOFDAY)) || \
+  (defined(PSNIP_CLOCK_BOOTTIME_METHOD)  && (PSNIP_CLOCK_BOOTTIME_METHOD  == PSNIP_CLOCK_METHOD_GETTIMEOFDAY))
 #  include <sys/time.h>
 #endif
 
@@ -200,16 +232,19 @@ struct PsnipClockTimespec {
   (defined(PSNIP_CLOCK_CPU_METHOD)       && (PSNIP_CLOCK_CPU_METHOD       == PSNIP_CLOCK_METHOD_GETPROCESSTIMES)) || \
   (defined(PSNIP_CLOCK_WALL_METHOD)      && (PSNIP_CLOCK_WALL_METHOD      == PSNIP_CLOCK_METHOD_GETPROCESSTIMES)) || \
   (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_GETPROCESSTIMES)) || \
+  (defined(PSNIP_CLOCK_BOOTTIME_METHOD)  && (PSNIP_CLOCK_BOOTTIME_METHOD  == PSNIP_CLOCK_METHOD_GETPROCESSTIMES)) || \
   (defined(PSNIP_CLOCK_CPU_METHOD)       && (PSNIP_CLOCK_CPU_METHOD       == PSNIP_CLOCK_METHOD_GETTICKCOUNT64)) || \
   (defined(PSNIP_CLOCK_WALL_METHOD)      && (PSNIP_CLOCK_WALL_METHOD      == PSNIP_CLOCK_METHOD_GETTICKCOUNT64)) || \
-  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_GETTICKCOUNT64))
+  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_GETTICKCOUNT64)) || \
+  (defined(PSNIP_CLOCK_BOOTTIME_METHOD)  && (PSNIP_CLOCK_BOOTTIME_METHOD  == PSNIP_CLOCK_METHOD_GETTICKCOUNT64))
 #  include <windows.h>
 #endif
 
 #if \
   (defined(PSNIP_CLOCK_CPU_METHOD)       && (PSNIP_CLOCK_CPU_METHOD       == PSNIP_CLOCK_METHOD_GETRUSAGE)) || \
   (defined(PSNIP_CLOCK_WALL_METHOD)      && (PSNIP_CLOCK_WALL_METHOD      == PSNIP_CLOCK_METHOD_GETRUSAGE)) || \
-  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_GETRUSAGE))
+  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_GETRUSAGE)) || \
+  (defined(PSNIP_CLOCK_BOOTTIME_METHOD)  && (PSNIP_CLOCK_BOOTTIME_METHOD  == PSNIP_CLOCK_METHOD_GETRUSAGE))
 #  include <sys/time.h>
 #  include <sys/resource.h>
 #endif
@@ -217,7 +252,9 @@ struct PsnipClockTimespec {
 #if \
   (defined(PSNIP_CLOCK_CPU_METHOD)       && (PSNIP_CLOCK_CPU_METHOD       == PSNIP_CLOCK_METHOD_MACH_ABSOLUTE_TIME)) || \
   (defined(PSNIP_CLOCK_WALL_METHOD)      && (PSNIP_CLOCK_WALL_METHOD      == PSNIP_CLOCK_METHOD_MACH_ABSOLUTE_TIME)) || \
-  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_MACH_ABSOLUTE_TIME))
+  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_MACH_ABSOLUTE_TIME)) || \
+  (defined(PSNIP_CLOCK_BOOTTIME_METHOD)  && (PSNIP_CLOCK_BOOTTIME_METHOD  == PSNIP_CLOCK_METHOD_MACH_ABSOLUTE_TIME)) || \
+  (defined(PSNIP_CLOCK_BOOTTIME_METHOD)  && (PSNIP_CLOCK_BOOTTIME_METHOD  == PSNIP_CLOCK_METHOD_MACH_CONTINUOUS_TIME))
 #  include <CoreServices/CoreServices.h>
 #  include <mach/mach.h>
 #  include <mach/mach_time.h>
@@ -230,7 +267,8 @@ struct PsnipClockTimespec {
 #if \
   (defined(PSNIP_CLOCK_CPU_METHOD)       && (PSNIP_CLOCK_CPU_METHOD       == PSNIP_CLOCK_METHOD_CLOCK_GETTIME)) || \
   (defined(PSNIP_CLOCK_WALL_METHOD)      && (PSNIP_CLOCK_WALL_METHOD      == PSNIP_CLOCK_METHOD_CLOCK_GETTIME)) || \
-  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_CLOCK_GETTIME))
+  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_CLOCK_GETTIME)) || \
+  (defined(PSNIP_CLOCK_BOOTTIME_METHOD)  && (PSNIP_CLOCK_BOOTTIME_METHOD  == PSNIP_CLOCK_METHOD_CLOCK_GETTIME))
 PSNIP_CLOCK__FUNCTION psnip_uint32_t
 psnip_clock__clock_getres (clockid_t clk_id) {
   struct timespec res;
@@ -257,6 +295,21 @@ psnip_clock__clock_gettime (clockid_t clk_id, struct PsnipClockTimespec* res) {
 }
 #endif
 
+#if \
+  (defined(PSNIP_CLOCK_MONOTONIC_METHOD) && (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_MACH_ABSOLUTE_TIME)) || \
+  (defined(PSNIP_CLOCK_BOOTTIME_METHOD)  && (PSNIP_CLOCK_BOOTTIME_METHOD  == PSNIP_CLOCK_METHOD_MACH_CONTINUOUS_TIME))
+/* Convert mach ticks to nanoseconds.  numer / denom isn't an integer
+ * everywhere (it's 125 / 3 on Apple Silicon), and ticks * numer can
+ * overflow, so split ticks into a multiple of denom and a remainder. */
+PSNIP_CLOCK__FUNCTION psnip_uint64_t
+psnip_clock__mach_to_nsec (psnip_uint64_t ticks, const mach_timebase_info_data_t* tbi) {
+  const psnip_uint64_t numer = (psnip_uint64_t) tbi->numer;
+  const psnip_uint64_t denom = (psnip_uint64_t) tbi->denom;
+
+  return ((ticks / denom) * numer) + (((ticks % denom) * numer) / denom);
+}
+#endif
+
 PSNIP_CLOCK__FUNCTION psnip_uint32_t
 psnip_clock_wall_get_precision (void) {
 #if !defined(PSNIP_CLOCK_WALL_METHOD)
@@ -308,6 +361,8 @@ psnip_clock_cpu_get_precision (void) {
   return CLOCKS_PER_SEC;
 #elif defined(PSNIP_CLOCK_CPU_METHOD) && PSNIP_CLOCK_CPU_METHOD == PSNIP_CLOCK_METHOD_GETPROCESSTIMES
   return PSNIP_CLOCK_NSEC_PER_SEC / 100;
+#elif defined(PSNIP_CLOCK_CPU_METHOD) && PSNIP_CLOCK_CPU_METHOD == PSNIP_CLOCK_METHOD_GETRUSAGE
+  return 1000000;
 #else
   return 0;
 #endif
@@ -347,7 +402,7 @@ psnip_clock_cpu_get_time (struct PsnipClockTimespec* res) {
     return -8;
 
   res->seconds = usage.ru_utime.tv_sec;
-  res->nanoseconds = tv.tv_usec * 1000;
+  res->nanoseconds = usage.ru_utime.tv_usec * 1000;
 #else
   (void) res;
   return -2;
@@ -390,7 +445,7 @@ psnip_clock_monotonic_get_time (struct PsnipClockTimespec* res) {
   static mach_timebase_info_data_t tbi = { 0, };
   if (tbi.denom == 0)
     mach_timebase_info(&tbi);
-  nsec *= ((psnip_uint64_t) tbi.numer) / ((psnip_uint64_t) tbi.denom);
+  nsec = psnip_clock__mach_to_nsec(nsec, &tbi);
   res->seconds = nsec / PSNIP_CLOCK_NSEC_PER_SEC;
   res->nanoseconds = nsec % PSNIP_CLOCK_NSEC_PER_SEC;
 #elif defined(PSNIP_CLOCK_MONOTONIC_METHOD) && PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_QUERYPERFORMANCECOUNTER
@@ -408,7 +463,7 @@ psnip_clock_monotonic_get_time (struct PsnipClockTimespec* res) {
 #elif defined(PSNIP_CLOCK_MONOTONIC_METHOD) && PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_GETTICKCOUNT64
   const ULONGLONG msec = GetTickCount64();
   res->seconds = msec / 1000;
-  res->nanoseconds = sec % 1000;
+  res->nanoseconds = (msec % 1000) * 1000000;
 #else
   return -2;
 #endif
@@ -416,6 +471,51 @@ psnip_clock_monotonic_get_time (struct PsnipClockTimespec* res) {
   return 0;
 }
 
+PSNIP_CLOCK__FUNCTION psnip_uint32_t
+psnip_clock_boottime_get_precision (void) {
+#if !defined(PSNIP_CLOCK_BOOTTIME_METHOD)
+  return 0;
+#elif defined(PSNIP_CLOCK_BOOTTIME_METHOD) && PSNIP_CLOCK_BOOTTIME_METHOD == PSNIP_CLOCK_METHOD_CLOCK_GETTIME
+  return psnip_clock__clock_getres(PSNIP_CLOCK_CLOCK_GETTIME_BOOTTIME);
+#elif defined(PSNIP_CLOCK_BOOTTIME_METHOD) && PSNIP_CLOCK_BOOTTIME_METHOD == PSNIP_CLOCK_METHOD_MACH_CONTINUOUS_TIME
+  static mach_timebase_info_data_t tbi = { 0, };
+  if (tbi.denom == 0)
+    mach_timebase_info(&tbi);
+  return (psnip_uint32_t) (tbi.numer / tbi.denom);
+#elif defined(PSNIP_CLOCK_BOOTTIME_METHOD) && PSNIP_CLOCK_BOOTTIME_METHOD == PSNIP_CLOCK_METHOD_GETTICKCOUNT64
+  return 1000;
+#else
+  return 0;
+#endif
+}
+
+PSNIP_CLOCK__FUNCTION int
+psnip_clock_boottime_get_time (struct PsnipClockTimespec* res) {
+#if !defined(PSNIP_CLOCK_BOOTTIME_METHOD)
+  (void) res;
+  return -2;
+#elif defined(PSNIP_CLOCK_BOOTTIME_METHOD) && PSNIP_CLOCK_BOOTTIME_METHOD == PSNIP_CLOCK_METHOD_CLOCK_GETTIME
+  return psnip_clock__clock_gettime(PSNIP_CLOCK_CLOCK_GETTIME_BOOTTIME, res);
+#elif defined(PSNIP_CLOCK_BOOTTIME_METHOD) && PSNIP_CLOCK_BOOTTIME_METHOD == PSNIP_CLOCK_METHOD_MACH_CONTINUOUS_TIME
+  psnip_uint64_t nsec = mach_continuous_time();
+  static mach_timebase_info_data_t tbi = { 0, };
+  if (tbi.denom == 0)
+    mach_timebase_info(&tbi);
+  nsec = psnip_clock__mach_to_nsec(nsec, &tbi);
+  res->seconds = nsec / PSNIP_CLOCK_NSEC_PER_SEC;
+  res->nanoseconds = nsec % PSNIP_CLOCK_NSEC_PER_SEC;
+#elif defined(PSNIP_CLOCK_BOOTTIME_METHOD) && PSNIP_CLOCK_BOOTTIME_METHOD == PSNIP_CLOCK_METHOD_GETTICKCOUNT64
+  const ULONGLONG msec = GetTickCount64();
+  res->seconds = msec / 1000;
+  res->nanoseconds = (msec % 1000) * 1000000;
+#else
+  (void) res;
+  return -2;
+#endif
+
+  return 0;
+}
+
 /* Returns the number of ticks per second for the specified clock.
  * For example, a clock with millisecond precision would return 1000,
  * and a clock with 1 second (such as the time() function) would
@@ -437,6 +537,8 @@ psnip_clock_get_precision (enum PsnipClockType clock_type) {
       return psnip_clock_cpu_get_precision ();
     case PSNIP_CLOCK_TYPE_WALL:
       return psnip_clock_wall_get_precision ();
+    case PSNIP_CLOCK_TYPE_BOOTTIME:
+      return psnip_clock_boottime_get_precision ();
   }
 
   PSNIP_CLOCK_UNREACHABLE();
@@ -456,9 +558,555 @@ psnip_clock_get_time (enum PsnipClockType clock_type, struct PsnipClockTimespec*
       return psnip_clock_cpu_get_time (res);
     case PSNIP_CLOCK_TYPE_WALL:
       return psnip_clock_wall_get_time (res);
+    case PSNIP_CLOCK_TYPE_BOOTTIME:
+      return psnip_clock_boottime_get_time (res);
   }
 
   return -1;
 }
 
+/* Like psnip_clock_get_time, but the result is stored as a single
+ * count of nanoseconds, which is much easier to do arithmetic with.
+ * A 64-bit count of nanoseconds won't overflow until 2554. */
+PSNIP_CLOCK__FUNCTION int
+psnip_clock_get_time_ns (enum PsnipClockType clock_type, psnip_uint64_t* res) {
+  struct PsnipClockTimespec ts;
+  int r;
+
+  assert(res != NULL);
+
+  r = psnip_clock_get_time (clock_type, &ts);
+  if (r != 0)
+    return r;
+
+  *res = (ts.seconds * PSNIP_CLOCK_NSEC_PER_SEC) + ts.nanoseconds;
+
+  return 0;
+}
+
+/*** Sleeping ***/
+
+/* clock_nanosleep is from POSIX.1-2001, so glibc hides it unless
+   _POSIX_C_SOURCE is at least 200112L. */
+#if defined(PSNIP_CLOCK_HAVE_CLOCK_GETTIME) && defined(_POSIX_CLOCK_SELECTION) && (_POSIX_CLOCK_SELECTION > 0) && \
+  defined(_POSIX_C_SOURCE) && (_POSIX_C_SOURCE >= 200112L) && defined(TIMER_ABSTIME)
+#  define PSNIP_CLOCK_HAVE_CLOCK_NANOSLEEP
+#endif
+
+#if defined(_WIN32)
+#  include <windows.h>
+#elif defined(PSNIP_CLOCK_HAVE_CLOCK_GETTIME)
+#  include <errno.h>
+#endif
+
+/* Relative sleep; it's fine to wake up early (the callers will just
+ * go back to sleep), but not to oversleep. */
+PSNIP_CLOCK__FUNCTION int
+psnip_clock__sleep_ns (psnip_uint64_t ns) {
+#if defined(_WIN32)
+  Sleep((DWORD) (ns / 1000000));
+#elif defined(PSNIP_CLOCK_HAVE_CLOCK_GETTIME)
+  struct timespec ts;
+
+  ts.tv_sec = (time_t) (ns / PSNIP_CLOCK_NSEC_PER_SEC);
+  ts.tv_nsec = (long) (ns % PSNIP_CLOCK_NSEC_PER_SEC);
+  if (nanosleep(&ts, NULL) != 0 && errno != EINTR)
+    return -14;
+#else
+  /* No way to sleep; the caller will spin instead. */
+  (void) ns;
+  PSNIP_CPU_PAUSE();
+#endif
+
+  return 0;
+}
+
+/* Sleep until the specified clock reaches an absolute deadline.
+ * Returns 0 once the deadline has passed (immediately if it already
+ * had), or a negative value on failure.
+ *
+ * Where clock_nanosleep is available it's used with TIMER_ABSTIME,
+ * so there is no drift from computing a relative timeout, and a
+ * wall-clock deadline tracks changes to the system time.  Elsewhere
+ * we repeatedly sleep for the remaining time.
+ *
+ * A boot time deadline includes time spent suspended, so it will
+ * still be honored (as soon as the system resumes) if the system is
+ * suspended while we sleep.
+ *
+ * The CPU clock doesn't advance while we sleep, so it's not
+ * supported (-2). */
+PSNIP_CLOCK__FUNCTION int
+psnip_clock_sleep_until (enum PsnipClockType clock_type, const struct PsnipClockTimespec* deadline) {
+  psnip_uint64_t now, target;
+  int r;
+#if defined(PSNIP_CLOCK_HAVE_CLOCK_NANOSLEEP)
+  struct timespec ts;
+  clockid_t clk_id;
+  int have_clk_id = 0;
+#endif
+
+  assert(deadline != NULL);
+
+  if (clock_type == PSNIP_CLOCK_TYPE_CPU)
+    return -2;
+
+#if defined(PSNIP_CLOCK_HAVE_CLOCK_NANOSLEEP)
+#  if defined(PSNIP_CLOCK_WALL_METHOD) && PSNIP_CLOCK_WALL_METHOD == PSNIP_CLOCK_METHOD_CLOCK_GETTIME
+  if (clock_type == PSNIP_CLOCK_TYPE_WALL) {
+    clk_id = PSNIP_CLOCK_CLOCK_GETTIME_WALL;
+    have_clk_id = 1;
+  }
+#  endif
+#  if defined(PSNIP_CLOCK_MONOTONIC_METHOD) && PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_CLOCK_GETTIME
+  if (clock_type == PSNIP_CLOCK_TYPE_MONOTONIC) {
+    clk_id = PSNIP_CLOCK_CLOCK_GETTIME_MONOTONIC;
+    have_clk_id = 1;
+  }
+#  endif
+#  if defined(PSNIP_CLOCK_BOOTTIME_METHOD) && PSNIP_CLOCK_BOOTTIME_METHOD == PSNIP_CLOCK_METHOD_CLOCK_GETTIME
+  if (clock_type == PSNIP_CLOCK_TYPE_BOOTTIME) {
+    clk_id = PSNIP_CLOCK_CLOCK_GETTIME_BOOTTIME;
+    have_clk_id = 1;
+  }
+#  endif
+
+  if (have_clk_id) {
+    ts.tv_sec = (time_t) deadline->seconds;
+    ts.tv_nsec = (long) deadline->nanoseconds;
+
+    do {
+      r = clock_nanosleep(clk_id, TIMER_ABSTIME, &ts, NULL);
+    } while (r == EINTR);
+
+    return (r == 0) ? 0 : -13;
+  }
+#endif
+
+  target = (deadline->seconds * PSNIP_CLOCK_NSEC_PER_SEC) + deadline->nanoseconds;
+
+  for (;;) {
+    r = psnip_clock_get_time_ns (clock_type, &now);
+    if (r != 0)
+      return r;
+
+    if (now >= target)
+      return 0;
+
+    r = psnip_clock__sleep_ns (target - now);
+    if (r != 0)
+      return r;
+  }
+}
+
+/* Like psnip_clock_sleep_until, but only sleep until spin_ns before
+ * the deadline, then busy-wait (with a pause/yield hint) for the
+ * rest.  Sleeping tends to overshoot by anywhere from tens of
+ * microseconds to a timer tick (up to ~15 ms on Windows), so if you
+ * need to wake up precisely you should make spin_ns a bit larger than
+ * the typical overshoot; only that last bit costs CPU time. */
+PSNIP_CLOCK__FUNCTION int
+psnip_clock_sleep_until_spin (enum PsnipClockType clock_type, const struct PsnipClockTimespec* deadline, psnip_uint64_t spin_ns) {
+  struct PsnipClockTimespec early;
+  psnip_uint64_t now, target;
+  int r;
+
+  assert(deadline != NULL);
+
+  if (clock_type == PSNIP_CLOCK_TYPE_CPU)
+    return -2;
+
+  target = (deadline->seconds * PSNIP_CLOCK_NSEC_PER_SEC) + deadline->nanoseconds;
+
+  if (target > spin_ns) {
+    early.seconds = (target - spin_ns) / PSNIP_CLOCK_NSEC_PER_SEC;
+    early.nanoseconds = (target - spin_ns) % PSNIP_CLOCK_NSEC_PER_SEC;
+    r = psnip_clock_sleep_until (clock_type, &early);
+    if (r != 0)
+      return r;
+  }
+
+  for (;;) {
+    r = psnip_clock_get_time_ns (clock_type, &now);
+    if (r != 0)
+      return r;
+
+    if (now >= target)
+      return 0;
+
+    PSNIP_CPU_PAUSE();
+  }
+}
+
+/*** Calibration ***/
+
+/* Returns the PSNIP_CLOCK_METHOD_* used to implement the specified
+ * clock, or 0 if the clock isn't available. */
+PSNIP_CLOCK__FUNCTION int
+psnip_clock_get_method (enum PsnipClockType clock_type) {
+  switch (clock_type) {
+    case PSNIP_CLOCK_TYPE_MONOTONIC:
+#if defined(PSNIP_CLOCK_MONOTONIC_METHOD)
+      return PSNIP_CLOCK_MONOTONIC_METHOD;
+#else
+      return 0;
+#endif
+    case PSNIP_CLOCK_TYPE_CPU:
+#if defined(PSNIP_CLOCK_CPU_METHOD)
+      return PSNIP_CLOCK_CPU_METHOD;
+#else
+      return 0;
+#endif
+    case PSNIP_CLOCK_TYPE_WALL:
+#if defined(PSNIP_CLOCK_WALL_METHOD)
+      return PSNIP_CLOCK_WALL_METHOD;
+#else
+      return 0;
+#endif
+    case PSNIP_CLOCK_TYPE_BOOTTIME:
+#if defined(PSNIP_CLOCK_BOOTTIME_METHOD)
+      return PSNIP_CLOCK_BOOTTIME_METHOD;
+#else
+      return 0;
+#endif
+  }
+
+  return 0;
+}
+
+/* Number of back-to-back reads used to estimate the cost of reading
+ * a clock. */
+#if !defined(PSNIP_CLOCK_CALIBRATE_ITERATIONS)
+#  define PSNIP_CLOCK_CALIBRATE_ITERATIONS 10000
+#endif
+
+/* Number of clock transitions to observe when looking for the
+ * smallest step, and the maximum amount of time (in nanoseconds) to
+ * spend looking for them. */
+#if !defined(PSNIP_CLOCK_CALIBRATE_SAMPLES)
+#  define PSNIP_CLOCK_CALIBRATE_SAMPLES 16
+#endif
+#if !defined(PSNIP_CLOCK_CALIBRATE_BUDGET)
+#  define PSNIP_CLOCK_CALIBRATE_BUDGET 50000000
+#endif
+
+struct PsnipClockCalibration {
+  /* PSNIP_CLOCK_METHOD_* used for the clock. */
+  int method;
+  /* What psnip_clock_get_precision reports, in ticks per second. */
+  psnip_uint32_t precision;
+  /* Average cost of a single psnip_clock_get_time call, in
+   * nanoseconds. */
+  psnip_uint64_t call_ns;
+  /* Smallest non-zero step observed between two consecutive reads, in
+   * nanoseconds, or 0 if the clock didn't change during the
+   * calibration budget. */
+  psnip_uint64_t min_delta_ns;
+};
+
+/* Measure how expensive a clock actually is to read, and how fine its
+ * steps really are.  psnip_clock_get_precision only tells you what
+ * the OS advertises; a clock which claims nanosecond resolution may
+ * in practice only move every few microseconds, and some methods cost
+ * a system call per read while others are a few nanoseconds.
+ *
+ * The call cost is timed with the monotonic clock if there is one
+ * (otherwise with the clock itself).  This spins for up to
+ * PSNIP_CLOCK_CALIBRATE_BUDGET nanoseconds, so it's meant to be
+ * called once, at startup.  Returns 0 on success, or a negative value
+ * if the clock can't be read. */
+PSNIP_CLOCK__FUNCTION int
+psnip_clock_calibrate (enum PsnipClockType clock_type, struct PsnipClockCalibration* res) {
+  enum PsnipClockType timer_type = clock_type;
+  psnip_uint64_t start, end, prev, now, deadline;
+  unsigned int i, samples;
+  int r;
+
+  assert(res != NULL);
+
+#if defined(PSNIP_CLOCK_MONOTONIC_METHOD)
+  timer_type = PSNIP_CLOCK_TYPE_MONOTONIC;
+#endif
+
+  res->method = psnip_clock_get_method (clock_type);
+  res->precision = psnip_clock_get_precision (clock_type);
+  res->call_ns = 0;
+  res->min_delta_ns = 0;
+
+  r = psnip_clock_get_time_ns (clock_type, &prev);
+  if (r != 0)
+    return r;
+
+  /* Per-call cost */
+  r = psnip_clock_get_time_ns (timer_type, &start);
+  if (r != 0)
+    return r;
+  for (i = 0 ; i < PSNIP_CLOCK_CALIBRATE_ITERATIONS ; i++) {
+    r = psnip_clock_get_time_ns (clock_type, &now);
+    if (r != 0)
+      return r;
+  }
+  r = psnip_clock_get_time_ns (timer_type, &end);
+  if (r != 0)
+    return r;
+  res->call_ns = (end > start) ? ((end - start) / PSNIP_CLOCK_CALIBRATE_ITERATIONS) : 0;
+
+  /* Smallest step */
+  r = psnip_clock_get_time_ns (timer_type, &deadline);
+  if (r != 0)
+    return r;
+  deadline += PSNIP_CLOCK_CALIBRATE_BUDGET;
+
+  r = psnip_clock_get_time_ns (clock_type, &prev);
+  if (r != 0)
+    return r;
+
+  for (samples = 0, i = 0 ; samples < PSNIP_CLOCK_CALIBRATE_SAMPLES ; i++) {
+    r = psnip_clock_get_time_ns (clock_type, &now);
+    if (r != 0)
+      return r;
+
+    if (now != prev) {
+      /* Ignore the wall clock going backwards. */
+      if (now > prev && (res->min_delta_ns == 0 || (now - prev) < res->min_delta_ns))
+        res->min_delta_ns = now - prev;
+      samples++;
+      prev = now;
+    }
+
+    if ((i % 256) == 0) {
+      r = psnip_clock_get_time_ns (timer_type, &end);
+      if (r != 0)
+        return r;
+      if (end >= deadline)
+        break;
+    }
+  }
+
+  return 0;
+}
+
+/*** Cached wall clock ***/
+
+/* Reading the wall clock for every event in a hot path (e.g., every
+ * record in a logger) adds up.  A PsnipClockWallCache captures the
+ * wall time once, along with a reading from a cheap tick source (the
+ * TSC on x86, the virtual counter on AArch64), and derives subsequent
+ * wall times from the number of ticks elapsed since then.  The anchor
+ * is refreshed every refresh_ns nanoseconds so the derived times
+ * follow the system clock as NTP slews (or steps) it.
+ *
+ * If there is no usable tick source, or you define
+ * PSNIP_CLOCK_NO_TICKS, ticks are monotonic nanoseconds; that still
+ * works, it just isn't any cheaper than reading the wall clock.
+ *
+ * On x86 this assumes an invariant TSC which is synchronized across
+ * cores, which is true of anything made in the last decade or so,
+ * but you can check with cpu.h if you're worried.
+ *
+ * A cache isn't thread-safe; use one per thread. */
+
+#if !defined(PSNIP_CLOCK_NO_TICKS) && defined(PSNIP_CLOCK_MONOTONIC_METHOD)
+#  if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#    define PSNIP_CLOCK__TICKS_RDTSC
+#  elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#    include <intrin.h>
+#    define PSNIP_CLOCK__TICKS_RDTSC
+#  elif defined(__GNUC__) && defined(__aarch64__)
+#    define PSNIP_CLOCK__TICKS_CNTVCT
+#  endif
+#endif
+
+#if defined(PSNIP_CLOCK_MONOTONIC_METHOD)
+#  define PSNIP_CLOCK__TICKS_CLOCK PSNIP_CLOCK_TYPE_MONOTONIC
+#else
+#  define PSNIP_CLOCK__TICKS_CLOCK PSNIP_CLOCK_TYPE_WALL
+#endif
+
+/* Read the tick source used by PsnipClockWallCache.  The units are
+ * arbitrary; use psnip_clock_wall_cache_convert to turn them into a
+ * wall time.  Returns 0 if even the fallback clock can't be read. */
+PSNIP_CLOCK__FUNCTION psnip_uint64_t
+psnip_clock_ticks (void) {
+#if defined(PSNIP_CLOCK__TICKS_RDTSC) && defined(_MSC_VER)
+  return (psnip_uint64_t) __rdtsc();
+#elif defined(PSNIP_CLOCK__TICKS_RDTSC)
+  psnip_uint32_t lo, hi;
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return (((psnip_uint64_t) hi) << 32) | lo;
+#elif defined(PSNIP_CLOCK__TICKS_CNTVCT)
+  psnip_uint64_t t;
+  __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (t));
+  return t;
+#else
+  psnip_uint64_t t;
+  if (psnip_clock_get_time_ns (PSNIP_CLOCK__TICKS_CLOCK, &t) != 0)
+    return 0;
+  return t;
+#endif
+}
+
+/* How long (in nanoseconds) to measure the TSC against the monotonic
+ * clock before the first timestamp.  The estimate is refined on every
+ * refresh, so this just needs to be good enough to get started. */
+#if !defined(PSNIP_CLOCK_WALL_CACHE_CALIBRATE)
+#  define PSNIP_CLOCK_WALL_CACHE_CALIBRATE 1000000
+#endif
+
+struct PsnipClockWallCache {
+  /* Wall time (ns) and tick count at the last refresh. */
+  psnip_uint64_t wall_base;
+  psnip_uint64_t tick_base;
+  /* Nanoseconds per tick, as 32.32 fixed point. */
+  psnip_uint64_t mult;
+  /* Refresh once this many ticks have elapsed since tick_base. */
+  psnip_uint64_t refresh_ticks;
+  psnip_uint64_t refresh_ns;
+  /* First monotonic/tick pair, used to estimate the tick rate. */
+  psnip_uint64_t mono_origin;
+  psnip_uint64_t tick_origin;
+};
+
+/* ticks * (mult / 2^32), without overflowing for large tick counts. */
+PSNIP_CLOCK__FUNCTION psnip_uint64_t
+psnip_clock__ticks_to_ns (psnip_uint64_t ticks, psnip_uint64_t mult) {
+  return
+    ((ticks >> 32) * mult) +
+    (((ticks & 0xffffffffULL) * mult) >> 32);
+}
+
+/* Re-anchor the cache to the current wall time, and refine the tick
+ * rate.  Called automatically by psnip_clock_wall_cache_now once the
+ * refresh interval has elapsed, but you can call it yourself (say,
+ * before logging a burst of records) to keep the check off the hot
+ * path. */
+PSNIP_CLOCK__FUNCTION int
+psnip_clock_wall_cache_refresh (struct PsnipClockWallCache* cache) {
+  psnip_uint64_t t1, t2, wall;
+  int r;
+#if defined(PSNIP_CLOCK__TICKS_RDTSC)
+  psnip_uint64_t mono;
+#endif
+
+  assert(cache != NULL);
+
+  t1 = psnip_clock_ticks ();
+  r = psnip_clock_get_time_ns (PSNIP_CLOCK_TYPE_WALL, &wall);
+  t2 = psnip_clock_ticks ();
+  if (r != 0)
+    return r;
+
+  cache->wall_base = wall;
+  cache->tick_base = t1 + ((t2 - t1) / 2);
+
+#if defined(PSNIP_CLOCK__TICKS_RDTSC)
+  r = psnip_clock_get_time_ns (PSNIP_CLOCK_TYPE_MONOTONIC, &mono);
+  if (r != 0)
+    return r;
+  if (mono > cache->mono_origin && t2 > cache->tick_origin) {
+    cache->mult = (psnip_uint64_t)
+      (((double) (mono - cache->mono_origin) / (double) (t2 - cache->tick_origin)) * 4294967296.0);
+  }
+#endif
+
+  cache->refresh_ticks = (cache->mult == 0) ? 1 :
+    (psnip_uint64_t) (((double) cache->refresh_ns * 4294967296.0) / (double) cache->mult);
+
+  return 0;
+}
+
+/* Initialize a cache which re-reads the wall clock every refresh_ns
+ * nanoseconds.  With the TSC as the tick source this spends about
+ * PSNIP_CLOCK_WALL_CACHE_CALIBRATE nanoseconds estimating its rate.
+ * Returns 0 on success, or a negative value on failure. */
+PSNIP_CLOCK__FUNCTION int
+psnip_clock_wall_cache_init (struct PsnipClockWallCache* cache, psnip_uint64_t refresh_ns) {
+#if defined(PSNIP_CLOCK__TICKS_RDTSC)
+  psnip_uint64_t mono;
+  int r;
+#elif defined(PSNIP_CLOCK__TICKS_CNTVCT)
+  psnip_uint64_t freq;
+#endif
+
+  assert(cache != NULL);
+
+  cache->refresh_ns = refresh_ns;
+  cache->mono_origin = 0;
+  cache->tick_origin = 0;
+
+#if defined(PSNIP_CLOCK__TICKS_RDTSC)
+  /* Replaced by the first refresh. */
+  cache->mult = 1ULL << 32;
+
+  r = psnip_clock_get_time_ns (PSNIP_CLOCK_TYPE_MONOTONIC, &(cache->mono_origin));
+  if (r != 0)
+    return r;
+  cache->tick_origin = psnip_clock_ticks ();
+
+  do {
+    r = psnip_clock_get_time_ns (PSNIP_CLOCK_TYPE_MONOTONIC, &mono);
+    if (r != 0)
+      return r;
+  } while ((mono - cache->mono_origin) < PSNIP_CLOCK_WALL_CACHE_CALIBRATE);
+
+  /* If the TSC didn't move there's no rate to measure. */
+  if (psnip_clock_ticks () <= cache->tick_origin)
+    return -2;
+#elif defined(PSNIP_CLOCK__TICKS_CNTVCT)
+  __asm__ __volatile__ ("mrs %0, cntfrq_el0" : "=r" (freq));
+  if (freq == 0)
+    return -2;
+  cache->mult = (psnip_uint64_t) ((((double) PSNIP_CLOCK_NSEC_PER_SEC) * 4294967296.0) / (double) freq);
+#else
+  cache->mult = 1ULL << 32;
+#endif
+
+  return psnip_clock_wall_cache_refresh (cache);
+}
+
+/* Convert a value from psnip_clock_ticks to wall time (in nanoseconds
+ * since the epoch), using the current anchor.  This doesn't refresh
+ * the cache, so it's safe to use on ticks captured earlier; capture
+ * ticks as events happen, then convert the whole lot when you write
+ * them out. */
+PSNIP_CLOCK__FUNCTION psnip_uint64_t
+psnip_clock_wall_cache_convert (const struct PsnipClockWallCache* cache, psnip_uint64_t ticks) {
+  if (ticks >= cache->tick_base)
+    return cache->wall_base + psnip_clock__ticks_to_ns (ticks - cache->tick_base, cache->mult);
+  else
+    return cache->wall_base - psnip_clock__ticks_to_ns (cache->tick_base - ticks, cache->mult);
+}
+
+/* Convert count values from psnip_clock_ticks to wall times.  ticks
+ * and wall_ns may be the same array. */
+PSNIP_CLOCK__FUNCTION void
+psnip_clock_wall_cache_convert_batch (const struct PsnipClockWallCache* cache, const psnip_uint64_t* ticks, psnip_uint64_t* wall_ns, size_t count) {
+  size_t i;
+
+  for (i = 0 ; i < count ; i++)
+    wall_ns[i] = psnip_clock_wall_cache_convert (cache, ticks[i]);
+}
+
+/* Current wall time, in nanoseconds since the epoch, refreshing the
+ * cache first if the refresh interval has elapsed.  Returns 0 on
+ * success, or a negative value if the refresh failed. */
+PSNIP_CLOCK__FUNCTION int
+psnip_clock_wall_cache_now (struct PsnipClockWallCache* cache, psnip_uint64_t* res) {
+  const psnip_uint64_t ticks = psnip_clock_ticks ();
+  int r;
+
+  assert(cache != NULL);
+  assert(res != NULL);
+
+  if ((ticks - cache->tick_base) >= cache->refresh_ticks) {
+    r = psnip_clock_wall_cache_refresh (cache);
+    if (r != 0)
+      return r;
+  }
+
+  *res = psnip_clock_wall_cache_convert (cache, ticks);
+
+  return 0;
+}
+
 #endif /* !defined(PSNIP_CLOCK_H) */
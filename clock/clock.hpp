@@ -0,0 +1,150 @@
+/* Clocks for C++ (v1)
+ * Portable Snippets - https://github.com/nemequ/portable-snippets
+ * Created by Evan Nemerson <evan@nemerson.com>
+ *
+ *   To the extent possible under law, the authors have waived all
+ *   copyright and related or neighboring rights to this code.  For
+ *   details, see the Creative Commons Zero 1.0 Universal license at
+ *   https://creativecommons.org/publicdomain/zero/1.0/
+ *
+ * Each clock from clock.h, wrapped as a type which meets the C++11
+ * Clock requirements, so it can be used anywhere a std::chrono clock
+ * can (std::chrono::duration_cast, std::this_thread::sleep_until,
+ * etc.).  now() calls the implementation for the method selected at
+ * compile time directly, so there is no runtime switch on the clock
+ * type, and templated code can take the clock as a parameter:
+ *
+ *   template <typename Clock>
+ *   typename Clock::duration time_it (void (*func) (void)) {
+ *     const typename Clock::time_point start = Clock::now();
+ *     func();
+ *     return Clock::now() - start;
+ *   }
+ *
+ *   time_it<psnip::clock::monotonic_clock>(work);
+ *
+ * A clock type is only defined if clock.h found a method for it, so
+ * you can check for one with the PSNIP_CLOCK_*_METHOD macros.
+ */
+
+#if !defined(PSNIP_CLOCK_HPP)
+#define PSNIP_CLOCK_HPP
+
+#if !defined(__cplusplus) || \
+  ((__cplusplus < 201103L) && !(defined(_MSC_VER) && (_MSC_VER >= 1900)))
+#  error clock.hpp requires C++11
+#endif
+
+#if !defined(PSNIP_CLOCK_H)
+#  include "clock.h"
+#endif
+
+#include <chrono>
+
+namespace psnip {
+namespace clock {
+
+namespace detail {
+  /* Shared typedefs; Derived is the clock type itself, so each clock
+   * gets its own (incompatible) time_point. */
+  template <typename Derived, bool Steady>
+  struct basic_clock {
+    typedef std::chrono::nanoseconds                    duration;
+    typedef duration::rep                               rep;
+    typedef duration::period                            period;
+    typedef std::chrono::time_point<Derived, duration>  time_point;
+
+    static constexpr bool is_steady = Steady;
+
+  protected:
+    /* r is the return value of the psnip_clock_*_get_time function.
+     * If it failed we return time_point() (i.e., zero); that's
+     * extremely unlikely, since the clock is only defined if an
+     * implementation was found at compile time. */
+    static time_point from_timespec (int r, const struct PsnipClockTimespec& ts) noexcept {
+      if (r != 0)
+        return time_point ();
+
+      return time_point (duration (static_cast<rep> ((ts.seconds * PSNIP_CLOCK_NSEC_PER_SEC) + ts.nanoseconds)));
+    }
+  };
+
+  template <typename Derived, bool Steady>
+  constexpr bool basic_clock<Derived, Steady>::is_steady;
+}
+
+#if defined(PSNIP_CLOCK_WALL_METHOD)
+/* Time since the UNIX epoch; like std::chrono::system_clock, it can
+ * jump (in either direction) when the system time is changed. */
+struct wall_clock : detail::basic_clock<wall_clock, false> {
+  static constexpr int method = PSNIP_CLOCK_WALL_METHOD;
+  static constexpr PsnipClockType type = PSNIP_CLOCK_TYPE_WALL;
+  static time_point now () noexcept {
+    struct PsnipClockTimespec ts;
+    const int r = psnip_clock_wall_get_time (&ts);
+    return from_timespec (r, ts);
+  }
+};
+#endif
+
+#if defined(PSNIP_CLOCK_CPU_METHOD)
+/* CPU time used by the process.  It never goes backwards, but it
+ * isn't steady either since it doesn't advance with real time. */
+struct cpu_clock : detail::basic_clock<cpu_clock, false> {
+  static constexpr int method = PSNIP_CLOCK_CPU_METHOD;
+  static constexpr PsnipClockType type = PSNIP_CLOCK_TYPE_CPU;
+  static time_point now () noexcept {
+    struct PsnipClockTimespec ts;
+    const int r = psnip_clock_cpu_get_time (&ts);
+    return from_timespec (r, ts);
+  }
+};
+#endif
+
+#if defined(PSNIP_CLOCK_MONOTONIC_METHOD)
+struct monotonic_clock : detail::basic_clock<monotonic_clock, true> {
+  static constexpr int method = PSNIP_CLOCK_MONOTONIC_METHOD;
+  static constexpr PsnipClockType type = PSNIP_CLOCK_TYPE_MONOTONIC;
+  static time_point now () noexcept {
+    struct PsnipClockTimespec ts;
+    const int r = psnip_clock_monotonic_get_time (&ts);
+    return from_timespec (r, ts);
+  }
+};
+#endif
+
+#if defined(PSNIP_CLOCK_BOOTTIME_METHOD)
+/* Like monotonic_clock, but includes time spent suspended. */
+struct boottime_clock : detail::basic_clock<boottime_clock, true> {
+  static constexpr int method = PSNIP_CLOCK_BOOTTIME_METHOD;
+  static constexpr PsnipClockType type = PSNIP_CLOCK_TYPE_BOOTTIME;
+  static time_point now () noexcept {
+    struct PsnipClockTimespec ts;
+    const int r = psnip_clock_boottime_get_time (&ts);
+    return from_timespec (r, ts);
+  }
+};
+#endif
+
+/* Map a PsnipClockType to the corresponding clock, for code which is
+ * parameterized on the C enum; clock_for<PSNIP_CLOCK_TYPE_WALL>::type
+ * is wall_clock. */
+template <PsnipClockType Type> struct clock_for;
+
+#if defined(PSNIP_CLOCK_WALL_METHOD)
+template <> struct clock_for<PSNIP_CLOCK_TYPE_WALL> { typedef wall_clock type; };
+#endif
+#if defined(PSNIP_CLOCK_CPU_METHOD)
+template <> struct clock_for<PSNIP_CLOCK_TYPE_CPU> { typedef cpu_clock type; };
+#endif
+#if defined(PSNIP_CLOCK_MONOTONIC_METHOD)
+template <> struct clock_for<PSNIP_CLOCK_TYPE_MONOTONIC> { typedef monotonic_clock type; };
+#endif
+#if defined(PSNIP_CLOCK_BOOTTIME_METHOD)
+template <> struct clock_for<PSNIP_CLOCK_TYPE_BOOTTIME> { typedef boottime_clock type; };
+#endif
+
+}
+}
+
+#endif /* !defined(PSNIP_CLOCK_HPP) */
@@ -0,0 +1,172 @@
+/* Sharded Counters (v1)
+ * Portable Snippets - https://github.com/nemequ/portable-snippets
+ * Created by Evan Nemerson <evan@nemerson.com>
+ *
+ *   To the extent possible under law, the authors have waived all
+ *   copyright and related or neighboring rights to this code.  For
+ *   details, see the Creative Commons Zero 1.0 Universal license at
+ *   https://creativecommons.org/publicdomain/zero/1.0/
+ *
+ * A counter for statistics which are updated far more often than they
+ * are read.  Incrementing a single psnip_atomic_int64 from many
+ * threads makes its cache line bounce between every core doing it;
+ * struct PsnipCounter instead has PSNIP_COUNTER_SHARDS slots, each on
+ * its own cache line, and each thread adds to "its" slot.  Adding is
+ * a single relaxed fetch_add on a line nobody else is (usually)
+ * writing to, and reading sums all the slots.
+ *
+ * The read isn't a snapshot; additions which happen concurrently with
+ * it may or may not be included.  That's generally what you want for
+ * statistics, but don't use this for anything which needs an exact
+ * value while it is being updated.
+ *
+ * Threads are assigned slots round-robin the first time they add to
+ * any counter (if the compiler supports thread-local storage; if not
+ * we hash the address of a stack variable instead).  With more threads
+ * than slots some threads will share, which is still correct, just
+ * slower.
+ */
+
+#if !defined(PSNIP_COUNTER_H)
+#define PSNIP_COUNTER_H
+
+#if !defined(PSNIP_ATOMIC_H)
+#  include "../atomic/atomic.h"
+#endif
+#if !defined(PSNIP_CPU__H)
+#  include "../cpu/cpu.h"
+#endif
+
+#include <stddef.h>
+
+#if defined(PSNIP_ATOMIC_NOT_FOUND)
+#  error counter.h requires atomic operations
+#endif
+
+#if !defined(PSNIP_COUNTER_STATIC_INLINE)
+#  if defined(__GNUC__)
+#    define PSNIP_COUNTER__COMPILER_ATTRIBUTES __attribute__((__unused__))
+#  else
+#    define PSNIP_COUNTER__COMPILER_ATTRIBUTES
+#  endif
+
+#  if defined(HEDLEY_INLINE)
+#    define PSNIP_COUNTER__INLINE HEDLEY_INLINE
+#  elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#    define PSNIP_COUNTER__INLINE inline
+#  elif defined(__GNUC_STDC_INLINE__)
+#    define PSNIP_COUNTER__INLINE __inline__
+#  elif defined(_MSC_VER) && _MSC_VER >= 1200
+#    define PSNIP_COUNTER__INLINE __inline
+#  else
+#    define PSNIP_COUNTER__INLINE
+#  endif
+
+#  define PSNIP_COUNTER__FUNCTION PSNIP_COUNTER__COMPILER_ATTRIBUTES static PSNIP_COUNTER__INLINE
+#endif
+
+#if !defined(PSNIP_COUNTER_SHARDS)
+#  define PSNIP_COUNTER_SHARDS 64
+#endif
+
+#if defined(__GNUC__)
+#  define PSNIP_COUNTER__UNUSED __attribute__((__unused__))
+#else
+#  define PSNIP_COUNTER__UNUSED
+#endif
+
+#if defined(__cplusplus) && (__cplusplus >= 201103L)
+#  define PSNIP_COUNTER__THREAD_LOCAL thread_local
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+#  define PSNIP_COUNTER__THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+#  define PSNIP_COUNTER__THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#  define PSNIP_COUNTER__THREAD_LOCAL __declspec(thread)
+#endif
+
+/* The padding keeps the shards apart even where
+ * PSNIP_CACHE_LINE_ALIGNED expands to nothing; the alignment keeps
+ * each one from straddling two lines. */
+struct PsnipCounter__Shard {
+  PSNIP_CACHE_LINE_ALIGNED psnip_atomic_int64 value;
+  char pad[PSNIP_CACHE_LINE_SIZE - sizeof(psnip_atomic_int64)];
+};
+
+struct PsnipCounter {
+  struct PsnipCounter__Shard shards[PSNIP_COUNTER_SHARDS];
+};
+
+#if defined(PSNIP_COUNTER__THREAD_LOCAL)
+/* One more than the thread's slot, so zero means "not assigned yet". */
+PSNIP_COUNTER__UNUSED
+static PSNIP_COUNTER__THREAD_LOCAL size_t psnip_counter__thread_shard = 0;
+PSNIP_COUNTER__UNUSED
+static psnip_atomic_int32 psnip_counter__next_shard = PSNIP_ATOMIC_VAR_INIT(0);
+
+PSNIP_COUNTER__FUNCTION
+size_t
+psnip_counter__shard (void) {
+  if (psnip_counter__thread_shard == 0) {
+    const psnip_int32_t n = psnip_atomic_int32_fetch_add_explicit (&psnip_counter__next_shard, 1, PSNIP_ATOMIC_ORDER_RELAXED);
+    psnip_counter__thread_shard = ((size_t) (unsigned int) n % PSNIP_COUNTER_SHARDS) + 1;
+  }
+
+  return psnip_counter__thread_shard - 1;
+}
+#else
+PSNIP_COUNTER__FUNCTION
+size_t
+psnip_counter__shard (void) {
+  /* Every thread has its own stack, so the address of a local is a
+   * reasonable stand-in for a thread ID.  It varies a bit with the
+   * call depth, which just means a thread uses a few slots. */
+  char marker;
+  const size_t addr = (size_t) &marker;
+  return ((addr >> 12) * 2654435761U) % PSNIP_COUNTER_SHARDS;
+}
+#endif
+
+PSNIP_COUNTER__FUNCTION
+void
+psnip_counter_init (struct PsnipCounter* counter) {
+  size_t i;
+
+  for (i = 0 ; i < PSNIP_COUNTER_SHARDS ; i++)
+    psnip_atomic_int64_store_explicit (&(counter->shards[i].value), 0, PSNIP_ATOMIC_ORDER_RELAXED);
+}
+
+PSNIP_COUNTER__FUNCTION
+void
+psnip_counter_add (struct PsnipCounter* counter, psnip_int64_t value) {
+  psnip_atomic_int64_fetch_add_explicit (&(counter->shards[psnip_counter__shard ()].value), value, PSNIP_ATOMIC_ORDER_RELAXED);
+}
+
+PSNIP_COUNTER__FUNCTION
+psnip_int64_t
+psnip_counter_read (struct PsnipCounter* counter) {
+  psnip_int64_t sum = 0;
+  size_t i;
+
+  for (i = 0 ; i < PSNIP_COUNTER_SHARDS ; i++)
+    sum += psnip_atomic_int64_load_explicit (&(counter->shards[i].value), PSNIP_ATOMIC_ORDER_RELAXED);
+
+  return sum;
+}
+
+/* Returns the total and sets the counter to zero.  Each slot is
+ * exchanged with zero, so no concurrent addition is lost; it will
+ * show up either in the value returned or in the next read. */
+PSNIP_COUNTER__FUNCTION
+psnip_int64_t
+psnip_counter_read_and_reset (struct PsnipCounter* counter) {
+  psnip_int64_t sum = 0;
+  size_t i;
+
+  for (i = 0 ; i < PSNIP_COUNTER_SHARDS ; i++)
+    sum += psnip_atomic_int64_exchange_explicit (&(counter->shards[i].value), 0, PSNIP_ATOMIC_ORDER_RELAXED);
+
+  return sum;
+}
+
+#endif /* !defined(PSNIP_COUNTER_H) */
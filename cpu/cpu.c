@@ -40,6 +40,29 @@ static void psnip_cpu_getid(int func, int* data) {
 	   : "0" (func), "2" (0));
 }
 #  endif
+
+/* XCR0 says which register state the OS saves on a context switch;
+ * only read it if CPUID says XGETBV is enabled (OSXSAVE). */
+#  if defined(_MSC_VER) && (_MSC_FULL_VER >= 160040219)
+#    include <immintrin.h>
+static unsigned int psnip_cpu_getxcr0(void) {
+  return (unsigned int) _xgetbv(0);
+}
+#  elif defined(__GNUC__)
+static unsigned int psnip_cpu_getxcr0(void) {
+  unsigned int eax, edx;
+  /* xgetbv, spelled out for assemblers which don't know it. */
+  __asm__ (".byte 0x0f, 0x01, 0xd0"
+	   : "=a" (eax), "=d" (edx)
+	   : "c" (0));
+  (void) edx;
+  return eax;
+}
+#  else
+static unsigned int psnip_cpu_getxcr0(void) {
+  return 0;
+}
+#  endif
 #elif defined(PSNIP_CPU_ARCH_ARM) || defined(PSNIP_CPU_ARCH_ARM64)
 #  if (defined(__GNUC__) && ((__GNUC__ > 2) || (__GNUC__ == 2 && __GNUC_MINOR__ >= 16)))
 #    define PSNIP_CPU__IMPL_GETAUXVAL
@@ -51,6 +74,7 @@ static psnip_once psnip_cpu_once = PSNIP_ONCE_INIT;
 
 #if defined(PSNIP_CPU_ARCH_X86) || defined(PSNIP_CPU_ARCH_X86_64)
 static unsigned int psnip_cpuinfo[8 * 4] = { 0, };
+static unsigned int psnip_cpu_xcr0 = 0;
 #elif defined(PSNIP_CPU_ARCH_ARM) || defined(PSNIP_CPU_ARCH_ARM_64)
 static unsigned long psnip_cpuinfo[2] = { 0, };
 #endif
@@ -61,6 +85,8 @@ static void psnip_cpu_init(void) {
   for (i = 0 ; i < 8 ; i++) {
     psnip_cpu_getid(i, (int*) &(psnip_cpuinfo[i * 4]));
   }
+  if ((psnip_cpuinfo[(1 * 4) + 2] >> 27) & 1)
+    psnip_cpu_xcr0 = psnip_cpu_getxcr0();
 #elif defined(PSNIP_CPU_ARCH_ARM) || defined(PSNIP_CPU_ARCH_ARM_64)
   psnip_cpuinfo[0] = getauxval (AT_HWCAP);
   psnip_cpuinfo[1] = getauxval (AT_HWCAP2);
@@ -111,6 +137,49 @@ psnip_cpu_feature_check (enum PSnipCPUFeature feature) {
 #endif
 }
 
+int
+psnip_cpu_feature_usable (enum PSnipCPUFeature feature) {
+#if defined(PSNIP_CPU_ARCH_X86) || defined(PSNIP_CPU_ARCH_X86_64)
+  unsigned int state;
+#endif
+
+  if (!psnip_cpu_feature_check(feature))
+    return 0;
+
+#if defined(PSNIP_CPU_ARCH_X86) || defined(PSNIP_CPU_ARCH_X86_64)
+  switch ((unsigned int) feature) {
+    /* SSE and AVX (YMM) state. */
+    case PSNIP_CPU_FEATURE_X86_AVX:
+    case PSNIP_CPU_FEATURE_X86_AVX2:
+    case PSNIP_CPU_FEATURE_X86_FMA:
+    case PSNIP_CPU_FEATURE_X86_F16C:
+      state = 0x06;
+      break;
+    /* ... plus the opmask registers and both halves of the ZMM state. */
+    case PSNIP_CPU_FEATURE_X86_AVX512F:
+    case PSNIP_CPU_FEATURE_X86_AVX512DQ:
+    case PSNIP_CPU_FEATURE_X86_AVX512IFMA:
+    case PSNIP_CPU_FEATURE_X86_AVX512PF:
+    case PSNIP_CPU_FEATURE_X86_AVX512ER:
+    case PSNIP_CPU_FEATURE_X86_AVX512CD:
+    case PSNIP_CPU_FEATURE_X86_AVX512BW:
+    case PSNIP_CPU_FEATURE_X86_AVX512VL:
+    case PSNIP_CPU_FEATURE_X86_AVX512VBMI:
+    case PSNIP_CPU_FEATURE_X86_AVX512VPOPCNTDQ:
+    case PSNIP_CPU_FEATURE_X86_AVX512_4VNNIW:
+    case PSNIP_CPU_FEATURE_X86_AVX512_4FMAPS:
+      state = 0xe6;
+      break;
+    default:
+      return 1;
+  }
+
+  return (psnip_cpu_xcr0 & state) == state;
+#else
+  return 1;
+#endif
+}
+
 int
 psnip_cpu_feature_check_many (enum PSnipCPUFeature* feature) {
   int n;
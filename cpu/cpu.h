@@ -21,6 +21,47 @@
 #  define PSNIP_CPU_ARCH_ARM64
 #endif
 
+/* The distance objects written by different threads should be kept
+ * apart to avoid false sharing.  This is a compile-time guess, not
+ * something we query from the CPU; define it yourself if you know
+ * better. */
+#if !defined(PSNIP_CACHE_LINE_SIZE)
+#  if defined(PSNIP_CPU_ARCH_ARM64) && defined(__APPLE__)
+#    define PSNIP_CACHE_LINE_SIZE 128
+#  elif defined(__powerpc64__) || defined(__ppc64__) || defined(_ARCH_PPC64)
+#    define PSNIP_CACHE_LINE_SIZE 128
+#  elif defined(__s390x__)
+#    define PSNIP_CACHE_LINE_SIZE 256
+#  else
+#    define PSNIP_CACHE_LINE_SIZE 64
+#  endif
+#endif
+
+/* Align a variable or struct member to PSNIP_CACHE_LINE_SIZE; it goes
+ * at the start of the declaration:
+ *
+ *   PSNIP_CACHE_LINE_ALIGNED psnip_atomic_int64 counter;
+ *
+ * If the compiler has no way to do that it expands to nothing, so
+ * don't rely on it for correctness, only for performance. */
+#if !defined(PSNIP_CACHE_LINE_ALIGNED)
+#  if defined(__GNUC__)
+#    define PSNIP_CACHE_LINE_ALIGNED __attribute__((__aligned__(PSNIP_CACHE_LINE_SIZE)))
+#  elif defined(_MSC_VER)
+#    define PSNIP_CACHE_LINE_ALIGNED __declspec(align(PSNIP_CACHE_LINE_SIZE))
+#  elif defined(__cplusplus) && (__cplusplus >= 201103L)
+#    define PSNIP_CACHE_LINE_ALIGNED alignas(PSNIP_CACHE_LINE_SIZE)
+#  elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L)
+#    define PSNIP_CACHE_LINE_ALIGNED _Alignas(PSNIP_CACHE_LINE_SIZE)
+#  else
+#    define PSNIP_CACHE_LINE_ALIGNED
+#  endif
+#endif
+
+#if !defined(PSNIP_CPU_PAUSE_H)
+#  include "pause.h"
+#endif
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -181,6 +222,7 @@ enum PSnipCPUFeature {
 
 int psnip_cpu_count              (void);
 int psnip_cpu_feature_check      (enum PSnipCPUFeature  feature);
+int psnip_cpu_feature_usable     (enum PSnipCPUFeature  feature);
 int psnip_cpu_feature_check_many (enum PSnipCPUFeature* feature);
 
 #if defined(__cplusplus)
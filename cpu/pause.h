@@ -0,0 +1,36 @@
+/* CPU Spin-Loop Hint (v1)
+ * Portable Snippets - https://github.com/nemequ/portable-snippets
+ * Created by Evan Nemerson <evan@nemerson.com>
+ *
+ *   To the extent possible under law, the authors have waived all
+ *   copyright and related or neighboring rights to this code.  For
+ *   details, see the Creative Commons Zero 1.0 Universal license at
+ *   https://creativecommons.org/publicdomain/zero/1.0/
+ *
+ * Just PSNIP_CPU_PAUSE, without the rest of cpu.h, so modules with
+ * spin loops can use it without depending on the feature checks.
+ * cpu.h includes this too.
+ */
+
+#if !defined(PSNIP_CPU_PAUSE_H)
+#define PSNIP_CPU_PAUSE_H
+
+/* Hint to the CPU that we're busy-waiting (pause on x86, yield on
+ * ARM), for the body of spin loops. */
+#if !defined(PSNIP_CPU_PAUSE)
+#  if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#    define PSNIP_CPU_PAUSE() __asm__ __volatile__ ("pause")
+#  elif defined(__GNUC__) && (defined(__aarch64__) || (defined(__ARM_ARCH) && (__ARM_ARCH >= 7)))
+#    define PSNIP_CPU_PAUSE() __asm__ __volatile__ ("yield")
+#  elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#    include <intrin.h>
+#    define PSNIP_CPU_PAUSE() _mm_pause()
+#  elif defined(_MSC_VER) && (defined(_M_ARM) || defined(_M_ARM64))
+#    include <intrin.h>
+#    define PSNIP_CPU_PAUSE() __yield()
+#  else
+#    define PSNIP_CPU_PAUSE() do { } while (0)
+#  endif
+#endif
+
+#endif /* !defined(PSNIP_CPU_PAUSE_H) */
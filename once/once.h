@@ -18,6 +18,7 @@
 #define PSNIP_ONCE__BACKEND_WIN32   32
 
 #include <limits.h>
+#include <stddef.h>
 
 #if !defined(PSNIP_ONCE_BACKEND)
 #  if defined(__STDC_NO_THREADS__) && __STDC_NO_THREADS__
@@ -59,23 +60,149 @@
 #  error No once backend found.
 #endif
 
+#if !defined(PSNIP_ATOMIC_H) && PSNIP_ONCE_BACKEND != PSNIP_ONCE__BACKEND_NONE
+#  include "../atomic/atomic.h"
+#endif
+
+#if !defined(PSNIP_CPU_PAUSE_H)
+#  include "../cpu/pause.h"
+#endif
+
+/* call_once, pthread_once and InitOnceExecuteOnce are all out-of-line
+ * library calls, even after the function has run, so psnip_once wraps
+ * them in a struct with a flag we can check inline first. */
+#if \
+  (PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_C11 || \
+   PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_PTHREAD || \
+   PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_WIN32) && \
+  !defined(PSNIP_ATOMIC_NOT_FOUND)
+#  define PSNIP_ONCE__DONE_FLAG
+#endif
+
+#if defined(__GNUC__)
+#  define PSNIP_ONCE__COMPILER_ATTRIBUTES __attribute__((__unused__))
+#else
+#  define PSNIP_ONCE__COMPILER_ATTRIBUTES
+#endif
+
+#if defined(HEDLEY_INLINE)
+#  define PSNIP_ONCE__INLINE HEDLEY_INLINE
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#  define PSNIP_ONCE__INLINE inline
+#elif defined(__GNUC_STDC_INLINE__)
+#  define PSNIP_ONCE__INLINE __inline__
+#elif defined(_MSC_VER) && _MSC_VER >= 1200
+#  define PSNIP_ONCE__INLINE __inline
+#else
+#  define PSNIP_ONCE__INLINE
+#endif
+
+#define PSNIP_ONCE__FUNCTION PSNIP_ONCE__COMPILER_ATTRIBUTES static PSNIP_ONCE__INLINE
+
 #if defined(__GNUC__) && (__GNUC__ >= 3)
 #  define PSNIP_ONCE__UNLIKELY(expr) __builtin_expect(!!(expr), !!0)
 #else
 #  define PSNIP_ONCE__UNLIKELY(expr) (!!(expr))
 #endif
 
+/* The function and argument for psnip_once_call_ctx. */
+struct PsnipOnce__Ctx {
+  void (*func)(void* ctx);
+  void* ctx;
+};
+
+#if defined(PSNIP_ONCE_PARK) && \
+  (PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_NONE || defined(PSNIP_ATOMIC_NOT_FOUND))
+#  error PSNIP_ONCE_PARK requires atomic operations (and atomic-wait)
+#endif
+
+/* The psnip_atomic_int32 state machine used by the atomic backend
+ * and by psnip_once_fallible on every backend but NONE. */
+#if PSNIP_ONCE_BACKEND != PSNIP_ONCE__BACKEND_NONE && !defined(PSNIP_ATOMIC_NOT_FOUND)
+#  define PSNIP_ONCE__STATE_MACHINE
+
+#define PSNIP_ONCE__STATE_INIT    0
+#define PSNIP_ONCE__STATE_RUNNING 1
+#define PSNIP_ONCE__STATE_DONE    2
+/* Still running, and at least one thread is parked waiting for it. */
+#define PSNIP_ONCE__STATE_PARKED  3
+
+/* Rounds of exponential backoff a waiter goes through before it parks
+ * (or, without PSNIP_ONCE_PARK, starts yielding).  The last round is
+ * 2^(PSNIP_ONCE_SPINS - 1) pauses. */
+#if !defined(PSNIP_ONCE_SPINS)
+#  define PSNIP_ONCE_SPINS 10
+#endif
+
+/* Parking has to be the same everywhere a flag is used: only waiters
+ * which park mark the flag PARKED, and only initializers which park
+ * know to wake them.  So it's a build-wide setting (define
+ * PSNIP_ONCE_PARK on the command line, and link atomic-wait.c), not
+ * something inferred from what happened to be included. */
+#if defined(PSNIP_ONCE_PARK)
+#  if !defined(PSNIP_ATOMIC_WAIT_H)
+#    include "../atomic-wait/atomic-wait.h"
+#  endif
+#  define PSNIP_ONCE__PARK
+#elif defined(_WIN32)
+#  define PSNIP_ONCE__YIELD() ((void) SwitchToThread())
+#elif defined(__unix__) || defined(__APPLE__)
+#  include <sched.h>
+#  define PSNIP_ONCE__YIELD() ((void) sched_yield())
+#else
+#  define PSNIP_ONCE__YIELD() PSNIP_CPU_PAUSE()
+#endif
+
+/* Waits until nobody is running the initializer and returns the new
+ * state: DONE, or (for psnip_once_fallible) INIT if it failed. */
+PSNIP_ONCE__FUNCTION
+psnip_int32_t
+psnip_once__wait(psnip_atomic_int32* flag) {
+  psnip_int32_t state;
+  int round, i;
+
+  for (round = 0 ; round < PSNIP_ONCE_SPINS ; round++) {
+    for (i = 0 ; i < (1 << round) ; i++)
+      PSNIP_CPU_PAUSE();
+    state = psnip_atomic_int32_load_explicit(flag, PSNIP_ATOMIC_ORDER_ACQUIRE);
+    if (state != PSNIP_ONCE__STATE_RUNNING && state != PSNIP_ONCE__STATE_PARKED)
+      return state;
+  }
+
+#if defined(PSNIP_ONCE__PARK)
+  for (;;) {
+    state = psnip_atomic_int32_load_explicit(flag, PSNIP_ATOMIC_ORDER_ACQUIRE);
+    if (state != PSNIP_ONCE__STATE_RUNNING && state != PSNIP_ONCE__STATE_PARKED)
+      return state;
+    /* Tell the initializing thread it needs to wake us. */
+    if (state == PSNIP_ONCE__STATE_RUNNING &&
+        !psnip_atomic_int32_compare_exchange_explicit(flag, &state, PSNIP_ONCE__STATE_PARKED,
+                                                      PSNIP_ATOMIC_ORDER_RELAXED, PSNIP_ATOMIC_ORDER_RELAXED))
+      continue;
+    psnip_atomic_int32_wait(flag, PSNIP_ONCE__STATE_PARKED);
+  }
+#else
+  for (;;) {
+    state = psnip_atomic_int32_load_explicit(flag, PSNIP_ATOMIC_ORDER_ACQUIRE);
+    if (state != PSNIP_ONCE__STATE_RUNNING && state != PSNIP_ONCE__STATE_PARKED)
+      return state;
+    PSNIP_ONCE__YIELD();
+  }
+#endif
+}
+#endif
+
 #if PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_C11
-#  define PSNIP_ONCE_INIT ONCE_FLAG_INIT
-typedef once_flag psnip_once;
-#  define psnip_once_call(flag, func) call_once(flag, func)
+#  define PSNIP_ONCE__NATIVE_INIT ONCE_FLAG_INIT
+typedef once_flag psnip_once__native;
+#  define psnip_once__native_call(flag, func) call_once(flag, func)
 #elif PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_PTHREAD
-#  define PSNIP_ONCE_INIT PTHREAD_ONCE_INIT
-typedef pthread_once_t psnip_once;
-#  define psnip_once_call(flag, func) pthread_once(flag, func)
+#  define PSNIP_ONCE__NATIVE_INIT PTHREAD_ONCE_INIT
+typedef pthread_once_t psnip_once__native;
+#  define psnip_once__native_call(flag, func) pthread_once(flag, func)
 #elif PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_WIN32
-#  define PSNIP_ONCE_INIT INIT_ONCE_STATIC_INIT
-typedef INIT_ONCE psnip_once;
+#  define PSNIP_ONCE__NATIVE_INIT INIT_ONCE_STATIC_INIT
+typedef INIT_ONCE psnip_once__native;
 static BOOL CALLBACK psnip_once__callback_wrap(INIT_ONCE* InitOnce, void* Parameter, void** Context) {
   (void) Context;
   (void) InitOnce;
@@ -90,29 +217,110 @@ static BOOL CALLBACK psnip_once__callback_wrap(INIT_ONCE* InitOnce, void* Parame
   return !0;
 }
 #  if defined(_MSC_VER) && (_MSC_VER >= 1500)
-#    define psnip_once_call(flag, func) \
+#    define psnip_once__native_call(flag, func) \
   __pragma(warning(push)) \
   __pragma(warning(disable:4152)) \
   InitOnceExecuteOnce(flag, &psnip_once__callback_wrap, func, NULL) \
   __pragma(warning(pop))
 #  else
-#    define psnip_once_call(flag, func) InitOnceExecuteOnce(flag, &psnip_once__callback_wrap, func, NULL)
+#    define psnip_once__native_call(flag, func) InitOnceExecuteOnce(flag, &psnip_once__callback_wrap, func, NULL)
 #  endif
+static BOOL CALLBACK psnip_once__callback_ctx_wrap(INIT_ONCE* InitOnce, void* Parameter, void** Context) {
+  struct PsnipOnce__Ctx* c = (struct PsnipOnce__Ctx*) Parameter;
+  (void) Context;
+  (void) InitOnce;
+  c->func(c->ctx);
+  return !0;
+}
+#endif
+
+#if defined(PSNIP_ONCE__DONE_FLAG)
+typedef struct {
+  psnip_atomic_int32 done;
+  psnip_once__native native;
+} psnip_once;
+#  define PSNIP_ONCE_INIT { PSNIP_ATOMIC_VAR_INIT(0), PSNIP_ONCE__NATIVE_INIT }
+#  define PSNIP_ONCE__IS_DONE(once) \
+  (psnip_atomic_int32_load_explicit(&((once)->done), PSNIP_ATOMIC_ORDER_ACQUIRE) != 0)
+
+/* Whoever ran func, it has finished by the time the native call
+ * returns, so it's safe for every caller to set done. */
+PSNIP_ONCE__FUNCTION
+void
+psnip_once_call(psnip_once* once, void (*func)(void)) {
+  if (PSNIP_ONCE__UNLIKELY(!PSNIP_ONCE__IS_DONE(once))) {
+    psnip_once__native_call(&(once->native), func);
+    psnip_atomic_int32_store_explicit(&(once->done), 1, PSNIP_ATOMIC_ORDER_RELEASE);
+  }
+}
+#elif defined(PSNIP_ONCE__NATIVE_INIT)
+typedef psnip_once__native psnip_once;
+#  define PSNIP_ONCE_INIT PSNIP_ONCE__NATIVE_INIT
+#  define PSNIP_ONCE__IS_DONE(once) 0
+#  define psnip_once_call(flag, func) psnip_once__native_call(flag, func)
+#endif
+
+#if PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_WIN32
+PSNIP_ONCE__FUNCTION
+void
+psnip_once_call_ctx(psnip_once* flag, void (*func)(void* ctx), void* ctx) {
+  struct PsnipOnce__Ctx c;
+
+  if (PSNIP_ONCE__IS_DONE(flag))
+    return;
+
+  c.func = func;
+  c.ctx = ctx;
+#if defined(PSNIP_ONCE__DONE_FLAG)
+  InitOnceExecuteOnce(&(flag->native), &psnip_once__callback_ctx_wrap, &c, NULL);
+  psnip_atomic_int32_store_explicit(&(flag->done), 1, PSNIP_ATOMIC_ORDER_RELEASE);
+#else
+  InitOnceExecuteOnce(flag, &psnip_once__callback_ctx_wrap, &c, NULL);
+#endif
+}
 #elif PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_ATOMIC
 #  define PSNIP_ONCE_INIT PSNIP_ATOMIC_VAR_INIT(0)
 typedef psnip_atomic_int32 psnip_once;
-static void psnip_once_call(psnip_once* flag, void (*func)(void)) {
-  psnip_int32_t state = psnip_atomic_int32_load(flag);
-  if (PSNIP_ONCE__UNLIKELY(state == 0)) {
-    if (psnip_atomic_int32_compare_exchange(flag, &state, 1)) {
+
+/* Calls func() or, if it's NULL, c->func(c->ctx). */
+PSNIP_ONCE__FUNCTION
+void
+psnip_once__call_slow(psnip_once* flag, void (*func)(void), const struct PsnipOnce__Ctx* c) {
+  psnip_int32_t state = PSNIP_ONCE__STATE_INIT;
+
+  if (psnip_atomic_int32_compare_exchange_explicit(flag, &state, PSNIP_ONCE__STATE_RUNNING,
+                                                   PSNIP_ATOMIC_ORDER_ACQUIRE, PSNIP_ATOMIC_ORDER_ACQUIRE)) {
+    if (func != NULL)
       func();
-      psnip_atomic_int32_store(flag, 2);
-    } else {
-      do {
-	/* Spin; another thread is calling the initialization
-	   function. */
-      } while (psnip_atomic_int32_load(flag) == 1);
-    }
+    else
+      c->func(c->ctx);
+    state = psnip_atomic_int32_exchange_explicit(flag, PSNIP_ONCE__STATE_DONE, PSNIP_ATOMIC_ORDER_ACQ_REL);
+#if defined(PSNIP_ONCE__PARK)
+    if (state == PSNIP_ONCE__STATE_PARKED)
+      psnip_atomic_int32_notify_all(flag);
+#endif
+  } else if (state != PSNIP_ONCE__STATE_DONE) {
+    psnip_once__wait(flag);
+  }
+}
+
+/* Once the initializer has run this is just an acquire load. */
+PSNIP_ONCE__FUNCTION
+void
+psnip_once_call(psnip_once* flag, void (*func)(void)) {
+  if (PSNIP_ONCE__UNLIKELY(psnip_atomic_int32_load_explicit(flag, PSNIP_ATOMIC_ORDER_ACQUIRE) != PSNIP_ONCE__STATE_DONE))
+    psnip_once__call_slow(flag, func, NULL);
+}
+
+PSNIP_ONCE__FUNCTION
+void
+psnip_once_call_ctx(psnip_once* flag, void (*func)(void* ctx), void* ctx) {
+  struct PsnipOnce__Ctx c;
+
+  if (PSNIP_ONCE__UNLIKELY(psnip_atomic_int32_load_explicit(flag, PSNIP_ATOMIC_ORDER_ACQUIRE) != PSNIP_ONCE__STATE_DONE)) {
+    c.func = func;
+    c.ctx = ctx;
+    psnip_once__call_slow(flag, NULL, &c);
   }
 }
 #elif PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_NONE
@@ -124,6 +332,191 @@ static void psnip_once_call(psnip_once* flag, void (*func)(void)) {
     *flag = 1;
   }
 }
+PSNIP_ONCE__FUNCTION
+void
+psnip_once_call_ctx(psnip_once* flag, void (*func)(void* ctx), void* ctx) {
+  if (*flag == 0) {
+    func(ctx);
+    *flag = 1;
+  }
+}
+#endif
+
+/* call_once and pthread_once don't pass an argument to the function,
+ * so psnip_once_call_ctx stashes it in a thread-local variable.  The
+ * function always runs on the thread which called
+ * psnip_once_call_ctx, so nobody else can see it, and it is read
+ * before the function runs, so nested calls are fine. */
+#if PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_C11 || PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_PTHREAD
+#  if defined(__cplusplus) && (__cplusplus >= 201103L)
+#    define PSNIP_ONCE__THREAD_LOCAL thread_local
+#  elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+#    define PSNIP_ONCE__THREAD_LOCAL _Thread_local
+#  elif defined(__GNUC__)
+#    define PSNIP_ONCE__THREAD_LOCAL __thread
+#  elif defined(_MSC_VER)
+#    define PSNIP_ONCE__THREAD_LOCAL __declspec(thread)
+#  endif
+
+#  if defined(PSNIP_ONCE__THREAD_LOCAL)
+PSNIP_ONCE__COMPILER_ATTRIBUTES
+static PSNIP_ONCE__THREAD_LOCAL struct PsnipOnce__Ctx psnip_once__ctx;
+
+PSNIP_ONCE__FUNCTION
+void
+psnip_once__ctx_trampoline(void) {
+  const struct PsnipOnce__Ctx c = psnip_once__ctx;
+  c.func(c.ctx);
+}
+
+PSNIP_ONCE__FUNCTION
+void
+psnip_once_call_ctx(psnip_once* flag, void (*func)(void* ctx), void* ctx) {
+  if (PSNIP_ONCE__IS_DONE(flag))
+    return;
+
+  psnip_once__ctx.func = func;
+  psnip_once__ctx.ctx = ctx;
+  psnip_once_call(flag, psnip_once__ctx_trampoline);
+}
+#  endif
+#endif
+
+/* Reset a flag at run time, for one which is part of a dynamically
+ * allocated object.  Don't do this while anyone could be using it. */
+PSNIP_ONCE__FUNCTION
+void
+psnip_once_init(psnip_once* flag) {
+  static const psnip_once init = PSNIP_ONCE_INIT;
+  *flag = init;
+}
+
+#if !(PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_C11 || PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_PTHREAD) || \
+  defined(PSNIP_ONCE__THREAD_LOCAL)
+/* A value which is created the first time someone asks for it:
+ *
+ *   static struct PsnipOnceLazy table = PSNIP_ONCE_LAZY_INIT;
+ *   struct Table* t = psnip_once_lazy_get(&table, table_new, NULL);
+ *
+ * create is called (once) with ctx and its return value is what
+ * psnip_once_lazy_get returns, from then on. */
+struct PsnipOnceLazy {
+  psnip_once once;
+  void* value;
+};
+
+#define PSNIP_ONCE_LAZY_INIT { PSNIP_ONCE_INIT, NULL }
+
+struct PsnipOnce__LazyCtx {
+  struct PsnipOnceLazy* lazy;
+  void* (*create)(void* ctx);
+  void* ctx;
+};
+
+PSNIP_ONCE__FUNCTION
+void
+psnip_once__lazy_create(void* ctx) {
+  struct PsnipOnce__LazyCtx* l = (struct PsnipOnce__LazyCtx*) ctx;
+  l->lazy->value = l->create(l->ctx);
+}
+
+PSNIP_ONCE__FUNCTION
+void
+psnip_once_lazy_init(struct PsnipOnceLazy* lazy) {
+  psnip_once_init(&(lazy->once));
+  lazy->value = NULL;
+}
+
+PSNIP_ONCE__FUNCTION
+void*
+psnip_once_lazy_get(struct PsnipOnceLazy* lazy, void* (*create)(void* ctx), void* ctx) {
+  struct PsnipOnce__LazyCtx l;
+
+  l.lazy = lazy;
+  l.create = create;
+  l.ctx = ctx;
+  psnip_once_call_ctx(&(lazy->once), psnip_once__lazy_create, &l);
+
+  return lazy->value;
+}
+#endif
+
+/* A once flag whose initializer can fail.  func returns 0 on success;
+ * anything else is passed back to the caller and resets the flag, so
+ * the next call tries again instead of failing forever:
+ *
+ *   static psnip_once_fallible once = PSNIP_ONCE_FALLIBLE_INIT;
+ *   if (psnip_once_fallible_call(&once, open_device, NULL) != 0)
+ *     return -1;
+ *
+ * Once func has succeeded this is just an acquire load.  While it is
+ * running other callers wait, as with psnip_once_call; if it fails
+ * they each get a turn at running it themselves. */
+#if defined(PSNIP_ONCE__STATE_MACHINE)
+typedef psnip_atomic_int32 psnip_once_fallible;
+#  define PSNIP_ONCE_FALLIBLE_INIT PSNIP_ATOMIC_VAR_INIT(PSNIP_ONCE__STATE_INIT)
+
+PSNIP_ONCE__FUNCTION
+int
+psnip_once__fallible_call_slow(psnip_once_fallible* flag, int (*func)(void* ctx), void* ctx) {
+  psnip_int32_t state;
+  int res;
+
+  for (;;) {
+    state = PSNIP_ONCE__STATE_INIT;
+    if (psnip_atomic_int32_compare_exchange_explicit(flag, &state, PSNIP_ONCE__STATE_RUNNING,
+                                                     PSNIP_ATOMIC_ORDER_ACQUIRE, PSNIP_ATOMIC_ORDER_ACQUIRE)) {
+      res = func(ctx);
+      state = psnip_atomic_int32_exchange_explicit(flag,
+                                                   (res == 0) ? PSNIP_ONCE__STATE_DONE : PSNIP_ONCE__STATE_INIT,
+                                                   PSNIP_ATOMIC_ORDER_ACQ_REL);
+#if defined(PSNIP_ONCE__PARK)
+      if (state == PSNIP_ONCE__STATE_PARKED)
+        psnip_atomic_int32_notify_all(flag);
+#endif
+      return res;
+    }
+
+    if (state == PSNIP_ONCE__STATE_DONE || psnip_once__wait(flag) == PSNIP_ONCE__STATE_DONE)
+      return 0;
+  }
+}
+
+PSNIP_ONCE__FUNCTION
+int
+psnip_once_fallible_call(psnip_once_fallible* flag, int (*func)(void* ctx), void* ctx) {
+  if (PSNIP_ONCE__UNLIKELY(psnip_atomic_int32_load_explicit(flag, PSNIP_ATOMIC_ORDER_ACQUIRE) != PSNIP_ONCE__STATE_DONE))
+    return psnip_once__fallible_call_slow(flag, func, ctx);
+  return 0;
+}
+
+PSNIP_ONCE__FUNCTION
+void
+psnip_once_fallible_init(psnip_once_fallible* flag) {
+  psnip_atomic_int32_store(flag, PSNIP_ONCE__STATE_INIT);
+}
+#elif PSNIP_ONCE_BACKEND == PSNIP_ONCE__BACKEND_NONE
+typedef int psnip_once_fallible;
+#  define PSNIP_ONCE_FALLIBLE_INIT 0
+
+PSNIP_ONCE__FUNCTION
+int
+psnip_once_fallible_call(psnip_once_fallible* flag, int (*func)(void* ctx), void* ctx) {
+  int res = 0;
+
+  if (*flag == 0) {
+    res = func(ctx);
+    *flag = (res == 0);
+  }
+
+  return res;
+}
+
+PSNIP_ONCE__FUNCTION
+void
+psnip_once_fallible_init(psnip_once_fallible* flag) {
+  *flag = 0;
+}
 #endif
 
 #endif /* !defined(PSNIP_ONCE__H) */
@@ -32,7 +32,9 @@
 #endif
 
 static int (* psnip_random_secure_generate)(size_t length, psnip_uint8_t data[PSNIP_RANDOM_ARRAY_PARAM(length)]) = NULL;
-static psnip_once psnip_random_secure_once = PSNIP_ONCE_INIT;
+/* Fallible, so that if we can't find a source (for example, because
+ * we're out of file descriptors) we try again next time. */
+static psnip_once_fallible psnip_random_secure_once = PSNIP_ONCE_FALLIBLE_INIT;
 
 #if defined(__linux)
 #  include <unistd.h>
@@ -142,19 +144,23 @@ static int psnip_random_secure_generate_RtlGenRandom(size_t length, psnip_uint8_
   return psnip_rand_secure__RtlGenRandom(data, (ULONG) length) ? 0 : -3;
 }
 
-static void
-psnip_random_secure_init(void) {
-  psnip_rand_secure__advapi32_dll = LoadLibrary("ADVAPI32.DLL");
+static int
+psnip_random_secure_init(void* ctx) {
+  (void) ctx;
+
+  if (psnip_rand_secure__advapi32_dll == NULL)
+    psnip_rand_secure__advapi32_dll = LoadLibrary("ADVAPI32.DLL");
   if (psnip_rand_secure__advapi32_dll == NULL)
-    return;
+    return -1;
 
   psnip_rand_secure__RtlGenRandom = (BOOLEAN (APIENTRY *)(void*,ULONG))
     GetProcAddress(psnip_rand_secure__advapi32_dll, "SystemFunction036");
 
   if (psnip_rand_secure__RtlGenRandom == NULL)
-    return;
+    return -1;
 
   psnip_random_secure_generate = &psnip_random_secure_generate_RtlGenRandom;
+  return 0;
 }
 
 #  define PSNIP_RANDOM_SECURE_FOUND
@@ -187,7 +193,7 @@ psnip_random_secure_generate_dev_urandom(size_t length, psnip_uint8_t data[PSNIP
   size_t bytes_read = 0;
 
   if (dev_urandom == NULL) {
-    dev_urandom = fopen("/dev/random", "rb");
+    dev_urandom = fopen("/dev/urandom", "rb");
     if (dev_urandom == NULL)
       return -1;
   }
@@ -201,31 +207,35 @@ psnip_random_secure_generate_dev_urandom(size_t length, psnip_uint8_t data[PSNIP
   return 0;
 }
 
-static void
-psnip_random_secure_init(void) {
+static int
+psnip_random_secure_init(void* ctx) {
+  (void) ctx;
+
 #if defined(__linux) && defined(SYS_getrandom)
   if (psnip_random__have_getrandom()) {
     psnip_random_secure_generate = &psnip_random_secure_generate_getrandom;
-    return;
+    return 0;
   }
 #endif
 
   if (psnip_random_secure_generate_dev_urandom(0, NULL) == 0) {
     psnip_random_secure_generate = &psnip_random_secure_generate_dev_urandom;
-    return;
+    return 0;
   }
 
   if (psnip_random_secure_generate_dev_random(0, NULL) == 0) {
     psnip_random_secure_generate = &psnip_random_secure_generate_dev_random;
-    return;
+    return 0;
   }
 
 #if defined(PSNIP_RANDOM__SECURE_ALLOW_RDRAND)
   if (psnip_cpu_feature_check(PSNIP_CPU_FEATURE_X86_RDRND)) {
     psnip_random_secure_generate = &psnip_random__rdrand;
-    return;
+    return 0;
   }
 #endif
+
+  return -1;
 }
 #endif
 
@@ -373,9 +383,7 @@ psnip_random_bytes(enum PSnipRandomSource source,
   switch (source) {
     case PSNIP_RANDOM_SOURCE_SECURE:
 #if !defined(PSNIP_RANDOM_SECURE_NO_INIT)
-      psnip_once_call(&psnip_random_secure_once, &psnip_random_secure_init);
-
-      if (psnip_random_secure_generate == NULL)
+      if (psnip_once_fallible_call(&psnip_random_secure_once, &psnip_random_secure_init, NULL) != 0)
 	return -1;
 #endif
 
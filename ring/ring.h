@@ -0,0 +1,317 @@
+/* Lock-free ring buffers (v1)
+ * Portable Snippets - https://github.com/nemequ/portable-snippets
+ * Created by Evan Nemerson <evan@nemerson.com>
+ *
+ *   To the extent possible under law, the authors have waived all
+ *   copyright and related or neighboring rights to this code.  For
+ *   details, see the Creative Commons Zero 1.0 Universal license at
+ *   https://creativecommons.org/publicdomain/zero/1.0/
+ *
+ * Bounded queues of void* for passing work between threads without
+ * locks.  There are two flavors:
+ *
+ *   struct PsnipRingSPSC: exactly one producer thread and one consumer
+ *     thread.  Each side only writes its own index and keeps a cached
+ *     copy of the other one, so in the common case an operation
+ *     touches no cache line the other thread is writing to.
+ *
+ *   struct PsnipRingMPMC: any number of producers and consumers.  This
+ *     is Dmitry Vyukov's bounded MPMC queue; each cell carries a
+ *     sequence number which says whether it is ready to be written or
+ *     read on the current lap, so producers and consumers only contend
+ *     on a CAS of their own index.
+ *
+ * Neither allocates; you supply storage for capacity elements
+ * (capacity must be a power of two), and the queue can hold all of
+ * them.  Enqueueing to a full queue or dequeueing from an empty one
+ * fails immediately instead of blocking, so you can decide whether to
+ * spin, yield, or sleep.
+ *
+ * The batch functions move up to count items with a single update of
+ * the shared index, which is what makes high message rates possible;
+ * they return how many items were actually moved, which may be fewer
+ * than requested (including zero).
+ *
+ * The indices are padded out to PSNIP_CACHE_LINE_SIZE (from cpu.h) so
+ * the producer and consumer don't false-share; you may want to align
+ * the queue itself with PSNIP_CACHE_LINE_ALIGNED too.
+ */
+
+#if !defined(PSNIP_RING_H)
+#define PSNIP_RING_H
+
+#if !defined(PSNIP_ATOMIC_H)
+#  include "../atomic/atomic.h"
+#endif
+#if !defined(PSNIP_CPU__H)
+#  include "../cpu/cpu.h"
+#endif
+
+#include <stddef.h>
+
+#if defined(PSNIP_ATOMIC_NOT_FOUND)
+#  error ring.h requires atomic operations
+#endif
+
+#if !defined(PSNIP_RING_STATIC_INLINE)
+#  if defined(__GNUC__)
+#    define PSNIP_RING__COMPILER_ATTRIBUTES __attribute__((__unused__))
+#  else
+#    define PSNIP_RING__COMPILER_ATTRIBUTES
+#  endif
+
+#  if defined(HEDLEY_INLINE)
+#    define PSNIP_RING__INLINE HEDLEY_INLINE
+#  elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#    define PSNIP_RING__INLINE inline
+#  elif defined(__GNUC_STDC_INLINE__)
+#    define PSNIP_RING__INLINE __inline__
+#  elif defined(_MSC_VER) && _MSC_VER >= 1200
+#    define PSNIP_RING__INLINE __inline
+#  else
+#    define PSNIP_RING__INLINE
+#  endif
+
+#  define PSNIP_RING__FUNCTION PSNIP_RING__COMPILER_ATTRIBUTES static PSNIP_RING__INLINE
+#endif
+
+/* Single producer, single consumer. */
+
+struct PsnipRingSPSC {
+  char pad0[PSNIP_CACHE_LINE_SIZE];
+
+  void** buffer;
+  psnip_int64_t mask;
+  char pad1[PSNIP_CACHE_LINE_SIZE];
+
+  /* Written by the producer. */
+  psnip_atomic_int64 tail;
+  psnip_int64_t cached_head;
+  char pad2[PSNIP_CACHE_LINE_SIZE];
+
+  /* Written by the consumer. */
+  psnip_atomic_int64 head;
+  psnip_int64_t cached_tail;
+  char pad3[PSNIP_CACHE_LINE_SIZE];
+};
+
+/* Returns 0 on success, or -1 if capacity isn't a power of two. */
+PSNIP_RING__FUNCTION
+int
+psnip_ring_spsc_init (struct PsnipRingSPSC* ring, void** buffer, size_t capacity) {
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+    return -1;
+
+  ring->buffer = buffer;
+  ring->mask = (psnip_int64_t) (capacity - 1);
+  psnip_atomic_int64_store (&(ring->tail), 0);
+  ring->cached_head = 0;
+  psnip_atomic_int64_store (&(ring->head), 0);
+  ring->cached_tail = 0;
+
+  return 0;
+}
+
+/* Producer only. */
+PSNIP_RING__FUNCTION
+size_t
+psnip_ring_spsc_enqueue_batch (struct PsnipRingSPSC* ring, void* const* items, size_t count) {
+  const psnip_int64_t tail = psnip_atomic_int64_load_explicit (&(ring->tail), PSNIP_ATOMIC_ORDER_RELAXED);
+  psnip_int64_t space = (ring->mask + 1) - (tail - ring->cached_head);
+  size_t i;
+
+  if ((size_t) space < count) {
+    ring->cached_head = psnip_atomic_int64_load_explicit (&(ring->head), PSNIP_ATOMIC_ORDER_ACQUIRE);
+    space = (ring->mask + 1) - (tail - ring->cached_head);
+    if ((size_t) space < count)
+      count = (size_t) space;
+  }
+
+  for (i = 0 ; i < count ; i++)
+    ring->buffer[(tail + (psnip_int64_t) i) & ring->mask] = items[i];
+
+  if (count != 0)
+    psnip_atomic_int64_store_explicit (&(ring->tail), tail + (psnip_int64_t) count, PSNIP_ATOMIC_ORDER_RELEASE);
+
+  return count;
+}
+
+/* Consumer only. */
+PSNIP_RING__FUNCTION
+size_t
+psnip_ring_spsc_dequeue_batch (struct PsnipRingSPSC* ring, void** items, size_t count) {
+  const psnip_int64_t head = psnip_atomic_int64_load_explicit (&(ring->head), PSNIP_ATOMIC_ORDER_RELAXED);
+  psnip_int64_t available = ring->cached_tail - head;
+  size_t i;
+
+  if ((size_t) available < count) {
+    ring->cached_tail = psnip_atomic_int64_load_explicit (&(ring->tail), PSNIP_ATOMIC_ORDER_ACQUIRE);
+    available = ring->cached_tail - head;
+    if ((size_t) available < count)
+      count = (size_t) available;
+  }
+
+  for (i = 0 ; i < count ; i++)
+    items[i] = ring->buffer[(head + (psnip_int64_t) i) & ring->mask];
+
+  if (count != 0)
+    psnip_atomic_int64_store_explicit (&(ring->head), head + (psnip_int64_t) count, PSNIP_ATOMIC_ORDER_RELEASE);
+
+  return count;
+}
+
+/* Returns 1 on success, 0 if the queue is full. */
+PSNIP_RING__FUNCTION
+int
+psnip_ring_spsc_enqueue (struct PsnipRingSPSC* ring, void* item) {
+  return (int) psnip_ring_spsc_enqueue_batch (ring, &item, 1);
+}
+
+/* Returns 1 on success, 0 if the queue is empty. */
+PSNIP_RING__FUNCTION
+int
+psnip_ring_spsc_dequeue (struct PsnipRingSPSC* ring, void** item) {
+  return (int) psnip_ring_spsc_dequeue_batch (ring, item, 1);
+}
+
+/* Only a snapshot, since the other thread may be changing it. */
+PSNIP_RING__FUNCTION
+size_t
+psnip_ring_spsc_size (struct PsnipRingSPSC* ring) {
+  const psnip_int64_t head = psnip_atomic_int64_load_explicit (&(ring->head), PSNIP_ATOMIC_ORDER_ACQUIRE);
+  const psnip_int64_t tail = psnip_atomic_int64_load_explicit (&(ring->tail), PSNIP_ATOMIC_ORDER_ACQUIRE);
+  return (tail > head) ? (size_t) (tail - head) : 0;
+}
+
+/* Multiple producers, multiple consumers. */
+
+struct PsnipRingMPMCCell {
+  psnip_atomic_int64 sequence;
+  void* data;
+};
+
+struct PsnipRingMPMC {
+  char pad0[PSNIP_CACHE_LINE_SIZE];
+
+  struct PsnipRingMPMCCell* cells;
+  psnip_int64_t mask;
+  char pad1[PSNIP_CACHE_LINE_SIZE];
+
+  psnip_atomic_int64 enqueue_pos;
+  char pad2[PSNIP_CACHE_LINE_SIZE];
+
+  psnip_atomic_int64 dequeue_pos;
+  char pad3[PSNIP_CACHE_LINE_SIZE];
+};
+
+/* Returns 0 on success, or -1 if capacity isn't a power of two. */
+PSNIP_RING__FUNCTION
+int
+psnip_ring_mpmc_init (struct PsnipRingMPMC* ring, struct PsnipRingMPMCCell* cells, size_t capacity) {
+  size_t i;
+
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+    return -1;
+
+  for (i = 0 ; i < capacity ; i++) {
+    psnip_atomic_int64_store_explicit (&(cells[i].sequence), (psnip_int64_t) i, PSNIP_ATOMIC_ORDER_RELAXED);
+    cells[i].data = NULL;
+  }
+
+  ring->cells = cells;
+  ring->mask = (psnip_int64_t) (capacity - 1);
+  psnip_atomic_int64_store (&(ring->enqueue_pos), 0);
+  psnip_atomic_int64_store (&(ring->dequeue_pos), 0);
+
+  return 0;
+}
+
+/* Claim up to count consecutive cells starting at *pos.  A cell is
+ * ready once its sequence is pos + offset, where offset is 0 for
+ * producers and 1 for consumers.  Returns the number of cells
+ * claimed (with *pos set to the first one), or 0 if the first cell
+ * isn't ready, meaning the queue is full (or empty, respectively). */
+PSNIP_RING__FUNCTION
+size_t
+psnip_ring_mpmc__claim (struct PsnipRingMPMC* ring, psnip_atomic_int64* index, psnip_int64_t offset, psnip_int64_t* pos, size_t count) {
+  psnip_int64_t p = psnip_atomic_int64_load_explicit (index, PSNIP_ATOMIC_ORDER_RELAXED);
+  psnip_int64_t seq, dif = 0;
+  size_t n;
+
+  for (;;) {
+    for (n = 0 ; n < count ; n++) {
+      seq = psnip_atomic_int64_load_explicit (&(ring->cells[(p + (psnip_int64_t) n) & ring->mask].sequence), PSNIP_ATOMIC_ORDER_ACQUIRE);
+      dif = seq - (p + (psnip_int64_t) n + offset);
+      if (dif != 0)
+        break;
+    }
+
+    if (n == 0) {
+      if (dif < 0)
+        return 0;
+
+      /* Another thread got this one first; catch up and retry. */
+      p = psnip_atomic_int64_load_explicit (index, PSNIP_ATOMIC_ORDER_RELAXED);
+    } else if (psnip_atomic_int64_compare_exchange_explicit (index, &p, p + (psnip_int64_t) n, PSNIP_ATOMIC_ORDER_RELAXED, PSNIP_ATOMIC_ORDER_RELAXED)) {
+      *pos = p;
+      return n;
+    }
+  }
+}
+
+PSNIP_RING__FUNCTION
+size_t
+psnip_ring_mpmc_enqueue_batch (struct PsnipRingMPMC* ring, void* const* items, size_t count) {
+  psnip_int64_t pos = 0;
+  struct PsnipRingMPMCCell* cell;
+  size_t i;
+
+  if (count == 0)
+    return 0;
+
+  count = psnip_ring_mpmc__claim (ring, &(ring->enqueue_pos), 0, &pos, count);
+  for (i = 0 ; i < count ; i++) {
+    cell = &(ring->cells[(pos + (psnip_int64_t) i) & ring->mask]);
+    cell->data = items[i];
+    psnip_atomic_int64_store_explicit (&(cell->sequence), pos + (psnip_int64_t) i + 1, PSNIP_ATOMIC_ORDER_RELEASE);
+  }
+
+  return count;
+}
+
+PSNIP_RING__FUNCTION
+size_t
+psnip_ring_mpmc_dequeue_batch (struct PsnipRingMPMC* ring, void** items, size_t count) {
+  psnip_int64_t pos = 0;
+  struct PsnipRingMPMCCell* cell;
+  size_t i;
+
+  if (count == 0)
+    return 0;
+
+  count = psnip_ring_mpmc__claim (ring, &(ring->dequeue_pos), 1, &pos, count);
+  for (i = 0 ; i < count ; i++) {
+    cell = &(ring->cells[(pos + (psnip_int64_t) i) & ring->mask]);
+    items[i] = cell->data;
+    /* Ready for the producers' next lap. */
+    psnip_atomic_int64_store_explicit (&(cell->sequence), pos + (psnip_int64_t) i + ring->mask + 1, PSNIP_ATOMIC_ORDER_RELEASE);
+  }
+
+  return count;
+}
+
+/* Returns 1 on success, 0 if the queue is full. */
+PSNIP_RING__FUNCTION
+int
+psnip_ring_mpmc_enqueue (struct PsnipRingMPMC* ring, void* item) {
+  return (int) psnip_ring_mpmc_enqueue_batch (ring, &item, 1);
+}
+
+/* Returns 1 on success, 0 if the queue is empty. */
+PSNIP_RING__FUNCTION
+int
+psnip_ring_mpmc_dequeue (struct PsnipRingMPMC* ring, void** item) {
+  return (int) psnip_ring_mpmc_dequeue_batch (ring, item, 1);
+}
+
+#endif /* !defined(PSNIP_RING_H) */
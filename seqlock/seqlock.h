@@ -0,0 +1,158 @@
+/* Sequence Locks (v1)
+ * Portable Snippets - https://github.com/nemequ/portable-snippets
+ * Created by Evan Nemerson <evan@nemerson.com>
+ *
+ *   To the extent possible under law, the authors have waived all
+ *   copyright and related or neighboring rights to this code.  For
+ *   details, see the Creative Commons Zero 1.0 Universal license at
+ *   https://creativecommons.org/publicdomain/zero/1.0/
+ *
+ * A seqlock protects data which is read often and written rarely.
+ * Readers never write to shared memory (so they don't contend with
+ * each other at all, unlike with a reader-writer lock); instead they
+ * read a sequence number before and after copying the data, and try
+ * again if a write overlapped:
+ *
+ *   struct Config copy;
+ *   psnip_int64_t seq;
+ *   do {
+ *     seq = psnip_seqlock_read_begin (&lock);
+ *     copy = shared_config;
+ *   } while (psnip_seqlock_read_retry (&lock, seq));
+ *
+ * psnip_seqlock_read and psnip_seqlock_write wrap that up for a
+ * memcpy.  The sequence is odd while a write is in progress.  Writers
+ * are serialized by a CAS on the sequence, so there may be several,
+ * but if they are frequent readers can starve.
+ *
+ * Readers may see torn data inside the loop; they mustn't act on it
+ * (follow pointers, divide, etc.) until read_retry says it was
+ * consistent.  Strictly speaking the racing reads are a data race as
+ * far as C11 is concerned, but the fences here keep the compiler and
+ * CPU from moving them outside the sequence checks, which is what
+ * every seqlock in practice (including Linux's) relies on.
+ */
+
+#if !defined(PSNIP_SEQLOCK_H)
+#define PSNIP_SEQLOCK_H
+
+#if !defined(PSNIP_ATOMIC_H)
+#  include "../atomic/atomic.h"
+#endif
+#if !defined(PSNIP_CPU_PAUSE_H)
+#  include "../cpu/pause.h"
+#endif
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(PSNIP_ATOMIC_NOT_FOUND)
+#  error seqlock.h requires atomic operations
+#endif
+
+#if !defined(PSNIP_SEQLOCK_STATIC_INLINE)
+#  if defined(__GNUC__)
+#    define PSNIP_SEQLOCK__COMPILER_ATTRIBUTES __attribute__((__unused__))
+#  else
+#    define PSNIP_SEQLOCK__COMPILER_ATTRIBUTES
+#  endif
+
+#  if defined(HEDLEY_INLINE)
+#    define PSNIP_SEQLOCK__INLINE HEDLEY_INLINE
+#  elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#    define PSNIP_SEQLOCK__INLINE inline
+#  elif defined(__GNUC_STDC_INLINE__)
+#    define PSNIP_SEQLOCK__INLINE __inline__
+#  elif defined(_MSC_VER) && _MSC_VER >= 1200
+#    define PSNIP_SEQLOCK__INLINE __inline
+#  else
+#    define PSNIP_SEQLOCK__INLINE
+#  endif
+
+#  define PSNIP_SEQLOCK__FUNCTION PSNIP_SEQLOCK__COMPILER_ATTRIBUTES static PSNIP_SEQLOCK__INLINE
+#endif
+
+struct PsnipSeqlock {
+  psnip_atomic_int64 sequence;
+};
+
+PSNIP_SEQLOCK__FUNCTION
+void
+psnip_seqlock_init (struct PsnipSeqlock* lock) {
+  psnip_atomic_int64_store (&(lock->sequence), 0);
+}
+
+/* Returns the sequence number to pass to psnip_seqlock_read_retry,
+ * waiting for any write in progress to finish first. */
+PSNIP_SEQLOCK__FUNCTION
+psnip_int64_t
+psnip_seqlock_read_begin (struct PsnipSeqlock* lock) {
+  psnip_int64_t seq;
+
+  while (((seq = psnip_atomic_int64_load_explicit (&(lock->sequence), PSNIP_ATOMIC_ORDER_ACQUIRE)) & 1) != 0)
+    PSNIP_CPU_PAUSE();
+
+  return seq;
+}
+
+/* Returns non-zero if a write happened since psnip_seqlock_read_begin
+ * returned start, in which case the data must be read again. */
+PSNIP_SEQLOCK__FUNCTION
+int
+psnip_seqlock_read_retry (struct PsnipSeqlock* lock, psnip_int64_t start) {
+  /* Keeps the data reads from moving below the second load of the
+   * sequence; an acquire load wouldn't, since it only orders what
+   * comes after it. */
+  psnip_atomic_fence_explicit (PSNIP_ATOMIC_ORDER_ACQUIRE);
+  return psnip_atomic_int64_load_explicit (&(lock->sequence), PSNIP_ATOMIC_ORDER_RELAXED) != start;
+}
+
+PSNIP_SEQLOCK__FUNCTION
+void
+psnip_seqlock_write_begin (struct PsnipSeqlock* lock) {
+  psnip_int64_t seq = psnip_atomic_int64_load_explicit (&(lock->sequence), PSNIP_ATOMIC_ORDER_RELAXED);
+
+  for (;;) {
+    if ((seq & 1) == 0 &&
+        psnip_atomic_int64_compare_exchange_explicit (&(lock->sequence), &seq, seq + 1,
+                                                      PSNIP_ATOMIC_ORDER_ACQUIRE, PSNIP_ATOMIC_ORDER_RELAXED))
+      break;
+
+    PSNIP_CPU_PAUSE();
+    seq = psnip_atomic_int64_load_explicit (&(lock->sequence), PSNIP_ATOMIC_ORDER_RELAXED);
+  }
+
+  /* Readers must see the odd sequence before any of the new data. */
+  psnip_atomic_fence_explicit (PSNIP_ATOMIC_ORDER_RELEASE);
+}
+
+PSNIP_SEQLOCK__FUNCTION
+void
+psnip_seqlock_write_end (struct PsnipSeqlock* lock) {
+  const psnip_int64_t seq = psnip_atomic_int64_load_explicit (&(lock->sequence), PSNIP_ATOMIC_ORDER_RELAXED);
+  psnip_atomic_int64_store_explicit (&(lock->sequence), seq + 1, PSNIP_ATOMIC_ORDER_RELEASE);
+}
+
+/* Copy size bytes from src (protected by lock) to dest, retrying
+ * until the copy is consistent. */
+PSNIP_SEQLOCK__FUNCTION
+void
+psnip_seqlock_read (struct PsnipSeqlock* lock, void* dest, const void* src, size_t size) {
+  psnip_int64_t seq;
+
+  do {
+    seq = psnip_seqlock_read_begin (lock);
+    memcpy (dest, src, size);
+  } while (psnip_seqlock_read_retry (lock, seq));
+}
+
+/* Copy size bytes from src to dest (protected by lock). */
+PSNIP_SEQLOCK__FUNCTION
+void
+psnip_seqlock_write (struct PsnipSeqlock* lock, void* dest, const void* src, size_t size) {
+  psnip_seqlock_write_begin (lock);
+  memcpy (dest, src, size);
+  psnip_seqlock_write_end (lock);
+}
+
+#endif /* !defined(PSNIP_SEQLOCK_H) */
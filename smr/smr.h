@@ -0,0 +1,362 @@
+/* Safe Memory Reclamation (v1)
+ * Portable Snippets - https://github.com/nemequ/portable-snippets
+ * Created by Evan Nemerson <evan@nemerson.com>
+ *
+ *   To the extent possible under law, the authors have waived all
+ *   copyright and related or neighboring rights to this code.  For
+ *   details, see the Creative Commons Zero 1.0 Universal license at
+ *   https://creativecommons.org/publicdomain/zero/1.0/
+ *
+ * When a node is removed from a lock-free structure, other threads may
+ * still be reading it, so it can't be freed right away.  This module
+ * tells you when it can, using epoch-based reclamation (EBR), with
+ * optional hazard pointers for references which have to outlive a
+ * critical section.
+ *
+ * Each thread which touches the structure needs a struct
+ * PsnipSmrThread registered with a struct PsnipSmrDomain.  Readers
+ * bracket their accesses with psnip_smr_enter and psnip_smr_exit;
+ * writers unlink a node and pass it to psnip_smr_retire, which frees
+ * it (by calling your function) once every thread which might have
+ * seen it has left its critical section:
+ *
+ *   psnip_smr_enter (thread);
+ *   for (node = psnip_atomic_ptr_load (&list->head) ; node != NULL ; ...)
+ *     ...
+ *   psnip_smr_exit (thread);
+ *
+ *   ... unlink old ...
+ *   psnip_smr_retire (thread, &(old->smr), old, free);
+ *
+ * The domain keeps a global epoch.  Entering a critical section
+ * records the current epoch in the thread's record (a relaxed store
+ * and a fence), and the epoch only advances once every thread inside a
+ * critical section has seen the current one.  A node retired in epoch
+ * e is unreachable by the time the epoch reaches e + 2, so it can be
+ * freed then.  Retired nodes are kept on a per-thread list and
+ * collected in batches of PSNIP_SMR_BATCH, so the cost of scanning the
+ * other threads is amortized.
+ *
+ * The catch with EBR is that one thread stuck in a critical section
+ * stops all reclamation.  If you need to hold on to a node for a long
+ * time, protect it with a hazard pointer instead (psnip_smr_protect);
+ * a node in any thread's hazard slot is never freed, whatever the
+ * epoch.  Each record has PSNIP_SMR_HAZARDS slots.
+ *
+ * Nodes are intrusive: embed a struct PsnipSmrNode in the objects you
+ * retire, so nothing is allocated.  Records are supplied by the caller
+ * too, and are never unlinked from the domain; when a thread exits
+ * call psnip_smr_unregister, and a new thread can pick the record up
+ * again with psnip_smr_recycle.
+ */
+
+#if !defined(PSNIP_SMR_H)
+#define PSNIP_SMR_H
+
+#if !defined(PSNIP_ATOMIC_H)
+#  include "../atomic/atomic.h"
+#endif
+#if !defined(PSNIP_CPU__H)
+#  include "../cpu/cpu.h"
+#endif
+
+#include <stddef.h>
+
+#if defined(PSNIP_ATOMIC_NOT_FOUND)
+#  error smr.h requires atomic operations
+#endif
+
+#if !defined(PSNIP_SMR_STATIC_INLINE)
+#  if defined(__GNUC__)
+#    define PSNIP_SMR__COMPILER_ATTRIBUTES __attribute__((__unused__))
+#  else
+#    define PSNIP_SMR__COMPILER_ATTRIBUTES
+#  endif
+
+#  if defined(HEDLEY_INLINE)
+#    define PSNIP_SMR__INLINE HEDLEY_INLINE
+#  elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#    define PSNIP_SMR__INLINE inline
+#  elif defined(__GNUC_STDC_INLINE__)
+#    define PSNIP_SMR__INLINE __inline__
+#  elif defined(_MSC_VER) && _MSC_VER >= 1200
+#    define PSNIP_SMR__INLINE __inline
+#  else
+#    define PSNIP_SMR__INLINE
+#  endif
+
+#  define PSNIP_SMR__FUNCTION PSNIP_SMR__COMPILER_ATTRIBUTES static PSNIP_SMR__INLINE
+#endif
+
+/* How many retired nodes a thread accumulates before it tries to free
+ * some. */
+#if !defined(PSNIP_SMR_BATCH)
+#  define PSNIP_SMR_BATCH 64
+#endif
+
+#if !defined(PSNIP_SMR_HAZARDS)
+#  define PSNIP_SMR_HAZARDS 2
+#endif
+
+struct PsnipSmrNode {
+  struct PsnipSmrNode* next;
+  void* ptr;
+  void (* free_func) (void* ptr);
+  psnip_int64_t epoch;
+};
+
+struct PsnipSmrDomain {
+  psnip_atomic_int64 epoch;
+  char pad[PSNIP_CACHE_LINE_SIZE - sizeof(psnip_atomic_int64)];
+  /* struct PsnipSmrThread*; records are only ever pushed. */
+  psnip_atomic_ptr threads;
+};
+
+struct PsnipSmrThread {
+  /* (epoch << 1) | 1 inside a critical section, 0 outside. */
+  psnip_atomic_int64 state;
+  psnip_atomic_ptr hazards[PSNIP_SMR_HAZARDS];
+  psnip_atomic_int32 in_use;
+
+  /* Never changes once the record is registered. */
+  struct PsnipSmrThread* next;
+
+  /* Only touched by the owning thread. */
+  struct PsnipSmrDomain* domain;
+  struct PsnipSmrNode* retired;
+  size_t retired_count;
+  unsigned int depth;
+
+  char pad[PSNIP_CACHE_LINE_SIZE];
+};
+
+PSNIP_SMR__FUNCTION
+void
+psnip_smr_domain_init (struct PsnipSmrDomain* domain) {
+  psnip_atomic_int64_store (&(domain->epoch), 0);
+  psnip_atomic_ptr_store (&(domain->threads), NULL);
+}
+
+/* Add a record to the domain.  The record's memory must remain valid
+ * until the domain is no longer used. */
+PSNIP_SMR__FUNCTION
+void
+psnip_smr_register (struct PsnipSmrDomain* domain, struct PsnipSmrThread* thread) {
+  void* head;
+  size_t i;
+
+  psnip_atomic_int64_store (&(thread->state), 0);
+  for (i = 0 ; i < PSNIP_SMR_HAZARDS ; i++)
+    psnip_atomic_ptr_store (&(thread->hazards[i]), NULL);
+  psnip_atomic_int32_store (&(thread->in_use), 1);
+  thread->domain = domain;
+  thread->retired = NULL;
+  thread->retired_count = 0;
+  thread->depth = 0;
+
+  head = psnip_atomic_ptr_load_explicit (&(domain->threads), PSNIP_ATOMIC_ORDER_RELAXED);
+  do {
+    thread->next = (struct PsnipSmrThread*) head;
+  } while (!psnip_atomic_ptr_compare_exchange_explicit (&(domain->threads), &head, thread,
+                                                       PSNIP_ATOMIC_ORDER_RELEASE, PSNIP_ATOMIC_ORDER_RELAXED));
+}
+
+/* Claim a record which was previously unregistered, or NULL if there
+ * isn't one.  Any nodes it was still holding come with it. */
+PSNIP_SMR__FUNCTION
+struct PsnipSmrThread*
+psnip_smr_recycle (struct PsnipSmrDomain* domain) {
+  struct PsnipSmrThread* thread;
+  psnip_int32_t expected;
+
+  for (thread = (struct PsnipSmrThread*) psnip_atomic_ptr_load_explicit (&(domain->threads), PSNIP_ATOMIC_ORDER_ACQUIRE) ;
+       thread != NULL ;
+       thread = thread->next) {
+    expected = 0;
+    if (psnip_atomic_int32_load_explicit (&(thread->in_use), PSNIP_ATOMIC_ORDER_RELAXED) == 0 &&
+        psnip_atomic_int32_compare_exchange_explicit (&(thread->in_use), &expected, 1,
+                                                      PSNIP_ATOMIC_ORDER_ACQUIRE, PSNIP_ATOMIC_ORDER_RELAXED))
+      return thread;
+  }
+
+  return NULL;
+}
+
+/* Enter a critical section; until the matching psnip_smr_exit, no node
+ * which was reachable when you entered will be freed.  Critical
+ * sections may be nested. */
+PSNIP_SMR__FUNCTION
+void
+psnip_smr_enter (struct PsnipSmrThread* thread) {
+  if (thread->depth++ != 0)
+    return;
+
+  psnip_atomic_int64_store_explicit (&(thread->state),
+                                     (psnip_atomic_int64_load_explicit (&(thread->domain->epoch), PSNIP_ATOMIC_ORDER_RELAXED) << 1) | 1,
+                                     PSNIP_ATOMIC_ORDER_RELAXED);
+  /* The store has to be visible before we read any shared pointers;
+   * that's a store-load ordering, which only a full fence provides.
+   * It pairs with the fence in psnip_smr__try_advance. */
+  psnip_atomic_fence_explicit (PSNIP_ATOMIC_ORDER_SEQ_CST);
+}
+
+PSNIP_SMR__FUNCTION
+void
+psnip_smr_exit (struct PsnipSmrThread* thread) {
+  if (--thread->depth != 0)
+    return;
+
+  psnip_atomic_int64_store_explicit (&(thread->state), 0, PSNIP_ATOMIC_ORDER_RELEASE);
+}
+
+/* Load *source and protect the result with hazard slot, retrying
+ * until the pointer we published is still the one in source.  The
+ * object stays valid until the slot is cleared or reused, even
+ * outside of a critical section. */
+PSNIP_SMR__FUNCTION
+void*
+psnip_smr_protect (struct PsnipSmrThread* thread, unsigned int slot, psnip_atomic_ptr* source) {
+  void* ptr = psnip_atomic_ptr_load_explicit (source, PSNIP_ATOMIC_ORDER_ACQUIRE);
+  void* check;
+
+  for (;;) {
+    psnip_atomic_ptr_store_explicit (&(thread->hazards[slot]), ptr, PSNIP_ATOMIC_ORDER_RELAXED);
+    psnip_atomic_fence_explicit (PSNIP_ATOMIC_ORDER_SEQ_CST);
+    check = psnip_atomic_ptr_load_explicit (source, PSNIP_ATOMIC_ORDER_ACQUIRE);
+    if (check == ptr)
+      return ptr;
+    ptr = check;
+  }
+}
+
+PSNIP_SMR__FUNCTION
+void
+psnip_smr_clear (struct PsnipSmrThread* thread, unsigned int slot) {
+  psnip_atomic_ptr_store_explicit (&(thread->hazards[slot]), NULL, PSNIP_ATOMIC_ORDER_RELEASE);
+}
+
+/* Advance the global epoch if every thread in a critical section has
+ * seen the current one, and return the (possibly new) epoch. */
+PSNIP_SMR__FUNCTION
+psnip_int64_t
+psnip_smr__try_advance (struct PsnipSmrDomain* domain) {
+  psnip_int64_t epoch, state;
+  struct PsnipSmrThread* thread;
+
+  psnip_atomic_fence_explicit (PSNIP_ATOMIC_ORDER_SEQ_CST);
+  epoch = psnip_atomic_int64_load_explicit (&(domain->epoch), PSNIP_ATOMIC_ORDER_ACQUIRE);
+
+  for (thread = (struct PsnipSmrThread*) psnip_atomic_ptr_load_explicit (&(domain->threads), PSNIP_ATOMIC_ORDER_ACQUIRE) ;
+       thread != NULL ;
+       thread = thread->next) {
+    state = psnip_atomic_int64_load_explicit (&(thread->state), PSNIP_ATOMIC_ORDER_ACQUIRE);
+    if ((state & 1) != 0 && (state >> 1) != epoch)
+      return epoch;
+  }
+
+  /* If this fails someone else advanced it, which is just as good. */
+  if (psnip_atomic_int64_compare_exchange_explicit (&(domain->epoch), &epoch, epoch + 1,
+                                                    PSNIP_ATOMIC_ORDER_ACQ_REL, PSNIP_ATOMIC_ORDER_ACQUIRE))
+    epoch++;
+
+  return epoch;
+}
+
+PSNIP_SMR__FUNCTION
+int
+psnip_smr__hazardous (struct PsnipSmrDomain* domain, void* ptr) {
+  struct PsnipSmrThread* thread;
+  size_t i;
+
+  for (thread = (struct PsnipSmrThread*) psnip_atomic_ptr_load_explicit (&(domain->threads), PSNIP_ATOMIC_ORDER_ACQUIRE) ;
+       thread != NULL ;
+       thread = thread->next) {
+    for (i = 0 ; i < PSNIP_SMR_HAZARDS ; i++) {
+      if (psnip_atomic_ptr_load_explicit (&(thread->hazards[i]), PSNIP_ATOMIC_ORDER_ACQUIRE) == ptr)
+        return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Try to free this thread's retired nodes; returns how many were
+ * freed.  psnip_smr_retire calls this for you every PSNIP_SMR_BATCH
+ * nodes, but you can call it yourself, too.  It's safe inside a
+ * critical section, but since the thread's own state holds back the
+ * epoch it will get more done outside of one. */
+PSNIP_SMR__FUNCTION
+size_t
+psnip_smr_collect (struct PsnipSmrThread* thread) {
+  const psnip_int64_t epoch = psnip_smr__try_advance (thread->domain);
+  struct PsnipSmrNode** link = &(thread->retired);
+  struct PsnipSmrNode* node;
+  size_t freed = 0;
+
+  while ((node = *link) != NULL) {
+    if (node->epoch + 2 <= epoch && !psnip_smr__hazardous (thread->domain, node->ptr)) {
+      *link = node->next;
+      node->free_func (node->ptr);
+      freed++;
+    } else {
+      link = &(node->next);
+    }
+  }
+
+  thread->retired_count -= freed;
+  return freed;
+}
+
+/* Free ptr (by calling free_func (ptr)) once no other thread can be
+ * using it.  It must already be unreachable.  node is storage for the
+ * bookkeeping, usually a member of *ptr. */
+PSNIP_SMR__FUNCTION
+void
+psnip_smr_retire (struct PsnipSmrThread* thread, struct PsnipSmrNode* node, void* ptr, void (* free_func) (void* ptr)) {
+  node->ptr = ptr;
+  node->free_func = free_func;
+  /* The epoch has to be read after the node was unlinked; otherwise a
+   * stale value could let it be freed too early. */
+  psnip_atomic_fence_explicit (PSNIP_ATOMIC_ORDER_SEQ_CST);
+  node->epoch = psnip_atomic_int64_load_explicit (&(thread->domain->epoch), PSNIP_ATOMIC_ORDER_RELAXED);
+  node->next = thread->retired;
+  thread->retired = node;
+
+  if (++thread->retired_count >= PSNIP_SMR_BATCH)
+    psnip_smr_collect (thread);
+}
+
+/* Release a record when its thread is done with the domain.  It must
+ * not be in a critical section.  Nodes which can't be freed yet stay
+ * with the record until it is recycled (or the domain is destroyed). */
+PSNIP_SMR__FUNCTION
+void
+psnip_smr_unregister (struct PsnipSmrThread* thread) {
+  size_t i;
+
+  for (i = 0 ; i < PSNIP_SMR_HAZARDS ; i++)
+    psnip_smr_clear (thread, (unsigned int) i);
+  psnip_smr_collect (thread);
+  psnip_atomic_int32_store_explicit (&(thread->in_use), 0, PSNIP_ATOMIC_ORDER_RELEASE);
+}
+
+/* Free every node still waiting in any record.  Only call this once no
+ * thread is using the domain any more. */
+PSNIP_SMR__FUNCTION
+void
+psnip_smr_domain_destroy (struct PsnipSmrDomain* domain) {
+  struct PsnipSmrThread* thread;
+  struct PsnipSmrNode* node;
+
+  for (thread = (struct PsnipSmrThread*) psnip_atomic_ptr_load (&(domain->threads)) ;
+       thread != NULL ;
+       thread = thread->next) {
+    while ((node = thread->retired) != NULL) {
+      thread->retired = node->next;
+      node->free_func (node->ptr);
+    }
+    thread->retired_count = 0;
+  }
+}
+
+#endif /* !defined(PSNIP_SMR_H) */
@@ -0,0 +1,423 @@
+/* Spinlocks (v1)
+ * Portable Snippets - https://github.com/nemequ/portable-snippets
+ * Created by Evan Nemerson <evan@nemerson.com>
+ *
+ *   To the extent possible under law, the authors have waived all
+ *   copyright and related or neighboring rights to this code.  For
+ *   details, see the Creative Commons Zero 1.0 Universal license at
+ *   https://creativecommons.org/publicdomain/zero/1.0/
+ *
+ * Locks for very short critical sections, where a pthread mutex costs
+ * more than the work it protects.  There are three flavors:
+ *
+ *   struct PsnipSpinlock: test-and-test-and-set.  Waiters spin on a
+ *     plain load (which hits their own cached copy of the line) and
+ *     only try the exchange once the lock looks free, backing off
+ *     exponentially between checks so they don't all stampede at once
+ *     when it is released.  Not fair.
+ *
+ *   struct PsnipSpinlockTicket: a ticket lock.  Threads get the lock in
+ *     the order they asked for it, and the backoff is proportional to
+ *     how far back in line a waiter is.
+ *
+ *   struct PsnipSpinlockMutex: spins briefly, then sleeps with
+ *     psnip_atomic_int32_wait (a futex on Linux, WaitOnAddress on
+ *     Windows).  An uncontended lock and unlock never enter the
+ *     kernel, but a waiter doesn't burn a CPU while the holder is
+ *     descheduled.  You'll need to compile atomic-wait.c, too.
+ *
+ * Spinning waiters execute a CPU pause (x86) or yield (ARM) hint, and
+ * once a waiter has spun for PSNIP_SPINLOCK_YIELD_AFTER pauses it
+ * starts yielding the thread each time around, so an oversubscribed
+ * machine degrades gracefully instead of burning whole time slices.
+ *
+ * None of them allocate; call the init function, or use a
+ * zero-initialized static.  Each lock keeps contention counters which
+ * you can read with the *_stats functions (see struct
+ * PsnipSpinlockStats); define PSNIP_SPINLOCK_NO_STATS to leave them
+ * out.  The counters are only updated by the thread holding the lock,
+ * so they don't add any atomic read-modify-write operations.
+ */
+
+#if !defined(PSNIP_SPINLOCK_H)
+#define PSNIP_SPINLOCK_H
+
+#if !defined(PSNIP_ATOMIC_H)
+#  include "../atomic/atomic.h"
+#endif
+#if !defined(PSNIP_CPU__H)
+#  include "../cpu/cpu.h"
+#endif
+#if !defined(PSNIP_ATOMIC_WAIT_H)
+#  include "../atomic-wait/atomic-wait.h"
+#endif
+
+#if defined(PSNIP_ATOMIC_NOT_FOUND)
+#  error spinlock.h requires atomic operations
+#endif
+
+#if defined(_WIN32)
+#  include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#  include <sched.h>
+#endif
+
+#if !defined(PSNIP_SPINLOCK_STATIC_INLINE)
+#  if defined(__GNUC__)
+#    define PSNIP_SPINLOCK__COMPILER_ATTRIBUTES __attribute__((__unused__))
+#  else
+#    define PSNIP_SPINLOCK__COMPILER_ATTRIBUTES
+#  endif
+
+#  if defined(HEDLEY_INLINE)
+#    define PSNIP_SPINLOCK__INLINE HEDLEY_INLINE
+#  elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#    define PSNIP_SPINLOCK__INLINE inline
+#  elif defined(__GNUC_STDC_INLINE__)
+#    define PSNIP_SPINLOCK__INLINE __inline__
+#  elif defined(_MSC_VER) && _MSC_VER >= 1200
+#    define PSNIP_SPINLOCK__INLINE __inline
+#  else
+#    define PSNIP_SPINLOCK__INLINE
+#  endif
+
+#  define PSNIP_SPINLOCK__FUNCTION PSNIP_SPINLOCK__COMPILER_ATTRIBUTES static PSNIP_SPINLOCK__INLINE
+#endif
+
+/* Longest run of pauses between checks of the lock. */
+#if !defined(PSNIP_SPINLOCK_BACKOFF_MAX)
+#  define PSNIP_SPINLOCK_BACKOFF_MAX 1024
+#endif
+
+/* How many pauses a spinlock or ticket lock waiter executes before it
+ * starts yielding the thread. */
+#if !defined(PSNIP_SPINLOCK_YIELD_AFTER)
+#  define PSNIP_SPINLOCK_YIELD_AFTER 4096
+#endif
+
+/* How many times the mutex checks the lock before going to sleep. */
+#if !defined(PSNIP_SPINLOCK_MUTEX_SPINS)
+#  define PSNIP_SPINLOCK_MUTEX_SPINS 100
+#endif
+
+/* Hint to the CPU that we're busy-waiting; the shared one from cpu.h
+ * unless you define your own. */
+#if !defined(PSNIP_SPINLOCK_PAUSE)
+#  define PSNIP_SPINLOCK_PAUSE() PSNIP_CPU_PAUSE()
+#endif
+
+/* Give up the rest of our time slice. */
+#if defined(_WIN32)
+#  define PSNIP_SPINLOCK__YIELD() ((void) SwitchToThread())
+#elif defined(__unix__) || defined(__APPLE__)
+#  define PSNIP_SPINLOCK__YIELD() ((void) sched_yield())
+#else
+#  define PSNIP_SPINLOCK__YIELD() PSNIP_SPINLOCK_PAUSE()
+#endif
+
+struct PsnipSpinlockStats {
+  /* Number of times the lock was acquired. */
+  psnip_int64_t acquisitions;
+  /* How many of those found the lock already held. */
+  psnip_int64_t contended;
+  /* Pause hints executed while waiting. */
+  psnip_int64_t spins;
+  /* Times a waiter yielded the thread or went to sleep. */
+  psnip_int64_t sleeps;
+};
+
+#if !defined(PSNIP_SPINLOCK_NO_STATS)
+struct PsnipSpinlock__Counters {
+  psnip_atomic_int64 acquisitions;
+  psnip_atomic_int64 contended;
+  psnip_atomic_int64 spins;
+  psnip_atomic_int64 sleeps;
+};
+
+/* Only called by the thread holding the lock, so there is never more
+ * than one writer; the counters are atomic so the stats functions can
+ * read them from other threads. */
+#define PSNIP_SPINLOCK__COUNTER_ADD(counter, n) \
+  psnip_atomic_int64_store_explicit (&(counter), psnip_atomic_int64_load_explicit (&(counter), PSNIP_ATOMIC_ORDER_RELAXED) + (n), PSNIP_ATOMIC_ORDER_RELAXED)
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock__record (struct PsnipSpinlock__Counters* counters, psnip_int64_t spins, psnip_int64_t sleeps) {
+  PSNIP_SPINLOCK__COUNTER_ADD(counters->acquisitions, 1);
+  if (spins != 0 || sleeps != 0) {
+    PSNIP_SPINLOCK__COUNTER_ADD(counters->contended, 1);
+    PSNIP_SPINLOCK__COUNTER_ADD(counters->spins, spins);
+    PSNIP_SPINLOCK__COUNTER_ADD(counters->sleeps, sleeps);
+  }
+}
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock__counters_init (struct PsnipSpinlock__Counters* counters) {
+  psnip_atomic_int64_store (&(counters->acquisitions), 0);
+  psnip_atomic_int64_store (&(counters->contended), 0);
+  psnip_atomic_int64_store (&(counters->spins), 0);
+  psnip_atomic_int64_store (&(counters->sleeps), 0);
+}
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock__counters_get (struct PsnipSpinlock__Counters* counters, struct PsnipSpinlockStats* stats) {
+  stats->acquisitions = psnip_atomic_int64_load_explicit (&(counters->acquisitions), PSNIP_ATOMIC_ORDER_RELAXED);
+  stats->contended = psnip_atomic_int64_load_explicit (&(counters->contended), PSNIP_ATOMIC_ORDER_RELAXED);
+  stats->spins = psnip_atomic_int64_load_explicit (&(counters->spins), PSNIP_ATOMIC_ORDER_RELAXED);
+  stats->sleeps = psnip_atomic_int64_load_explicit (&(counters->sleeps), PSNIP_ATOMIC_ORDER_RELAXED);
+}
+
+#  define PSNIP_SPINLOCK__RECORD(lock, spins, sleeps) psnip_spinlock__record (&((lock)->counters), spins, sleeps)
+#  define PSNIP_SPINLOCK__COUNTERS_INIT(lock) psnip_spinlock__counters_init (&((lock)->counters))
+#  define PSNIP_SPINLOCK__COUNTERS_GET(lock, stats) psnip_spinlock__counters_get (&((lock)->counters), stats)
+#else
+#  define PSNIP_SPINLOCK__RECORD(lock, spins, sleeps) ((void) (spins), (void) (sleeps))
+#  define PSNIP_SPINLOCK__COUNTERS_INIT(lock) ((void) 0)
+#  define PSNIP_SPINLOCK__COUNTERS_GET(lock, stats) \
+  ((void) (lock), \
+   (stats)->acquisitions = 0, (stats)->contended = 0, (stats)->spins = 0, (stats)->sleeps = 0)
+#endif
+
+/* Test-and-test-and-set spinlock. */
+
+struct PsnipSpinlock {
+  psnip_atomic_int32 locked;
+#if !defined(PSNIP_SPINLOCK_NO_STATS)
+  /* Keep the holder's counter updates off the line waiters spin on. */
+  char pad[PSNIP_CACHE_LINE_SIZE - sizeof(psnip_atomic_int32)];
+  PSNIP_CACHE_LINE_ALIGNED struct PsnipSpinlock__Counters counters;
+#endif
+};
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock_init (struct PsnipSpinlock* lock) {
+  psnip_atomic_int32_store (&(lock->locked), 0);
+  PSNIP_SPINLOCK__COUNTERS_INIT(lock);
+}
+
+/* Returns 1 if the lock was acquired, 0 if it is held. */
+PSNIP_SPINLOCK__FUNCTION
+int
+psnip_spinlock_trylock (struct PsnipSpinlock* lock) {
+  if (psnip_atomic_int32_load_explicit (&(lock->locked), PSNIP_ATOMIC_ORDER_RELAXED) != 0 ||
+      psnip_atomic_int32_exchange_explicit (&(lock->locked), 1, PSNIP_ATOMIC_ORDER_ACQUIRE) != 0)
+    return 0;
+
+  PSNIP_SPINLOCK__RECORD(lock, 0, 0);
+  return 1;
+}
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock_lock (struct PsnipSpinlock* lock) {
+  psnip_int64_t spins = 0, sleeps = 0;
+  psnip_int64_t backoff = 1, i;
+
+  while (psnip_atomic_int32_exchange_explicit (&(lock->locked), 1, PSNIP_ATOMIC_ORDER_ACQUIRE) != 0) {
+    /* Don't try the exchange again until the lock looks free; the
+     * loads are served from our own cache, so we aren't stealing the
+     * line from the holder. */
+    do {
+      if (spins >= PSNIP_SPINLOCK_YIELD_AFTER) {
+        PSNIP_SPINLOCK__YIELD();
+        sleeps++;
+      } else {
+        for (i = 0 ; i < backoff ; i++)
+          PSNIP_SPINLOCK_PAUSE();
+        spins += backoff;
+        if (backoff < PSNIP_SPINLOCK_BACKOFF_MAX)
+          backoff *= 2;
+      }
+    } while (psnip_atomic_int32_load_explicit (&(lock->locked), PSNIP_ATOMIC_ORDER_RELAXED) != 0);
+  }
+
+  PSNIP_SPINLOCK__RECORD(lock, spins, sleeps);
+}
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock_unlock (struct PsnipSpinlock* lock) {
+  psnip_atomic_int32_store_explicit (&(lock->locked), 0, PSNIP_ATOMIC_ORDER_RELEASE);
+}
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock_stats (struct PsnipSpinlock* lock, struct PsnipSpinlockStats* stats) {
+  PSNIP_SPINLOCK__COUNTERS_GET(lock, stats);
+}
+
+/* Ticket lock. */
+
+struct PsnipSpinlockTicket {
+  psnip_atomic_int32 next;
+  psnip_atomic_int32 serving;
+#if !defined(PSNIP_SPINLOCK_NO_STATS)
+  char pad[PSNIP_CACHE_LINE_SIZE - (sizeof(psnip_atomic_int32) * 2)];
+  PSNIP_CACHE_LINE_ALIGNED struct PsnipSpinlock__Counters counters;
+#endif
+};
+
+/* The tickets wrap around; only the distance between them matters. */
+#define PSNIP_SPINLOCK__TICKET_DISTANCE(ticket, serving) \
+  ((psnip_int64_t) (((psnip_uint64_t) (ticket) - (psnip_uint64_t) (serving)) & 0xffffffffU))
+#define PSNIP_SPINLOCK__TICKET_NEXT(ticket) \
+  ((psnip_int32_t) (((psnip_uint64_t) (ticket) + 1) & 0xffffffffU))
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock_ticket_init (struct PsnipSpinlockTicket* lock) {
+  psnip_atomic_int32_store (&(lock->next), 0);
+  psnip_atomic_int32_store (&(lock->serving), 0);
+  PSNIP_SPINLOCK__COUNTERS_INIT(lock);
+}
+
+/* Returns 1 if the lock was acquired, 0 if it is held. */
+PSNIP_SPINLOCK__FUNCTION
+int
+psnip_spinlock_ticket_trylock (struct PsnipSpinlockTicket* lock) {
+  const psnip_int32_t serving = psnip_atomic_int32_load_explicit (&(lock->serving), PSNIP_ATOMIC_ORDER_ACQUIRE);
+  psnip_int32_t expected = serving;
+
+  /* Only take a ticket if it would be served immediately. */
+  if (!psnip_atomic_int32_compare_exchange_explicit (&(lock->next), &expected, PSNIP_SPINLOCK__TICKET_NEXT(serving),
+                                                     PSNIP_ATOMIC_ORDER_ACQUIRE, PSNIP_ATOMIC_ORDER_RELAXED))
+    return 0;
+
+  PSNIP_SPINLOCK__RECORD(lock, 0, 0);
+  return 1;
+}
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock_ticket_lock (struct PsnipSpinlockTicket* lock) {
+  const psnip_int32_t ticket = psnip_atomic_int32_fetch_add_explicit (&(lock->next), 1, PSNIP_ATOMIC_ORDER_RELAXED);
+  psnip_int64_t spins = 0, sleeps = 0;
+  psnip_int64_t distance, i;
+  psnip_int32_t serving;
+
+  while ((serving = psnip_atomic_int32_load_explicit (&(lock->serving), PSNIP_ATOMIC_ORDER_ACQUIRE)) != ticket) {
+    if (spins >= PSNIP_SPINLOCK_YIELD_AFTER) {
+      PSNIP_SPINLOCK__YIELD();
+      sleeps++;
+    } else {
+      /* Everyone ahead of us has to finish first, so wait longer the
+       * further back in line we are. */
+      distance = PSNIP_SPINLOCK__TICKET_DISTANCE(ticket, serving);
+      if (distance > PSNIP_SPINLOCK_BACKOFF_MAX)
+        distance = PSNIP_SPINLOCK_BACKOFF_MAX;
+      for (i = 0 ; i < distance ; i++)
+        PSNIP_SPINLOCK_PAUSE();
+      spins += distance;
+    }
+  }
+
+  PSNIP_SPINLOCK__RECORD(lock, spins, sleeps);
+}
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock_ticket_unlock (struct PsnipSpinlockTicket* lock) {
+  /* Only the holder writes serving, so this doesn't need to be a
+   * read-modify-write. */
+  const psnip_int32_t serving = psnip_atomic_int32_load_explicit (&(lock->serving), PSNIP_ATOMIC_ORDER_RELAXED);
+  psnip_atomic_int32_store_explicit (&(lock->serving), PSNIP_SPINLOCK__TICKET_NEXT(serving), PSNIP_ATOMIC_ORDER_RELEASE);
+}
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock_ticket_stats (struct PsnipSpinlockTicket* lock, struct PsnipSpinlockStats* stats) {
+  PSNIP_SPINLOCK__COUNTERS_GET(lock, stats);
+}
+
+/* Adaptive mutex.
+ *
+ * This is the three-state mutex from Ulrich Drepper's "Futexes Are
+ * Tricky": 0 is unlocked, 1 is locked, and 2 is locked with (possibly)
+ * sleeping waiters, so unlocking only has to wake anyone up if the
+ * state was 2. */
+
+struct PsnipSpinlockMutex {
+  psnip_atomic_int32 state;
+#if !defined(PSNIP_SPINLOCK_NO_STATS)
+  char pad[PSNIP_CACHE_LINE_SIZE - sizeof(psnip_atomic_int32)];
+  PSNIP_CACHE_LINE_ALIGNED struct PsnipSpinlock__Counters counters;
+#endif
+};
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock_mutex_init (struct PsnipSpinlockMutex* mutex) {
+  psnip_atomic_int32_store (&(mutex->state), 0);
+  PSNIP_SPINLOCK__COUNTERS_INIT(mutex);
+}
+
+/* Returns 1 if the mutex was acquired, 0 if it is held. */
+PSNIP_SPINLOCK__FUNCTION
+int
+psnip_spinlock_mutex_trylock (struct PsnipSpinlockMutex* mutex) {
+  psnip_int32_t c = 0;
+
+  if (!psnip_atomic_int32_compare_exchange_explicit (&(mutex->state), &c, 1, PSNIP_ATOMIC_ORDER_ACQUIRE, PSNIP_ATOMIC_ORDER_RELAXED))
+    return 0;
+
+  PSNIP_SPINLOCK__RECORD(mutex, 0, 0);
+  return 1;
+}
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock_mutex_lock (struct PsnipSpinlockMutex* mutex) {
+  psnip_int64_t spins = 0, sleeps = 0;
+  psnip_int32_t c = 0;
+
+  if (psnip_atomic_int32_compare_exchange_explicit (&(mutex->state), &c, 1, PSNIP_ATOMIC_ORDER_ACQUIRE, PSNIP_ATOMIC_ORDER_RELAXED)) {
+    PSNIP_SPINLOCK__RECORD(mutex, 0, 0);
+    return;
+  }
+
+  /* Critical sections are short, so the holder will probably release
+   * it soon; spin for a bit before paying for a trip to the kernel. */
+  for (spins = 1 ; spins <= PSNIP_SPINLOCK_MUTEX_SPINS ; spins++) {
+    PSNIP_SPINLOCK_PAUSE();
+    c = psnip_atomic_int32_load_explicit (&(mutex->state), PSNIP_ATOMIC_ORDER_RELAXED);
+    if (c == 0 &&
+        psnip_atomic_int32_compare_exchange_explicit (&(mutex->state), &c, 1, PSNIP_ATOMIC_ORDER_ACQUIRE, PSNIP_ATOMIC_ORDER_RELAXED)) {
+      PSNIP_SPINLOCK__RECORD(mutex, spins, 0);
+      return;
+    }
+  }
+  spins--;
+
+  /* Mark the mutex as having waiters, then sleep until it is
+   * released.  Whoever takes it this way leaves it in state 2, since
+   * it can't know whether anyone else is still waiting. */
+  if (c != 2)
+    c = psnip_atomic_int32_exchange_explicit (&(mutex->state), 2, PSNIP_ATOMIC_ORDER_ACQUIRE);
+  while (c != 0) {
+    psnip_atomic_int32_wait (&(mutex->state), 2);
+    sleeps++;
+    c = psnip_atomic_int32_exchange_explicit (&(mutex->state), 2, PSNIP_ATOMIC_ORDER_ACQUIRE);
+  }
+
+  PSNIP_SPINLOCK__RECORD(mutex, spins, sleeps);
+}
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock_mutex_unlock (struct PsnipSpinlockMutex* mutex) {
+  if (psnip_atomic_int32_fetch_sub_explicit (&(mutex->state), 1, PSNIP_ATOMIC_ORDER_RELEASE) != 1) {
+    psnip_atomic_int32_store_explicit (&(mutex->state), 0, PSNIP_ATOMIC_ORDER_RELEASE);
+    psnip_atomic_int32_notify_one (&(mutex->state));
+  }
+}
+
+PSNIP_SPINLOCK__FUNCTION
+void
+psnip_spinlock_mutex_stats (struct PsnipSpinlockMutex* mutex, struct PsnipSpinlockStats* stats) {
+  PSNIP_SPINLOCK__COUNTERS_GET(mutex, stats);
+}
+
+#endif /* !defined(PSNIP_SPINLOCK_H) */
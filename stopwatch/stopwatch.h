@@ -0,0 +1,232 @@
+/* Stopwatch and latency histograms (v1)
+ * Portable Snippets - https://github.com/nemequ/portable-snippets
+ * Created by Evan Nemerson <evan@nemerson.com>
+ *
+ *   To the extent possible under law, the authors have waived all
+ *   copyright and related or neighboring rights to this code.  For
+ *   details, see the Creative Commons Zero 1.0 Universal license at
+ *   https://creativecommons.org/publicdomain/zero/1.0/
+ *
+ * A stopwatch measures elapsed monotonic time in nanoseconds, and a
+ * histogram collects those measurements in log-linear buckets (the
+ * same layout HdrHistogram uses) so you can ask for percentiles
+ * later.  Recording a value is a count-leading-zeros, a couple of
+ * shifts, and an increment; there is no allocation and no locking.
+ *
+ * Histograms are not thread-safe.  The intended use is one histogram
+ * per thread, with the owning thread doing all the recording, then
+ * merging them into a single histogram when you want to report.
+ */
+
+#if !defined(PSNIP_STOPWATCH_H)
+#define PSNIP_STOPWATCH_H
+
+#if !defined(PSNIP_CLOCK_H)
+#  include "../clock/clock.h"
+#endif
+
+#if !defined(PSNIP_BUILTIN_H)
+#  include "../builtin/builtin.h"
+#endif
+
+#include <string.h>
+
+#if !defined(PSNIP_STOPWATCH_STATIC_INLINE)
+#  if defined(__GNUC__)
+#    define PSNIP_STOPWATCH__COMPILER_ATTRIBUTES __attribute__((__unused__))
+#  else
+#    define PSNIP_STOPWATCH__COMPILER_ATTRIBUTES
+#  endif
+
+#  if defined(HEDLEY_INLINE)
+#    define PSNIP_STOPWATCH__INLINE HEDLEY_INLINE
+#  elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#    define PSNIP_STOPWATCH__INLINE inline
+#  elif defined(__GNUC_STDC_INLINE__)
+#    define PSNIP_STOPWATCH__INLINE __inline__
+#  elif defined(_MSC_VER) && _MSC_VER >= 1200
+#    define PSNIP_STOPWATCH__INLINE __inline
+#  else
+#    define PSNIP_STOPWATCH__INLINE
+#  endif
+
+#  define PSNIP_STOPWATCH__FUNCTION PSNIP_STOPWATCH__COMPILER_ATTRIBUTES static PSNIP_STOPWATCH__INLINE
+#endif
+
+/*** Stopwatch ***/
+
+struct PsnipStopwatch {
+  psnip_uint64_t start;
+};
+
+/* Start (or restart) the stopwatch.  Returns 0 on success, or a
+ * negative value (from psnip_clock_get_time) if no monotonic clock is
+ * available. */
+PSNIP_STOPWATCH__FUNCTION int
+psnip_stopwatch_start (struct PsnipStopwatch* stopwatch) {
+  return psnip_clock_get_time_ns (PSNIP_CLOCK_TYPE_MONOTONIC, &(stopwatch->start));
+}
+
+/* Nanoseconds elapsed since the stopwatch was started. */
+PSNIP_STOPWATCH__FUNCTION psnip_uint64_t
+psnip_stopwatch_elapsed (const struct PsnipStopwatch* stopwatch) {
+  psnip_uint64_t now;
+
+  if (psnip_clock_get_time_ns (PSNIP_CLOCK_TYPE_MONOTONIC, &now) != 0)
+    return 0;
+
+  return (now > stopwatch->start) ? (now - stopwatch->start) : 0;
+}
+
+/* Nanoseconds elapsed since the stopwatch was started, restarting it
+ * in the same step.  Handy for timing consecutive sections with a
+ * single clock read between each one. */
+PSNIP_STOPWATCH__FUNCTION psnip_uint64_t
+psnip_stopwatch_lap (struct PsnipStopwatch* stopwatch) {
+  psnip_uint64_t now, elapsed;
+
+  if (psnip_clock_get_time_ns (PSNIP_CLOCK_TYPE_MONOTONIC, &now) != 0)
+    return 0;
+
+  elapsed = (now > stopwatch->start) ? (now - stopwatch->start) : 0;
+  stopwatch->start = now;
+
+  return elapsed;
+}
+
+/*** Histogram ***/
+
+/* Each power of two is split into 2^PSNIP_STOPWATCH_HISTOGRAM_SUB_BITS
+ * linear sub-buckets, so the relative error of any recorded value is
+ * at most 1 / 2^PSNIP_STOPWATCH_HISTOGRAM_SUB_BITS (6.25% for the
+ * default of 4).  Values smaller than the number of sub-buckets are
+ * recorded exactly. */
+#if !defined(PSNIP_STOPWATCH_HISTOGRAM_SUB_BITS)
+#  define PSNIP_STOPWATCH_HISTOGRAM_SUB_BITS 4
+#endif
+
+#define PSNIP_STOPWATCH_HISTOGRAM_SUB_BUCKETS (1 << PSNIP_STOPWATCH_HISTOGRAM_SUB_BITS)
+#define PSNIP_STOPWATCH_HISTOGRAM_BUCKETS \
+  ((64 - PSNIP_STOPWATCH_HISTOGRAM_SUB_BITS + 1) * PSNIP_STOPWATCH_HISTOGRAM_SUB_BUCKETS)
+
+struct PsnipStopwatchHistogram {
+  psnip_uint64_t count;
+  psnip_uint64_t sum;
+  psnip_uint64_t min;
+  psnip_uint64_t max;
+  psnip_uint64_t buckets[PSNIP_STOPWATCH_HISTOGRAM_BUCKETS];
+};
+
+PSNIP_STOPWATCH__FUNCTION void
+psnip_stopwatch_histogram_reset (struct PsnipStopwatchHistogram* histogram) {
+  memset(histogram, 0, sizeof(*histogram));
+  histogram->min = ~((psnip_uint64_t) 0);
+}
+
+PSNIP_STOPWATCH__FUNCTION unsigned int
+psnip_stopwatch_histogram__index (psnip_uint64_t value) {
+  unsigned int shift;
+
+  if (value < PSNIP_STOPWATCH_HISTOGRAM_SUB_BUCKETS)
+    return (unsigned int) value;
+
+  shift = (unsigned int) (63 - psnip_builtin_clz64(value)) - PSNIP_STOPWATCH_HISTOGRAM_SUB_BITS;
+
+  return
+    ((shift + 1) << PSNIP_STOPWATCH_HISTOGRAM_SUB_BITS) +
+    (unsigned int) ((value >> shift) & (PSNIP_STOPWATCH_HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/* Largest value which maps to the bucket at index. */
+PSNIP_STOPWATCH__FUNCTION psnip_uint64_t
+psnip_stopwatch_histogram__upper_bound (unsigned int index) {
+  const unsigned int group = index >> PSNIP_STOPWATCH_HISTOGRAM_SUB_BITS;
+  psnip_uint64_t lower;
+
+  if (group == 0)
+    return index;
+
+  lower = ((psnip_uint64_t) (PSNIP_STOPWATCH_HISTOGRAM_SUB_BUCKETS | (index & (PSNIP_STOPWATCH_HISTOGRAM_SUB_BUCKETS - 1)))) << (group - 1);
+
+  return lower + ((((psnip_uint64_t) 1) << (group - 1)) - 1);
+}
+
+PSNIP_STOPWATCH__FUNCTION void
+psnip_stopwatch_histogram_record (struct PsnipStopwatchHistogram* histogram, psnip_uint64_t value) {
+  histogram->buckets[psnip_stopwatch_histogram__index(value)]++;
+  histogram->count++;
+  histogram->sum += value;
+  if (value < histogram->min)
+    histogram->min = value;
+  if (value > histogram->max)
+    histogram->max = value;
+}
+
+/* Record the time elapsed since the stopwatch was started, and
+ * return it.  The stopwatch keeps running. */
+PSNIP_STOPWATCH__FUNCTION psnip_uint64_t
+psnip_stopwatch_histogram_record_elapsed (struct PsnipStopwatchHistogram* histogram, const struct PsnipStopwatch* stopwatch) {
+  const psnip_uint64_t elapsed = psnip_stopwatch_elapsed (stopwatch);
+  psnip_stopwatch_histogram_record (histogram, elapsed);
+  return elapsed;
+}
+
+/* Add all of the values recorded in src to dest.  Nothing may be
+ * recording into either histogram while this runs. */
+PSNIP_STOPWATCH__FUNCTION void
+psnip_stopwatch_histogram_merge (struct PsnipStopwatchHistogram* dest, const struct PsnipStopwatchHistogram* src) {
+  unsigned int i;
+
+  for (i = 0 ; i < PSNIP_STOPWATCH_HISTOGRAM_BUCKETS ; i++)
+    dest->buckets[i] += src->buckets[i];
+
+  dest->count += src->count;
+  dest->sum += src->sum;
+  if (src->min < dest->min)
+    dest->min = src->min;
+  if (src->max > dest->max)
+    dest->max = src->max;
+}
+
+/* Returns the value at the requested percentile (0 - 100), or 0 if
+ * nothing has been recorded.  The result is the upper bound of the
+ * bucket containing the percentile, clamped to the observed range,
+ * so it is never smaller than the true value. */
+PSNIP_STOPWATCH__FUNCTION psnip_uint64_t
+psnip_stopwatch_histogram_percentile (const struct PsnipStopwatchHistogram* histogram, double percentile) {
+  psnip_uint64_t rank, seen = 0, res;
+  unsigned int i;
+
+  if (histogram->count == 0)
+    return 0;
+
+  if (percentile <= 0.0)
+    return histogram->min;
+  if (percentile >= 100.0)
+    return histogram->max;
+
+  rank = (psnip_uint64_t) (((percentile / 100.0) * (double) histogram->count) + 0.5);
+  if (rank == 0)
+    rank = 1;
+
+  for (i = 0 ; i < PSNIP_STOPWATCH_HISTOGRAM_BUCKETS ; i++) {
+    seen += histogram->buckets[i];
+    if (seen >= rank)
+      break;
+  }
+
+  res = psnip_stopwatch_histogram__upper_bound (i);
+  if (res > histogram->max)
+    res = histogram->max;
+  if (res < histogram->min)
+    res = histogram->min;
+
+  return res;
+}
+
+PSNIP_STOPWATCH__FUNCTION double
+psnip_stopwatch_histogram_mean (const struct PsnipStopwatchHistogram* histogram) {
+  return (histogram->count == 0) ? 0.0 : ((double) histogram->sum / (double) histogram->count);
+}
+
+#endif /* !defined(PSNIP_STOPWATCH_H) */
@@ -0,0 +1,221 @@
+/* Measure the throughput and latency of atomic operations under
+ * contention.
+ *
+ * Each operation is run on 1, 2, 4, ... threads (up to the number of
+ * CPUs, or the first argument), with every thread either hammering
+ * the same variable ("shared") or its own variable on a separate
+ * cache line ("padded").  The difference between the two is the cost
+ * of bouncing the cache line between cores.
+ *
+ * The backend is chosen at compile time, so this is built several
+ * times with different PSNIP_ATOMIC_IMPL overrides to compare them. */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "../exact-int/exact-int.h"
+#include "../atomic/atomic.h"
+#include "../clock/clock.h"
+#include "../cpu/cpu.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#define BENCH_MAX_THREADS 256
+#define BENCH_DEFAULT_ITERATIONS 2000000
+
+enum BenchOp {
+  BENCH_OP_LOAD,
+  BENCH_OP_STORE,
+  BENCH_OP_CAS,
+  BENCH_OP_ADD,
+  BENCH_OP_FENCE
+};
+
+struct BenchSlot {
+  psnip_atomic_int64 value;
+  char pad[PSNIP_CACHE_LINE_SIZE - sizeof(psnip_atomic_int64)];
+};
+
+struct BenchThread {
+  pthread_t thread;
+  psnip_atomic_int64* target;
+  psnip_uint64_t start_ns;
+  psnip_uint64_t end_ns;
+  psnip_int64_t sink;
+};
+
+PSNIP_CACHE_LINE_ALIGNED static struct BenchSlot bench_slots[BENCH_MAX_THREADS];
+static struct BenchThread bench_threads[BENCH_MAX_THREADS];
+
+static enum BenchOp bench_op;
+static long bench_iterations = BENCH_DEFAULT_ITERATIONS;
+static psnip_atomic_int32 bench_ready = PSNIP_ATOMIC_VAR_INIT(0);
+static psnip_atomic_int32 bench_go = PSNIP_ATOMIC_VAR_INIT(0);
+
+static const char*
+impl_name (void) {
+  switch (PSNIP_ATOMIC_IMPL) {
+    case PSNIP_ATOMIC_IMPL_GCC:      return "gcc";
+    case PSNIP_ATOMIC_IMPL_GCC_SYNC: return "gcc-sync";
+    case PSNIP_ATOMIC_IMPL_CLANG:    return "clang";
+    case PSNIP_ATOMIC_IMPL_MS:       return "ms";
+    case PSNIP_ATOMIC_IMPL_OPENMP:   return "openmp";
+    case PSNIP_ATOMIC_IMPL_C11:      return "c11";
+    default:                         return "none";
+  }
+}
+
+static const char*
+op_name (enum BenchOp op) {
+  switch (op) {
+    case BENCH_OP_LOAD:  return "load";
+    case BENCH_OP_STORE: return "store";
+    case BENCH_OP_CAS:   return "cas";
+    case BENCH_OP_ADD:   return "add";
+    case BENCH_OP_FENCE: return "fence";
+  }
+
+  return "unknown";
+}
+
+static void*
+bench_thread (void* arg) {
+  struct BenchThread* self = (struct BenchThread*) arg;
+  psnip_atomic_int64* target = self->target;
+  psnip_int64_t sink = 0;
+  psnip_int64_t expected;
+  long i;
+
+  /* Don't start until everyone is ready, or the first thread gets a
+   * head start without contention. */
+  psnip_atomic_int32_fetch_add (&bench_ready, 1);
+  while (psnip_atomic_int32_load (&bench_go) == 0)
+    sched_yield ();
+
+  psnip_clock_get_time_ns (PSNIP_CLOCK_TYPE_MONOTONIC, &(self->start_ns));
+
+  switch (bench_op) {
+    case BENCH_OP_LOAD:
+      for (i = 0 ; i < bench_iterations ; i++)
+        sink += psnip_atomic_int64_load (target);
+      break;
+    case BENCH_OP_STORE:
+      for (i = 0 ; i < bench_iterations ; i++)
+        psnip_atomic_int64_store (target, (psnip_int64_t) i);
+      break;
+    case BENCH_OP_CAS:
+      /* Every attempt counts as an operation, whether or not it
+       * succeeds; under contention most of them won't. */
+      expected = psnip_atomic_int64_load (target);
+      for (i = 0 ; i < bench_iterations ; i++)
+        sink += psnip_atomic_int64_compare_exchange (target, &expected, expected + 1);
+      break;
+    case BENCH_OP_ADD:
+      for (i = 0 ; i < bench_iterations ; i++)
+        sink += psnip_atomic_int64_fetch_add (target, 1);
+      break;
+    case BENCH_OP_FENCE:
+      for (i = 0 ; i < bench_iterations ; i++)
+        psnip_atomic_fence ();
+      break;
+  }
+
+  psnip_clock_get_time_ns (PSNIP_CLOCK_TYPE_MONOTONIC, &(self->end_ns));
+  self->sink = sink;
+
+  return NULL;
+}
+
+static int
+bench_run (enum BenchOp op, int padded, int n_threads) {
+  psnip_uint64_t first_start, last_end, thread_ns = 0;
+  double elapsed_s, ops_per_s, ns_per_op;
+  int i;
+
+  bench_op = op;
+  psnip_atomic_int32_store (&bench_ready, 0);
+  psnip_atomic_int32_store (&bench_go, 0);
+
+  for (i = 0 ; i < n_threads ; i++) {
+    psnip_atomic_int64_store (&(bench_slots[i].value), 0);
+    bench_threads[i].target = &(bench_slots[padded ? i : 0].value);
+    if (pthread_create (&(bench_threads[i].thread), NULL, bench_thread, &(bench_threads[i])) != 0) {
+      fprintf (stderr, "Unable to create thread %d\n", i);
+      return -1;
+    }
+  }
+
+  while (psnip_atomic_int32_load (&bench_ready) != n_threads)
+    sched_yield ();
+  psnip_atomic_int32_store (&bench_go, 1);
+
+  for (i = 0 ; i < n_threads ; i++)
+    pthread_join (bench_threads[i].thread, NULL);
+
+  first_start = bench_threads[0].start_ns;
+  last_end = bench_threads[0].end_ns;
+  for (i = 0 ; i < n_threads ; i++) {
+    if (bench_threads[i].start_ns < first_start)
+      first_start = bench_threads[i].start_ns;
+    if (bench_threads[i].end_ns > last_end)
+      last_end = bench_threads[i].end_ns;
+    thread_ns += bench_threads[i].end_ns - bench_threads[i].start_ns;
+  }
+
+  /* Throughput is over the whole run; latency is what each thread saw
+   * per operation, averaged over the threads. */
+  elapsed_s = (double) (last_end - first_start) / 1e9;
+  ops_per_s = ((double) bench_iterations * n_threads) / (elapsed_s > 0 ? elapsed_s : 1e-9);
+  ns_per_op = (double) thread_ns / ((double) bench_iterations * n_threads);
+
+  printf ("%-9s %-6s %-7s %7d %14.2f %10.2f\n",
+          impl_name (), op_name (op), (op == BENCH_OP_FENCE) ? "-" : (padded ? "padded" : "shared"),
+          n_threads, ops_per_s / 1e6, ns_per_op);
+
+  return 0;
+}
+
+int
+main (int argc, char* argv[]) {
+  static const enum BenchOp ops[] = {
+    BENCH_OP_LOAD, BENCH_OP_STORE, BENCH_OP_CAS, BENCH_OP_ADD, BENCH_OP_FENCE
+  };
+  int max_threads = psnip_cpu_count ();
+  int n_threads, padded;
+  size_t op;
+
+  if (argc > 1)
+    max_threads = atoi (argv[1]);
+  if (argc > 2)
+    bench_iterations = atol (argv[2]);
+  if (max_threads < 1)
+    max_threads = 1;
+  if (max_threads > BENCH_MAX_THREADS)
+    max_threads = BENCH_MAX_THREADS;
+  if (bench_iterations < 1)
+    bench_iterations = BENCH_DEFAULT_ITERATIONS;
+
+  printf ("%-9s %-6s %-7s %7s %14s %10s\n", "backend", "op", "layout", "threads", "Mops/s", "ns/op");
+
+  for (op = 0 ; op < sizeof (ops) / sizeof (ops[0]) ; op++) {
+    for (padded = 0 ; padded <= 1 ; padded++) {
+      /* Fences don't touch memory, so the layout doesn't matter. */
+      if (padded && ops[op] == BENCH_OP_FENCE)
+        continue;
+
+      for (n_threads = 1 ; ; n_threads *= 2) {
+        if (n_threads > max_threads)
+          n_threads = max_threads;
+        if (bench_run (ops[op], padded, n_threads) != 0)
+          return EXIT_FAILURE;
+        if (n_threads == max_threads)
+          break;
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+#if defined(PSNIP_ENABLE_PTHREADS)
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+#include "../exact-int/exact-int.h"
+#include "../atomic-wait/atomic-wait.h"
+#include "munit/munit.h"
+
+static MunitResult
+test_atomic_wait_basic(const MunitParameter params[], void* data) {
+  psnip_atomic_int32 value = PSNIP_ATOMIC_VAR_INIT(0);
+
+  (void) params;
+  (void) data;
+
+  /* Nobody waiting; these shouldn't block or fail. */
+  psnip_atomic_int32_notify_one(&value);
+  psnip_atomic_int32_notify_all(&value);
+
+  /* The value doesn't match, so this returns immediately. */
+  psnip_atomic_int32_store(&value, 1);
+  psnip_atomic_int32_wait(&value, 0);
+  munit_assert_int32(psnip_atomic_int32_load(&value), ==, 1);
+
+  return MUNIT_OK;
+}
+
+#if defined(PSNIP_ENABLE_PTHREADS)
+
+#define ATOMIC_WAIT_THREADS 4
+#define ATOMIC_WAIT_ROUNDS 1000
+
+static psnip_atomic_int32 gate = PSNIP_ATOMIC_VAR_INIT(0);
+static psnip_atomic_int32 arrived = PSNIP_ATOMIC_VAR_INIT(0);
+static psnip_atomic_int32 turn = PSNIP_ATOMIC_VAR_INIT(0);
+
+static void*
+gate_thread(void* arg) {
+  (void) arg;
+
+  psnip_atomic_int32_fetch_add(&arrived, 1);
+  psnip_atomic_int32_wait(&gate, 0);
+  munit_assert_int32(psnip_atomic_int32_load(&gate), ==, 1);
+
+  return NULL;
+}
+
+static MunitResult
+test_atomic_wait_notify_all(const MunitParameter params[], void* data) {
+  pthread_t threads[ATOMIC_WAIT_THREADS];
+  size_t i;
+
+  (void) params;
+  (void) data;
+
+  psnip_atomic_int32_store(&gate, 0);
+  psnip_atomic_int32_store(&arrived, 0);
+  for (i = 0 ; i < ATOMIC_WAIT_THREADS ; i++)
+    munit_assert_int(pthread_create(&(threads[i]), NULL, gate_thread, NULL), ==, 0);
+
+  /* Give them a chance to actually go to sleep; if they haven't yet
+   * they'll see the new value instead, which is fine too. */
+  while (psnip_atomic_int32_load(&arrived) != ATOMIC_WAIT_THREADS)
+    sched_yield();
+  for (i = 0 ; i < 10 ; i++)
+    sched_yield();
+
+  psnip_atomic_int32_store(&gate, 1);
+  psnip_atomic_int32_notify_all(&gate);
+
+  for (i = 0 ; i < ATOMIC_WAIT_THREADS ; i++)
+    pthread_join(threads[i], NULL);
+
+  return MUNIT_OK;
+}
+
+/* Two threads take turns; each waits for the other to hand it the
+ * turn, so a lost wakeup would hang the test. */
+static void*
+ping_pong_thread(void* arg) {
+  const psnip_int32_t me = (psnip_int32_t) (size_t) arg;
+  int i;
+
+  for (i = 0 ; i < ATOMIC_WAIT_ROUNDS ; i++) {
+    psnip_atomic_int32_wait(&turn, 1 - me);
+    munit_assert_int32(psnip_atomic_int32_load(&turn), ==, me);
+    psnip_atomic_int32_store(&turn, 1 - me);
+    psnip_atomic_int32_notify_one(&turn);
+  }
+
+  return NULL;
+}
+
+static MunitResult
+test_atomic_wait_ping_pong(const MunitParameter params[], void* data) {
+  pthread_t threads[2];
+  size_t i;
+
+  (void) params;
+  (void) data;
+
+  psnip_atomic_int32_store(&turn, 0);
+  for (i = 0 ; i < 2 ; i++)
+    munit_assert_int(pthread_create(&(threads[i]), NULL, ping_pong_thread, (void*) i), ==, 0);
+  for (i = 0 ; i < 2 ; i++)
+    pthread_join(threads[i], NULL);
+
+  munit_assert_int32(psnip_atomic_int32_load(&turn), ==, 0);
+
+  return MUNIT_OK;
+}
+
+#endif /* defined(PSNIP_ENABLE_PTHREADS) */
+
+static MunitTest test_suite_tests[] = {
+  { (char*) "/atomic-wait/basic",      test_atomic_wait_basic,      NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+#if defined(PSNIP_ENABLE_PTHREADS)
+  { (char*) "/atomic-wait/notify-all", test_atomic_wait_notify_all, NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/atomic-wait/ping-pong",  test_atomic_wait_ping_pong,  NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+#endif
+  { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
+};
+
+static const MunitSuite test_suite = {
+  (char*) "", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE
+};
+
+int main(int argc, char* argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
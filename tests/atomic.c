@@ -1,11 +1,20 @@
 #include <stdlib.h>
 #include "../exact-int/exact-int.h"
 #include "../atomic/atomic.h"
+#include "../cpu/cpu.h"
 #include "munit/munit.h"
 
 #if !defined(PSNIP_ATOMIC_NOT_FOUND)
 static psnip_atomic_int64 value64 = PSNIP_ATOMIC_VAR_INIT(9);
 static psnip_atomic_int32 value32 = PSNIP_ATOMIC_VAR_INIT(9);
+static psnip_atomic_int64 explicit64 = PSNIP_ATOMIC_VAR_INIT(0);
+static psnip_atomic_int32 explicit32 = PSNIP_ATOMIC_VAR_INIT(0);
+static psnip_atomic_ptr valueptr = PSNIP_ATOMIC_VAR_INIT(NULL);
+static psnip_atomic_int64 rmw64 = PSNIP_ATOMIC_VAR_INIT(0);
+static psnip_atomic_int32 rmw32 = PSNIP_ATOMIC_VAR_INIT(0);
+static psnip_atomic_int16 value16 = PSNIP_ATOMIC_VAR_INIT(9);
+static psnip_atomic_int8 value8 = PSNIP_ATOMIC_VAR_INIT(9);
+static psnip_atomic_flag flag = PSNIP_ATOMIC_FLAG_INIT;
 #endif
 
 static MunitResult
@@ -86,9 +95,297 @@ test_atomic_int32(const MunitParameter params[], void* data) {
 #endif
 }
 
+static MunitResult
+test_atomic_explicit(const MunitParameter params[], void* data) {
+#if !defined(PSNIP_ATOMIC_NOT_FOUND)
+  psnip_int64_t v64, expected64;
+  psnip_int32_t v32, expected32;
+#endif
+
+  (void) params;
+  (void) data;
+
+#if !defined(PSNIP_ATOMIC_NOT_FOUND)
+  psnip_atomic_int64_store_explicit(&explicit64, 42, PSNIP_ATOMIC_ORDER_RELAXED);
+  psnip_atomic_int32_store_explicit(&explicit32, 42, PSNIP_ATOMIC_ORDER_RELEASE);
+  psnip_atomic_fence_explicit(PSNIP_ATOMIC_ORDER_SEQ_CST);
+  munit_assert_int64(psnip_atomic_int64_load_explicit(&explicit64, PSNIP_ATOMIC_ORDER_ACQUIRE), ==, 42);
+  munit_assert_int32(psnip_atomic_int32_load_explicit(&explicit32, PSNIP_ATOMIC_ORDER_RELAXED), ==, 42);
+
+  psnip_atomic_int64_add_explicit(&explicit64, 8, PSNIP_ATOMIC_ORDER_RELAXED);
+  psnip_atomic_int32_add_explicit(&explicit32, 8, PSNIP_ATOMIC_ORDER_ACQ_REL);
+  psnip_atomic_int64_sub_explicit(&explicit64, 20, PSNIP_ATOMIC_ORDER_RELEASE);
+  psnip_atomic_int32_sub_explicit(&explicit32, 20, PSNIP_ATOMIC_ORDER_ACQUIRE);
+  psnip_atomic_fence_explicit(PSNIP_ATOMIC_ORDER_ACQ_REL);
+  munit_assert_int64(psnip_atomic_int64_load_explicit(&explicit64, PSNIP_ATOMIC_ORDER_SEQ_CST), ==, 30);
+  munit_assert_int32(psnip_atomic_int32_load_explicit(&explicit32, PSNIP_ATOMIC_ORDER_SEQ_CST), ==, 30);
+
+  /* A failing compare & swap must leave the value alone. */
+  expected64 = 31;
+  munit_assert_false(psnip_atomic_int64_compare_exchange_explicit(&explicit64, &expected64, 0, PSNIP_ATOMIC_ORDER_ACQ_REL, PSNIP_ATOMIC_ORDER_ACQUIRE));
+  expected32 = 31;
+  munit_assert_false(psnip_atomic_int32_compare_exchange_explicit(&explicit32, &expected32, 0, PSNIP_ATOMIC_ORDER_RELEASE, PSNIP_ATOMIC_ORDER_RELAXED));
+  munit_assert_int64(psnip_atomic_int64_load_explicit(&explicit64, PSNIP_ATOMIC_ORDER_RELAXED), ==, 30);
+  munit_assert_int32(psnip_atomic_int32_load_explicit(&explicit32, PSNIP_ATOMIC_ORDER_RELAXED), ==, 30);
+
+  do {
+    expected64 = psnip_atomic_int64_load_explicit(&explicit64, PSNIP_ATOMIC_ORDER_RELAXED);
+    v64 = expected64 * 2;
+  } while (!psnip_atomic_int64_compare_exchange_explicit(&explicit64, &expected64, v64, PSNIP_ATOMIC_ORDER_RELAXED, PSNIP_ATOMIC_ORDER_RELAXED));
+  do {
+    expected32 = psnip_atomic_int32_load_explicit(&explicit32, PSNIP_ATOMIC_ORDER_ACQUIRE);
+    v32 = expected32 * 2;
+  } while (!psnip_atomic_int32_compare_exchange_explicit(&explicit32, &expected32, v32, PSNIP_ATOMIC_ORDER_SEQ_CST, PSNIP_ATOMIC_ORDER_SEQ_CST));
+  munit_assert_int64(psnip_atomic_int64_load(&explicit64), ==, 60);
+  munit_assert_int32(psnip_atomic_int32_load(&explicit32), ==, 60);
+
+  return MUNIT_OK;
+#else
+  return MUNIT_SKIP;
+#endif
+}
+
+/* Every read-modify-write operation returns the previous value. */
+static MunitResult
+test_atomic_rmw(const MunitParameter params[], void* data) {
+  (void) params;
+  (void) data;
+
+#if !defined(PSNIP_ATOMIC_NOT_FOUND)
+  psnip_atomic_int64_store(&rmw64, 0);
+  munit_assert_int64(psnip_atomic_int64_add(&rmw64, 5), ==, 0);
+  munit_assert_int64(psnip_atomic_int64_sub(&rmw64, 2), ==, 5);
+  munit_assert_int64(psnip_atomic_int64_fetch_add(&rmw64, 7), ==, 3);
+  munit_assert_int64(psnip_atomic_int64_fetch_sub(&rmw64, 10), ==, 10);
+  munit_assert_int64(psnip_atomic_int64_exchange(&rmw64, 0x0f0f), ==, 0);
+  munit_assert_int64(psnip_atomic_int64_fetch_or(&rmw64, 0x00f0), ==, 0x0f0f);
+  munit_assert_int64(psnip_atomic_int64_fetch_and(&rmw64, 0x3c3c), ==, 0x0fff);
+  munit_assert_int64(psnip_atomic_int64_fetch_xor(&rmw64, 0x1111), ==, 0x0c3c);
+  munit_assert_int64(psnip_atomic_int64_exchange_explicit(&rmw64, -1, PSNIP_ATOMIC_ORDER_ACQ_REL), ==, 0x1d2d);
+  munit_assert_int64(psnip_atomic_int64_fetch_and_explicit(&rmw64, ~((psnip_int64_t) 1), PSNIP_ATOMIC_ORDER_RELAXED), ==, -1);
+  munit_assert_int64(psnip_atomic_int64_fetch_xor_explicit(&rmw64, -1, PSNIP_ATOMIC_ORDER_RELEASE), ==, -2);
+  munit_assert_int64(psnip_atomic_int64_fetch_or_explicit(&rmw64, 2, PSNIP_ATOMIC_ORDER_ACQUIRE), ==, 1);
+  munit_assert_int64(psnip_atomic_int64_fetch_add_explicit(&rmw64, 1, PSNIP_ATOMIC_ORDER_SEQ_CST), ==, 3);
+  munit_assert_int64(psnip_atomic_int64_fetch_sub_explicit(&rmw64, 4, PSNIP_ATOMIC_ORDER_RELAXED), ==, 4);
+  munit_assert_int64(psnip_atomic_int64_load(&rmw64), ==, 0);
+
+  /* High bits, to make sure nothing gets truncated. */
+  munit_assert_int64(psnip_atomic_int64_fetch_or(&rmw64, ((psnip_int64_t) 1) << 40), ==, 0);
+  munit_assert_int64(psnip_atomic_int64_exchange(&rmw64, 0), ==, ((psnip_int64_t) 1) << 40);
+
+  psnip_atomic_int32_store(&rmw32, 0);
+  munit_assert_int32(psnip_atomic_int32_add(&rmw32, 5), ==, 0);
+  munit_assert_int32(psnip_atomic_int32_sub(&rmw32, 2), ==, 5);
+  munit_assert_int32(psnip_atomic_int32_fetch_add(&rmw32, 7), ==, 3);
+  munit_assert_int32(psnip_atomic_int32_fetch_sub(&rmw32, 10), ==, 10);
+  munit_assert_int32(psnip_atomic_int32_exchange(&rmw32, 0x0f0f), ==, 0);
+  munit_assert_int32(psnip_atomic_int32_fetch_or(&rmw32, 0x00f0), ==, 0x0f0f);
+  munit_assert_int32(psnip_atomic_int32_fetch_and(&rmw32, 0x3c3c), ==, 0x0fff);
+  munit_assert_int32(psnip_atomic_int32_fetch_xor(&rmw32, 0x1111), ==, 0x0c3c);
+  munit_assert_int32(psnip_atomic_int32_exchange_explicit(&rmw32, -1, PSNIP_ATOMIC_ORDER_ACQ_REL), ==, 0x1d2d);
+  munit_assert_int32(psnip_atomic_int32_fetch_and_explicit(&rmw32, ~((psnip_int32_t) 1), PSNIP_ATOMIC_ORDER_RELAXED), ==, -1);
+  munit_assert_int32(psnip_atomic_int32_fetch_xor_explicit(&rmw32, -1, PSNIP_ATOMIC_ORDER_RELEASE), ==, -2);
+  munit_assert_int32(psnip_atomic_int32_fetch_or_explicit(&rmw32, 2, PSNIP_ATOMIC_ORDER_ACQUIRE), ==, 1);
+  munit_assert_int32(psnip_atomic_int32_fetch_add_explicit(&rmw32, 1, PSNIP_ATOMIC_ORDER_SEQ_CST), ==, 3);
+  munit_assert_int32(psnip_atomic_int32_fetch_sub_explicit(&rmw32, 4, PSNIP_ATOMIC_ORDER_RELAXED), ==, 4);
+  munit_assert_int32(psnip_atomic_int32_load(&rmw32), ==, 0);
+
+  return MUNIT_OK;
+#else
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_atomic_small(const MunitParameter params[], void* data) {
+#if !defined(PSNIP_ATOMIC_NOT_FOUND)
+  static psnip_atomic_int8 packed[4];
+  psnip_int16_t expected16;
+  psnip_int8_t expected8;
+  int i;
+#endif
+
+  (void) params;
+  (void) data;
+
+#if !defined(PSNIP_ATOMIC_NOT_FOUND)
+  munit_assert_int16(psnip_atomic_int16_load(&value16), ==, 9);
+  psnip_atomic_int16_store(&value16, 1000);
+  munit_assert_int16(psnip_atomic_int16_add(&value16, 729), ==, 1000);
+  munit_assert_int16(psnip_atomic_int16_sub(&value16, 1729), ==, 1729);
+  munit_assert_int16(psnip_atomic_int16_exchange(&value16, 0x0f0f), ==, 0);
+  munit_assert_int16(psnip_atomic_int16_fetch_or(&value16, 0x00f0), ==, 0x0f0f);
+  munit_assert_int16(psnip_atomic_int16_fetch_and(&value16, 0x3c3c), ==, 0x0fff);
+  munit_assert_int16(psnip_atomic_int16_fetch_xor(&value16, 0x1111), ==, 0x0c3c);
+  munit_assert_int16(psnip_atomic_int16_fetch_add_explicit(&value16, 3, PSNIP_ATOMIC_ORDER_RELAXED), ==, 0x1d2d);
+  munit_assert_int16(psnip_atomic_int16_fetch_sub_explicit(&value16, 0x1d30, PSNIP_ATOMIC_ORDER_ACQ_REL), ==, 0x1d30);
+  munit_assert_int16(psnip_atomic_int16_load_explicit(&value16, PSNIP_ATOMIC_ORDER_ACQUIRE), ==, 0);
+  expected16 = 1;
+  munit_assert_false(psnip_atomic_int16_compare_exchange(&value16, &expected16, -2));
+  munit_assert_int16(expected16, ==, 0);
+  munit_assert_true(psnip_atomic_int16_compare_exchange_explicit(&value16, &expected16, -2, PSNIP_ATOMIC_ORDER_RELEASE, PSNIP_ATOMIC_ORDER_RELAXED));
+  munit_assert_int16(psnip_atomic_int16_exchange_explicit(&value16, 0, PSNIP_ATOMIC_ORDER_SEQ_CST), ==, -2);
+
+  munit_assert_int8(psnip_atomic_int8_load(&value8), ==, 9);
+  psnip_atomic_int8_store(&value8, 100);
+  munit_assert_int8(psnip_atomic_int8_add(&value8, 20), ==, 100);
+  munit_assert_int8(psnip_atomic_int8_sub(&value8, 120), ==, 120);
+  munit_assert_int8(psnip_atomic_int8_exchange(&value8, 0x0f), ==, 0);
+  munit_assert_int8(psnip_atomic_int8_fetch_or(&value8, 0x30), ==, 0x0f);
+  munit_assert_int8(psnip_atomic_int8_fetch_and(&value8, 0x3c), ==, 0x3f);
+  munit_assert_int8(psnip_atomic_int8_fetch_xor(&value8, 0x11), ==, 0x3c);
+  munit_assert_int8(psnip_atomic_int8_fetch_add_explicit(&value8, 3, PSNIP_ATOMIC_ORDER_RELAXED), ==, 0x2d);
+  munit_assert_int8(psnip_atomic_int8_fetch_sub_explicit(&value8, 0x30, PSNIP_ATOMIC_ORDER_ACQ_REL), ==, 0x30);
+  munit_assert_int8(psnip_atomic_int8_load_explicit(&value8, PSNIP_ATOMIC_ORDER_ACQUIRE), ==, 0);
+  expected8 = 1;
+  munit_assert_false(psnip_atomic_int8_compare_exchange(&value8, &expected8, -2));
+  munit_assert_int8(expected8, ==, 0);
+  munit_assert_true(psnip_atomic_int8_compare_exchange_explicit(&value8, &expected8, -2, PSNIP_ATOMIC_ORDER_RELEASE, PSNIP_ATOMIC_ORDER_RELAXED));
+  munit_assert_int8(psnip_atomic_int8_exchange_explicit(&value8, 0, PSNIP_ATOMIC_ORDER_SEQ_CST), ==, -2);
+
+  /* Neighbouring bytes must not be disturbed. */
+  for (i = 0 ; i < 4 ; i++)
+    psnip_atomic_int8_store(&(packed[i]), 0);
+  psnip_atomic_int8_fetch_or(&(packed[1]), 0x7f);
+  psnip_atomic_int8_exchange(&(packed[2]), -1);
+  expected8 = 0;
+  munit_assert_true(psnip_atomic_int8_compare_exchange(&(packed[3]), &expected8, 42));
+  munit_assert_int8(psnip_atomic_int8_load(&(packed[0])), ==, 0);
+  munit_assert_int8(psnip_atomic_int8_load(&(packed[1])), ==, 0x7f);
+  munit_assert_int8(psnip_atomic_int8_load(&(packed[2])), ==, -1);
+  munit_assert_int8(psnip_atomic_int8_load(&(packed[3])), ==, 42);
+
+  return MUNIT_OK;
+#else
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_atomic_flag(const MunitParameter params[], void* data) {
+  (void) params;
+  (void) data;
+
+#if !defined(PSNIP_ATOMIC_NOT_FOUND)
+  munit_assert_false(psnip_atomic_flag_test_and_set(&flag));
+  munit_assert_true(psnip_atomic_flag_test_and_set(&flag));
+  munit_assert_true(psnip_atomic_flag_test_and_set_explicit(&flag, PSNIP_ATOMIC_ORDER_ACQUIRE));
+  psnip_atomic_flag_clear(&flag);
+  munit_assert_false(psnip_atomic_flag_test_and_set_explicit(&flag, PSNIP_ATOMIC_ORDER_ACQUIRE));
+  psnip_atomic_flag_clear_explicit(&flag, PSNIP_ATOMIC_ORDER_RELEASE);
+  munit_assert_false(psnip_atomic_flag_test_and_set_explicit(&flag, PSNIP_ATOMIC_ORDER_RELAXED));
+  psnip_atomic_flag_clear(&flag);
+
+  return MUNIT_OK;
+#else
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_atomic_ptr(const MunitParameter params[], void* data) {
+#if !defined(PSNIP_ATOMIC_NOT_FOUND)
+  static int a[2];
+  void* expected;
+#endif
+
+  (void) params;
+  (void) data;
+
+#if !defined(PSNIP_ATOMIC_NOT_FOUND)
+  munit_assert_ptr_null(psnip_atomic_ptr_load(&valueptr));
+
+  psnip_atomic_ptr_store(&valueptr, &(a[0]));
+  munit_assert_ptr_equal(psnip_atomic_ptr_load(&valueptr), &(a[0]));
+
+  expected = &(a[1]);
+  munit_assert_false(psnip_atomic_ptr_compare_exchange(&valueptr, &expected, NULL));
+  munit_assert_ptr_equal(psnip_atomic_ptr_load(&valueptr), &(a[0]));
+
+  expected = &(a[0]);
+  munit_assert_true(psnip_atomic_ptr_compare_exchange(&valueptr, &expected, &(a[1])));
+  munit_assert_ptr_equal(psnip_atomic_ptr_load_explicit(&valueptr, PSNIP_ATOMIC_ORDER_ACQUIRE), &(a[1]));
+
+  expected = &(a[1]);
+  munit_assert_true(psnip_atomic_ptr_compare_exchange_explicit(&valueptr, &expected, NULL, PSNIP_ATOMIC_ORDER_ACQ_REL, PSNIP_ATOMIC_ORDER_ACQUIRE));
+  psnip_atomic_ptr_store_explicit(&valueptr, &(a[0]), PSNIP_ATOMIC_ORDER_RELEASE);
+  munit_assert_ptr_equal(psnip_atomic_ptr_load_explicit(&valueptr, PSNIP_ATOMIC_ORDER_RELAXED), &(a[0]));
+
+  munit_assert_ptr_equal(psnip_atomic_ptr_exchange(&valueptr, &(a[1])), &(a[0]));
+  munit_assert_ptr_equal(psnip_atomic_ptr_exchange_explicit(&valueptr, NULL, PSNIP_ATOMIC_ORDER_ACQ_REL), &(a[1]));
+  munit_assert_ptr_null(psnip_atomic_ptr_load(&valueptr));
+
+  return MUNIT_OK;
+#else
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_atomic_uint128(const MunitParameter params[], void* data) {
+#if defined(PSNIP_ATOMIC_HAVE_UINT128)
+  static psnip_atomic_uint128 value;
+  psnip_atomic_uint128 expected, desired;
+
+  (void) params;
+  (void) data;
+
+#if defined(PSNIP_ATOMIC_UINT128_NEEDS_CX16)
+  if (!psnip_cpu_feature_check(PSNIP_CPU_FEATURE_X86_CX16))
+    return MUNIT_SKIP;
+#endif
+
+  value.lo = 0;
+  value.hi = 0;
+
+  psnip_atomic_uint128_load(&value, &expected);
+  munit_assert_uint64(expected.lo, ==, 0);
+  munit_assert_uint64(expected.hi, ==, 0);
+
+  /* Make sure both halves are compared and swapped. */
+  desired.lo = UINT64_C(0x0123456789abcdef);
+  desired.hi = UINT64_C(0xfedcba9876543210);
+  munit_assert_true(psnip_atomic_uint128_compare_exchange(&value, &expected, desired));
+  munit_assert_uint64(value.lo, ==, desired.lo);
+  munit_assert_uint64(value.hi, ==, desired.hi);
+
+  expected.lo = desired.lo;
+  expected.hi = 0;
+  munit_assert_false(psnip_atomic_uint128_compare_exchange(&value, &expected, expected));
+  munit_assert_uint64(expected.lo, ==, desired.lo);
+  munit_assert_uint64(expected.hi, ==, desired.hi);
+
+  expected.lo = 0;
+  expected.hi = desired.hi;
+  munit_assert_false(psnip_atomic_uint128_compare_exchange(&value, &expected, expected));
+  munit_assert_uint64(expected.lo, ==, desired.lo);
+  munit_assert_uint64(expected.hi, ==, desired.hi);
+
+  desired.lo++;
+  desired.hi--;
+  munit_assert_true(psnip_atomic_uint128_compare_exchange(&value, &expected, desired));
+  psnip_atomic_uint128_load(&value, &expected);
+  munit_assert_uint64(expected.lo, ==, UINT64_C(0x0123456789abcdf0));
+  munit_assert_uint64(expected.hi, ==, UINT64_C(0xfedcba987654320f));
+
+  return MUNIT_OK;
+#else
+  (void) params;
+  (void) data;
+
+  return MUNIT_SKIP;
+#endif
+}
+
 static MunitTest test_suite_tests[] = {
   { (char*) "/atomic/int64", test_atomic_int64, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
   { (char*) "/atomic/int32", test_atomic_int32, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/atomic/explicit", test_atomic_explicit, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/atomic/rmw", test_atomic_rmw, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/atomic/small", test_atomic_small, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/atomic/flag", test_atomic_flag, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/atomic/ptr", test_atomic_ptr, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/atomic/uint128", test_atomic_uint128, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
   { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
 };
 
@@ -0,0 +1,169 @@
+#include "../exact-int/exact-int.h"
+#include "../cpu/cpu.h"
+#include "../bitset/bitset.h"
+#include "munit/munit.h"
+
+#define BITSET_WORDS 97
+
+static const size_t bitset_batch_sizes[] = { 1, 7, 63, 64, 65, 256, BITSET_WORDS * 64 };
+
+/* One bit in density is set, on average. */
+static void
+bitset_fill(psnip_uint64_t words[BITSET_WORDS], int density) {
+  size_t i;
+  int b;
+
+  for (i = 0 ; i < BITSET_WORDS ; i++) {
+    words[i] = 0;
+    for (b = 0 ; b < 64 ; b++)
+      if (munit_rand_int_range(0, density - 1) == 0)
+        words[i] |= ((psnip_uint64_t) 1) << b;
+  }
+}
+
+static size_t
+bitset_decode_naive(const psnip_uint64_t words[BITSET_WORDS], psnip_uint32_t* out) {
+  size_t i, n = 0;
+  int b;
+
+  for (i = 0 ; i < BITSET_WORDS ; i++)
+    for (b = 0 ; b < 64 ; b++)
+      if ((words[i] >> b) & 1)
+        out[n++] = (psnip_uint32_t) ((i * 64) + (size_t) b);
+
+  return n;
+}
+
+static MunitResult
+test_bitset_iter(const MunitParameter params[], void* data) {
+  static const int densities[] = { 1, 2, 5, 33, 1000 };
+  static psnip_uint64_t words[BITSET_WORDS];
+  static psnip_uint32_t expected[BITSET_WORDS * 64];
+  /* Room for a whole batch past the end. */
+  static psnip_uint32_t actual[BITSET_WORDS * 64 * 2];
+  struct PsnipBitsetIter iter;
+  size_t d, s, total, n, n_expected;
+
+  (void) params;
+  (void) data;
+
+  for (d = 0 ; d < sizeof(densities) / sizeof(densities[0]) ; d++) {
+    bitset_fill(words, densities[d]);
+    n_expected = bitset_decode_naive(words, expected);
+
+    for (s = 0 ; s < sizeof(bitset_batch_sizes) / sizeof(bitset_batch_sizes[0]) ; s++) {
+      psnip_bitset_iter_init(&iter, words, BITSET_WORDS);
+      total = 0;
+      while ((n = psnip_bitset_iter_next(&iter, actual + total, bitset_batch_sizes[s])) != 0) {
+        munit_assert_size(n, <=, bitset_batch_sizes[s]);
+        total += n;
+        munit_assert_size(total, <=, n_expected);
+      }
+      munit_assert_size(total, ==, n_expected);
+      munit_assert_memory_equal(total * sizeof(psnip_uint32_t), actual, expected);
+
+      /* Stays finished. */
+      munit_assert_size(psnip_bitset_iter_next(&iter, actual, bitset_batch_sizes[s]), ==, 0);
+    }
+  }
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_bitset_edges(const MunitParameter params[], void* data) {
+  psnip_uint64_t words[3] = { 0, 0, 0 };
+  psnip_uint32_t out[128];
+  struct PsnipBitsetIter iter;
+
+  (void) params;
+  (void) data;
+
+  psnip_bitset_iter_init(&iter, words, 0);
+  munit_assert_size(psnip_bitset_iter_next(&iter, out, 64), ==, 0);
+
+  psnip_bitset_iter_init(&iter, words, 3);
+  munit_assert_size(psnip_bitset_iter_next(&iter, out, 64), ==, 0);
+
+  words[0] = ((psnip_uint64_t) 1) << 63;
+  words[2] = 1;
+  psnip_bitset_iter_init(&iter, words, 3);
+  munit_assert_size(psnip_bitset_iter_next(&iter, out, 128), ==, 2);
+  munit_assert_uint32(out[0], ==, 63);
+  munit_assert_uint32(out[1], ==, 128);
+  munit_assert_size(psnip_bitset_iter_next(&iter, out, 128), ==, 0);
+
+  /* Once there are fewer than 64 free slots the batch ends early,
+   * leaving the next word for the next call. */
+  psnip_bitset_iter_init(&iter, words, 3);
+  munit_assert_size(psnip_bitset_iter_next(&iter, out, 64), ==, 1);
+  munit_assert_uint32(out[0], ==, 63);
+  munit_assert_size(psnip_bitset_iter_next(&iter, out, 64), ==, 1);
+  munit_assert_uint32(out[0], ==, 128);
+
+  /* With less than 64 it goes a bit at a time. */
+  words[0] = 7;
+  psnip_bitset_iter_init(&iter, words, 3);
+  munit_assert_size(psnip_bitset_iter_next(&iter, out, 2), ==, 2);
+  munit_assert_uint32(out[1], ==, 1);
+  munit_assert_size(psnip_bitset_iter_next(&iter, out, 2), ==, 2);
+  munit_assert_uint32(out[0], ==, 2);
+  munit_assert_uint32(out[1], ==, 128);
+
+  return MUNIT_OK;
+}
+
+/* Compare each way of decoding a word the CPU supports. */
+static MunitResult
+test_bitset_word(const MunitParameter params[], void* data) {
+  psnip_uint32_t expected[64], actual[64];
+  psnip_uint64_t w;
+  size_t i, n;
+  int b;
+
+  (void) params;
+  (void) data;
+
+#if defined(PSNIP_BITSET__AVX512) && !defined(__AVX512F__)
+  /* The cached answer psnip_bitset_iter_next goes by. */
+  munit_assert_int(psnip_bitset__avx512_usable(), ==, psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX512F));
+  munit_assert_int(psnip_bitset__avx512_usable(), ==, psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX512F));
+#endif
+
+  for (i = 0 ; i < 1024 ; i++) {
+    munit_rand_memory(sizeof(w), (psnip_uint8_t*) &w);
+    if (i & 1)
+      w &= (psnip_uint64_t) munit_rand_uint32() << (i % 32);
+
+    n = 0;
+    for (b = 0 ; b < 64 ; b++)
+      if ((w >> b) & 1)
+        expected[n++] = (psnip_uint32_t) (b + 4096);
+
+    munit_assert_size(psnip_bitset__decode_word_portable(w, 4096, actual), ==, n);
+    munit_assert_memory_equal(n * sizeof(psnip_uint32_t), actual, expected);
+#if defined(PSNIP_BITSET__AVX512)
+    if (psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX512F)) {
+      munit_assert_size(psnip_bitset__decode_word_avx512(w, 4096, actual), ==, n);
+      munit_assert_memory_equal(n * sizeof(psnip_uint32_t), actual, expected);
+    }
+#endif
+  }
+
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+  { (char*) "/bitset/iter",  test_bitset_iter,  NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/bitset/edges", test_bitset_edges, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/bitset/word",  test_bitset_word,  NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
+};
+
+static const MunitSuite test_suite = {
+  (char*) "", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE
+};
+
+int main(int argc, char* argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
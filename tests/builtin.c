@@ -1,9 +1,11 @@
 #include <stdlib.h>
 #include <limits.h>
+#include <string.h>
 
 #include "munit/munit.h"
 
 #include "../exact-int/exact-int.h"
+#include "../cpu/cpu.h"
 
 #define PSNIP_BUILTIN_EMULATE_NATIVE
 #include "../builtin/builtin.h"
@@ -23,6 +25,9 @@
 #if !defined(UINT64_C)
 #  define UINT64_C(c) c ## ULL
 #endif
+#if !defined(INT64_C)
+#  define INT64_C(c) c ## LL
+#endif
 
 static MunitResult
 test_gnu_ffs(const MunitParameter params[], void* data) {
@@ -394,6 +399,85 @@ test_gnu_popcountll(const MunitParameter params[], void* data) {
   return MUNIT_OK;
 }
 
+static psnip_uint64_t
+popcount_array_naive(const unsigned char* data, size_t size) {
+  psnip_uint64_t r = 0;
+  size_t i;
+  unsigned char c;
+
+  for (i = 0 ; i < size ; i++)
+    for (c = data[i] ; c != 0 ; c &= (unsigned char) (c - 1))
+      r++;
+
+  return r;
+}
+
+static MunitResult
+test_gnu_popcount_array(const MunitParameter params[], void* data) {
+  static unsigned char buf[4096 + 64];
+  size_t i, offset, size;
+  psnip_uint64_t expected;
+
+  (void) params;
+  (void) data;
+
+  munit_assert_uint64(psnip_builtin_popcount_array(buf, 0), ==, 0);
+
+  memset(buf, 0xff, sizeof(buf));
+  munit_assert_uint64(psnip_builtin_popcount_array(buf, sizeof(buf)), ==, (psnip_uint64_t) sizeof(buf) * 8);
+
+  munit_rand_memory(sizeof(buf), buf);
+  for (i = 0 ; i < 256 ; i++) {
+    /* Cover every vector loop and tail, at any alignment. */
+    offset = (size_t) munit_rand_int_range(0, 63);
+    size = (i < 128) ? i : (size_t) munit_rand_int_range(0, 4096);
+    expected = popcount_array_naive(buf + offset, size);
+
+    munit_assert_uint64(psnip_builtin_popcount_array(buf + offset, size), ==, expected);
+    munit_assert_uint64(psnip_builtin__popcount_array_portable(buf + offset, size), ==, expected);
+#if defined(PSNIP_BUILTIN__POPCOUNT_AVX2)
+    if (psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX2))
+      munit_assert_uint64(psnip_builtin__popcount_array_avx2(buf + offset, size), ==, expected);
+#endif
+#if defined(PSNIP_BUILTIN__POPCOUNT_AVX512)
+    if (psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX512VPOPCNTDQ))
+      munit_assert_uint64(psnip_builtin__popcount_array_avx512(buf + offset, size), ==, expected);
+#endif
+#if defined(PSNIP_BUILTIN__POPCOUNT_NEON)
+    munit_assert_uint64(psnip_builtin__popcount_array_neon(buf + offset, size), ==, expected);
+#endif
+  }
+
+  return MUNIT_OK;
+}
+
+/* cpu.h is included, so the fastest version the CPU and OS support
+ * should be picked even if the compiler isn't targeting it. */
+static MunitResult
+test_gnu_popcount_array_select(const MunitParameter params[], void* data) {
+  psnip_builtin__popcount_array_func expected = psnip_builtin__popcount_array_portable;
+
+  (void) params;
+  (void) data;
+
+#if defined(PSNIP_BUILTIN__POPCOUNT_NEON)
+  expected = psnip_builtin__popcount_array_neon;
+#endif
+#if defined(PSNIP_BUILTIN__POPCOUNT_AVX2)
+  if (psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX2))
+    expected = psnip_builtin__popcount_array_avx2;
+#endif
+#if defined(PSNIP_BUILTIN__POPCOUNT_AVX512)
+  if (psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX512F) &&
+      psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX512VPOPCNTDQ))
+    expected = psnip_builtin__popcount_array_avx512;
+#endif
+
+  munit_assert(psnip_builtin__popcount_array_select() == expected);
+
+  return MUNIT_OK;
+}
+
 static MunitResult
 test_gnu_clrsb(const MunitParameter params[], void* data) {
   unsigned int v = ~0U;
@@ -1521,6 +1605,105 @@ test_msvc_shiftright128(const MunitParameter params[], void* data) {
   return MUNIT_OK;
 }
 
+/* a * b = (h << 64) | l */
+static const struct { psnip_uint64_t a; psnip_uint64_t b; psnip_uint64_t h; psnip_uint64_t l; } test_umul128_vec[] = {
+  { UINT64_C(0xffffffffffffffff), UINT64_C(0xffffffffffffffff), UINT64_C(0xfffffffffffffffe), UINT64_C(0x0000000000000001) },
+  { UINT64_C(0x0000000000000000), UINT64_C(0xffffffffffffffff), UINT64_C(0x0000000000000000), UINT64_C(0x0000000000000000) },
+  { UINT64_C(0x0000000000000001), UINT64_C(0xffffffffffffffff), UINT64_C(0x0000000000000000), UINT64_C(0xffffffffffffffff) },
+  { UINT64_C(0x00000000ffffffff), UINT64_C(0x00000000ffffffff), UINT64_C(0x0000000000000000), UINT64_C(0xfffffffe00000001) },
+  { UINT64_C(0x0000000100000000), UINT64_C(0x0000000100000000), UINT64_C(0x0000000000000001), UINT64_C(0x0000000000000000) },
+  { UINT64_C(0x8000000000000000), UINT64_C(0x0000000000000002), UINT64_C(0x0000000000000001), UINT64_C(0x0000000000000000) },
+  { UINT64_C(0x50c191728c541241), UINT64_C(0x8e91579a21c3a39e), UINT64_C(0x2cf937f3533e3526), UINT64_C(0x0703808a6c05a71e) },
+  { UINT64_C(0x88e7e802b627ef1d), UINT64_C(0xcb0cad1e4d604263), UINT64_C(0x6c96ac6df2ea7526), UINT64_C(0x16ee5c4e20f6f237) },
+  { UINT64_C(0x815c2a41f03615cb), UINT64_C(0xb6c006b43155fd43), UINT64_C(0x5c588e8dc8f3f5b7), UINT64_C(0x6c8b6a8469185321) },
+  { UINT64_C(0x6f945d78c3117314), UINT64_C(0x27969b142a677c0b), UINT64_C(0x11413ec3c924d264), UINT64_C(0x5bfff5236a89a1dc) },
+  { UINT64_C(0xce8b1ad2f7517cbc), UINT64_C(0xa8490f89dfa4ccb4), UINT64_C(0x87c63bce7be9da1f), UINT64_C(0x1a4c29e281218430) },
+  { UINT64_C(0x7e3a82b21b8666f7), UINT64_C(0x386c206fa6399a75), UINT64_C(0x1bd21d4476d449d3), UINT64_C(0xaf37acbf855ca4e3) },
+  { UINT64_C(0xc323a6a737d214f4), UINT64_C(0x8e7af51f82f83e7a), UINT64_C(0x6c9b8047504bad33), UINT64_C(0x2276bae9af911448) },
+  { UINT64_C(0x8232a8ddd9adef0e), UINT64_C(0x78c71ee427a88c33), UINT64_C(0x3d6d043f3b9193a1), UINT64_C(0xe6ffdd457f9247ca) },
+  { UINT64_C(0x0727ba0237942916), UINT64_C(0x6c7cac7212c4ff1d), UINT64_C(0x03083e88e9b60c0d), UINT64_C(0x6da053bbe18d917e) },
+  { UINT64_C(0x21e919461041dfb6), UINT64_C(0xac1981697fb70096), UINT64_C(0x16cbfde2fa0665e9), UINT64_C(0xaf4093c5bbb314a4) }
+};
+
+static const struct { psnip_int64_t a; psnip_int64_t b; psnip_int64_t h; psnip_int64_t l; } test_mul128_vec[] = {
+  { -INT64_C(0x0000000000000001), -INT64_C(0x0000000000000001), INT64_C(0x0000000000000000), INT64_C(0x0000000000000001) },
+  { -INT64_C(0x0000000000000001), INT64_C(0x0000000000000001), -INT64_C(0x0000000000000001), -INT64_C(0x0000000000000001) },
+  { (-INT64_C(0x7fffffffffffffff) - 1), (-INT64_C(0x7fffffffffffffff) - 1), INT64_C(0x4000000000000000), INT64_C(0x0000000000000000) },
+  { (-INT64_C(0x7fffffffffffffff) - 1), INT64_C(0x7fffffffffffffff), -INT64_C(0x4000000000000000), (-INT64_C(0x7fffffffffffffff) - 1) },
+  { INT64_C(0x7fffffffffffffff), INT64_C(0x7fffffffffffffff), INT64_C(0x3fffffffffffffff), INT64_C(0x0000000000000001) },
+  { -INT64_C(0x0000000000000003), INT64_C(0x0000000000000005), -INT64_C(0x0000000000000001), -INT64_C(0x000000000000000f) },
+  { -INT64_C(0x0ca13444d6435ac4), INT64_C(0x0e7d56b620fb877b), -INT64_C(0x00b6ffd96d1f260b), INT64_C(0x13a0b7350a9a07d4) },
+  { -INT64_C(0x73ad3dea4d465cd1), -INT64_C(0x1047b80bb54fb476), INT64_C(0x075b3c149faf65b4), -INT64_C(0x67f8ea597ecf43aa) },
+  { -INT64_C(0x4d222826a9318d7c), INT64_C(0x1847b9c15676dc9c), -INT64_C(0x0750d034b2671121), -INT64_C(0x14f899d08ef0c790) },
+  { INT64_C(0x3d13adc3d7748e5e), INT64_C(0x43d7f5d7459c3ae4), INT64_C(0x102faca8624c64b3), INT64_C(0x31645d94635817b8) },
+  { INT64_C(0x03b8225aa5e70e1e), -INT64_C(0x1e47a1be1070da6a), -INT64_C(0x00709e71b716be3b), INT64_C(0x16ca36f47f2e9b94) },
+  { -INT64_C(0x19ebfa866dc9c682), -INT64_C(0x5e60b01cb7932707), INT64_C(0x098e7050735bab47), -INT64_C(0x7c6a4d9d5797c472) },
+  { INT64_C(0x5a3602bf23600926), INT64_C(0x6fffbd3ea71d5d7a), INT64_C(0x277789ad90ba3ce2), -INT64_C(0x54ab54026d9ad5e4) },
+  { INT64_C(0x333052252cf53508), -INT64_C(0x347b9c3a9926d8f3), -INT64_C(0x0a7e88242e9f520e), -INT64_C(0x7c47742038b01698) },
+  { -INT64_C(0x27200b2d2f504de4), -INT64_C(0x6454a20037acc60b), INT64_C(0x0f5573a3a0e3c6ea), INT64_C(0x1ea5c03975e1b0cc) },
+  { INT64_C(0x06cfb25346fa25c8), INT64_C(0x18f87d2d5dc8ff95), INT64_C(0x00aa15412e680503), INT64_C(0x63875d7aa77a3568) }
+};
+
+static MunitResult
+test_msvc_umul128(const MunitParameter params[], void* data) {
+  size_t i;
+  psnip_uint64_t h, l;
+
+  (void) params;
+  (void) data;
+
+  for (i = 0 ; i < (sizeof(test_umul128_vec) / sizeof(test_umul128_vec[0])) ; i++) {
+    l = psnip_intrin_umul128(test_umul128_vec[i].a, test_umul128_vec[i].b, &h);
+    munit_assert_uint64(h, ==, test_umul128_vec[i].h);
+    munit_assert_uint64(l, ==, test_umul128_vec[i].l);
+  }
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_msvc_mul128(const MunitParameter params[], void* data) {
+  size_t i;
+  psnip_int64_t h, l;
+
+  (void) params;
+  (void) data;
+
+  for (i = 0 ; i < (sizeof(test_mul128_vec) / sizeof(test_mul128_vec[0])) ; i++) {
+    l = psnip_intrin_mul128(test_mul128_vec[i].a, test_mul128_vec[i].b, &h);
+    munit_assert_int64(h, ==, test_mul128_vec[i].h);
+    munit_assert_int64(l, ==, test_mul128_vec[i].l);
+  }
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_msvc_umulh(const MunitParameter params[], void* data) {
+  size_t i;
+
+  (void) params;
+  (void) data;
+
+  for (i = 0 ; i < (sizeof(test_umul128_vec) / sizeof(test_umul128_vec[0])) ; i++)
+    munit_assert_uint64(psnip_intrin_umulh(test_umul128_vec[i].a, test_umul128_vec[i].b), ==, test_umul128_vec[i].h);
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_msvc_mulh(const MunitParameter params[], void* data) {
+  size_t i;
+
+  (void) params;
+  (void) data;
+
+  for (i = 0 ; i < (sizeof(test_mul128_vec) / sizeof(test_mul128_vec[0])) ; i++)
+    munit_assert_int64(psnip_intrin_mulh(test_mul128_vec[i].a, test_mul128_vec[i].b), ==, test_mul128_vec[i].h);
+
+  return MUNIT_OK;
+}
+
 static MunitResult
 test_msvc_byteswap_ushort(const MunitParameter params[], void* data) {
   psnip_uint16_t v = (psnip_uint16_t) 0xAABBULL;
@@ -1582,6 +1765,8 @@ static MunitTest test_suite_tests[] = {
   PSNIP_TEST_BUILTIN(popcount),
   PSNIP_TEST_BUILTIN(popcountl),
   PSNIP_TEST_BUILTIN(popcountll),
+  PSNIP_TEST_BUILTIN(popcount_array),
+  PSNIP_TEST_BUILTIN(popcount_array_select),
   PSNIP_TEST_BUILTIN(clrsb),
   PSNIP_TEST_BUILTIN(clrsbl),
   PSNIP_TEST_BUILTIN(clrsbll),
@@ -1624,6 +1809,10 @@ static MunitTest test_suite_tests[] = {
   PSNIP_TEST_INTRIN(bittestandset64),
   PSNIP_TEST_INTRIN(shiftleft128),
   PSNIP_TEST_INTRIN(shiftright128),
+  PSNIP_TEST_INTRIN(umul128),
+  PSNIP_TEST_INTRIN(mul128),
+  PSNIP_TEST_INTRIN(umulh),
+  PSNIP_TEST_INTRIN(mulh),
   PSNIP_TEST_INTRIN(byteswap_ushort),
   PSNIP_TEST_INTRIN(byteswap_ulong),
   PSNIP_TEST_INTRIN(byteswap_uint64),
@@ -0,0 +1,58 @@
+/* Measure the real cost and granularity of each clock.
+ *
+ * The method used for each clock type is chosen at compile time, so
+ * this is built several times with different PSNIP_CLOCK_*_METHOD
+ * overrides to cover the methods available on the host. */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "../exact-int/exact-int.h"
+#include "../clock/clock.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+
+static const char*
+method_name (int method) {
+  switch (method) {
+    case PSNIP_CLOCK_METHOD_CLOCK_GETTIME:                  return "clock_gettime";
+    case PSNIP_CLOCK_METHOD_TIME:                           return "time";
+    case PSNIP_CLOCK_METHOD_GETTIMEOFDAY:                   return "gettimeofday";
+    case PSNIP_CLOCK_METHOD_QUERYPERFORMANCECOUNTER:        return "QueryPerformanceCounter";
+    case PSNIP_CLOCK_METHOD_MACH_ABSOLUTE_TIME:             return "mach_absolute_time";
+    case PSNIP_CLOCK_METHOD_CLOCK:                          return "clock";
+    case PSNIP_CLOCK_METHOD_GETPROCESSTIMES:                return "GetProcessTimes";
+    case PSNIP_CLOCK_METHOD_GETRUSAGE:                      return "getrusage";
+    case PSNIP_CLOCK_METHOD_GETSYSTEMTIMEPRECISEASFILETIME: return "GetSystemTimePreciseAsFileTime";
+    case PSNIP_CLOCK_METHOD_GETTICKCOUNT64:                 return "GetTickCount64";
+    case PSNIP_CLOCK_METHOD_MACH_CONTINUOUS_TIME:           return "mach_continuous_time";
+    default:                                                return "unavailable";
+  }
+}
+
+static void
+bench_clock (const char* name, enum PsnipClockType clock_type) {
+  struct PsnipClockCalibration cal;
+  int r;
+
+  r = psnip_clock_calibrate (clock_type, &cal);
+  if (r != 0) {
+    printf ("%-10s %-32s (error %d)\n", name, method_name (psnip_clock_get_method (clock_type)), r);
+    return;
+  }
+
+  printf ("%-10s %-32s %12" PRIu32 " %10" PRIu64 " %12" PRIu64 "\n",
+          name, method_name (cal.method), (uint32_t) cal.precision,
+          (uint64_t) cal.call_ns, (uint64_t) cal.min_delta_ns);
+}
+
+int
+main (void) {
+  printf ("%-10s %-32s %12s %10s %12s\n", "clock", "method", "ticks/sec", "ns/call", "min step ns");
+  bench_clock ("wall",      PSNIP_CLOCK_TYPE_WALL);
+  bench_clock ("cpu",       PSNIP_CLOCK_TYPE_CPU);
+  bench_clock ("monotonic", PSNIP_CLOCK_TYPE_MONOTONIC);
+  bench_clock ("boottime",  PSNIP_CLOCK_TYPE_BOOTTIME);
+
+  return 0;
+}
@@ -0,0 +1,141 @@
+#if !defined(_POSIX_C_SOURCE)
+#  define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "../exact-int/exact-int.h"
+#include "../clock/clock.hpp"
+#include "munit/munit.h"
+
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <type_traits>
+
+template <typename Clock>
+static typename Clock::duration
+time_sleep (std::chrono::milliseconds ms) {
+  const typename Clock::time_point start = Clock::now();
+  std::this_thread::sleep_for(ms);
+  return Clock::now() - start;
+}
+
+static MunitResult
+test_clock_cpp_wall(const MunitParameter params[], void* data) {
+#if defined(PSNIP_CLOCK_WALL_METHOD)
+  typedef psnip::clock::wall_clock clock;
+
+  (void) params;
+  (void) data;
+
+  static_assert(!clock::is_steady, "wall clock must not be steady");
+  static_assert(std::is_same<psnip::clock::clock_for<PSNIP_CLOCK_TYPE_WALL>::type, clock>::value, "clock_for mismatch");
+  munit_assert_int(clock::method, ==, PSNIP_CLOCK_WALL_METHOD);
+
+  /* Should agree with time(). */
+  const long long ours = (long long) std::chrono::duration_cast<std::chrono::seconds>(clock::now().time_since_epoch()).count();
+  const long long t = (long long) time(NULL);
+  munit_assert_llong(ours - t, >=, -1);
+  munit_assert_llong(ours - t, <=,  1);
+
+  return MUNIT_OK;
+#else
+  (void) params;
+  (void) data;
+
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_clock_cpp_monotonic(const MunitParameter params[], void* data) {
+#if defined(PSNIP_CLOCK_MONOTONIC_METHOD)
+  typedef psnip::clock::monotonic_clock clock;
+
+  (void) params;
+  (void) data;
+
+  static_assert(clock::is_steady, "monotonic clock must be steady");
+  static_assert(std::is_same<psnip::clock::clock_for<PSNIP_CLOCK_TYPE_MONOTONIC>::type, clock>::value, "clock_for mismatch");
+  munit_assert_int(clock::method, ==, PSNIP_CLOCK_MONOTONIC_METHOD);
+
+  const long long elapsed = (long long) std::chrono::duration_cast<std::chrono::milliseconds>(time_sleep<clock>(std::chrono::milliseconds(100))).count();
+  munit_assert_llong(elapsed, >=,  99);
+  munit_assert_llong(elapsed, <,  200);
+
+  return MUNIT_OK;
+#else
+  (void) params;
+  (void) data;
+
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_clock_cpp_boottime(const MunitParameter params[], void* data) {
+#if defined(PSNIP_CLOCK_BOOTTIME_METHOD)
+  typedef psnip::clock::boottime_clock clock;
+
+  (void) params;
+  (void) data;
+
+  static_assert(clock::is_steady, "boottime clock must be steady");
+  munit_assert_int(clock::method, ==, PSNIP_CLOCK_BOOTTIME_METHOD);
+
+  const long long elapsed = (long long) std::chrono::duration_cast<std::chrono::milliseconds>(time_sleep<clock>(std::chrono::milliseconds(100))).count();
+  munit_assert_llong(elapsed, >=,  99);
+  munit_assert_llong(elapsed, <,  200);
+
+  return MUNIT_OK;
+#else
+  (void) params;
+  (void) data;
+
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_clock_cpp_cpu(const MunitParameter params[], void* data) {
+#if defined(PSNIP_CLOCK_CPU_METHOD)
+  typedef psnip::clock::cpu_clock clock;
+  volatile unsigned int x = 0;
+
+  (void) params;
+  (void) data;
+
+  static_assert(!clock::is_steady, "CPU clock must not be steady");
+  munit_assert_int(clock::method, ==, PSNIP_CLOCK_CPU_METHOD);
+
+  /* Sleeping shouldn't use (much) CPU time, but spinning should. */
+  munit_assert_llong((long long) std::chrono::duration_cast<std::chrono::milliseconds>(time_sleep<clock>(std::chrono::milliseconds(100))).count(), <, 50);
+
+  const clock::time_point start = clock::now();
+  while ((clock::now() - start) < std::chrono::milliseconds(10))
+    x++;
+  munit_assert_uint(x, >, 0);
+
+  return MUNIT_OK;
+#else
+  (void) params;
+  (void) data;
+
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitTest test_suite_tests[] = {
+  { (char*) "/clock-cpp/wall",      test_clock_cpp_wall,      NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/clock-cpp/monotonic", test_clock_cpp_monotonic, NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/clock-cpp/boottime",  test_clock_cpp_boottime,  NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/clock-cpp/cpu",       test_clock_cpp_cpu,       NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
+};
+
+static const MunitSuite test_suite = {
+  (char*) "", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE
+};
+
+int main(int argc, char* argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
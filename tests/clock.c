@@ -1,4 +1,4 @@
-#define _POSIX_C_SOURCE 199309L
+#define _POSIX_C_SOURCE 200112L
 
 #include "../exact-int/exact-int.h"
 #include "../clock/clock.h"
@@ -9,10 +9,13 @@
 
 #if !defined(_WIN32)
 #  include <unistd.h>
+#  include <time.h>
 #  define sleep_seconds(n) sleep(n)
+#  define sleep_msec(n) do { struct timespec ts_ = { 0, (n) * 1000000L }; nanosleep(&ts_, NULL); } while (0)
 #else
 #  include <Windows.h>
 #  define sleep_seconds(n) Sleep((n) * 1000)
+#  define sleep_msec(n) Sleep(n)
 #endif
 
 static MunitResult
@@ -158,11 +161,265 @@ test_clock_monotonic(const MunitParameter params[], void* data) {
 #endif
 }
 
+static MunitResult
+test_clock_boottime(const MunitParameter params[], void* data) {
+#if defined(PSNIP_CLOCK_BOOTTIME_METHOD)
+  struct PsnipClockTimespec res1, res2;
+  psnip_uint64_t boot, mono;
+  int r;
+  int elapsed_ms;
+
+  (void) params;
+  (void) data;
+
+  munit_logf(MUNIT_LOG_DEBUG, "Boottime clock method: %d", PSNIP_CLOCK_BOOTTIME_METHOD);
+  munit_assert_uint32(psnip_clock_get_precision(PSNIP_CLOCK_TYPE_BOOTTIME), >, 0);
+
+  r = psnip_clock_get_time(PSNIP_CLOCK_TYPE_BOOTTIME, &res1);
+  munit_assert_int(r, ==, 0);
+
+  sleep_msec(100);
+
+  r = psnip_clock_get_time(PSNIP_CLOCK_TYPE_BOOTTIME, &res2);
+  munit_assert_int(r, ==, 0);
+
+  elapsed_ms = ts_difference(&res1, &res2);
+
+  munit_assert_int(elapsed_ms, >=,  90);
+  munit_assert_int(elapsed_ms, <,  200);
+
+#if defined(PSNIP_CLOCK_MONOTONIC_METHOD) && \
+  (PSNIP_CLOCK_MONOTONIC_METHOD == PSNIP_CLOCK_METHOD_CLOCK_GETTIME) && \
+  (PSNIP_CLOCK_BOOTTIME_METHOD == PSNIP_CLOCK_METHOD_CLOCK_GETTIME)
+  /* Boot time is monotonic time plus time spent suspended. */
+  r = psnip_clock_get_time_ns(PSNIP_CLOCK_TYPE_MONOTONIC, &mono);
+  munit_assert_int(r, ==, 0);
+  r = psnip_clock_get_time_ns(PSNIP_CLOCK_TYPE_BOOTTIME, &boot);
+  munit_assert_int(r, ==, 0);
+  munit_assert_uint64(boot, >=, mono);
+#else
+  (void) boot;
+  (void) mono;
+#endif
+
+  return MUNIT_OK;
+#else
+  struct PsnipClockTimespec res;
+
+  (void) params;
+  (void) data;
+
+  munit_assert_int(psnip_clock_get_time(PSNIP_CLOCK_TYPE_BOOTTIME, &res), ==, -2);
+
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_clock_ns(const MunitParameter params[], void* data) {
+#if defined(PSNIP_CLOCK_MONOTONIC_METHOD)
+  struct PsnipClockTimespec ts;
+  psnip_uint64_t ns, ts_ns;
+  int r;
+
+  r = psnip_clock_get_time(PSNIP_CLOCK_TYPE_MONOTONIC, &ts);
+  munit_assert_int(r, ==, 0);
+  r = psnip_clock_get_time_ns(PSNIP_CLOCK_TYPE_MONOTONIC, &ns);
+  munit_assert_int(r, ==, 0);
+
+  ts_ns = (ts.seconds * 1000000000ULL) + ts.nanoseconds;
+  munit_assert_uint64(ns, >=, ts_ns);
+  munit_assert_uint64(ns - ts_ns, <, 100 * 1000000ULL);
+
+  (void) params;
+  (void) data;
+
+  return MUNIT_OK;
+#else
+  (void) params;
+  (void) data;
+
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_clock_sleep_until(const MunitParameter params[], void* data) {
+#if defined(PSNIP_CLOCK_MONOTONIC_METHOD)
+  struct PsnipClockTimespec deadline;
+  psnip_uint64_t start, end, target;
+  int r;
+
+  (void) params;
+  (void) data;
+
+  r = psnip_clock_get_time_ns(PSNIP_CLOCK_TYPE_MONOTONIC, &start);
+  munit_assert_int(r, ==, 0);
+
+  target = start + (50 * 1000000ULL);
+  deadline.seconds = target / 1000000000ULL;
+  deadline.nanoseconds = target % 1000000000ULL;
+
+  r = psnip_clock_sleep_until(PSNIP_CLOCK_TYPE_MONOTONIC, &deadline);
+  munit_assert_int(r, ==, 0);
+  r = psnip_clock_get_time_ns(PSNIP_CLOCK_TYPE_MONOTONIC, &end);
+  munit_assert_int(r, ==, 0);
+
+  munit_assert_uint64(end, >=, target);
+  munit_assert_uint64(end - target, <, 50 * 1000000ULL);
+
+  /* Deadlines in the past return immediately. */
+  r = psnip_clock_sleep_until(PSNIP_CLOCK_TYPE_MONOTONIC, &deadline);
+  munit_assert_int(r, ==, 0);
+
+  munit_assert_int(psnip_clock_sleep_until(PSNIP_CLOCK_TYPE_CPU, &deadline), ==, -2);
+
+  return MUNIT_OK;
+#else
+  (void) params;
+  (void) data;
+
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_clock_sleep_until_spin(const MunitParameter params[], void* data) {
+#if defined(PSNIP_CLOCK_MONOTONIC_METHOD)
+  struct PsnipClockTimespec deadline;
+  psnip_uint64_t start, end, target;
+  int r;
+
+  (void) params;
+  (void) data;
+
+  r = psnip_clock_get_time_ns(PSNIP_CLOCK_TYPE_MONOTONIC, &start);
+  munit_assert_int(r, ==, 0);
+
+  target = start + (20 * 1000000ULL);
+  deadline.seconds = target / 1000000000ULL;
+  deadline.nanoseconds = target % 1000000000ULL;
+
+  r = psnip_clock_sleep_until_spin(PSNIP_CLOCK_TYPE_MONOTONIC, &deadline, 2 * 1000000ULL);
+  munit_assert_int(r, ==, 0);
+  r = psnip_clock_get_time_ns(PSNIP_CLOCK_TYPE_MONOTONIC, &end);
+  munit_assert_int(r, ==, 0);
+
+  munit_assert_uint64(end, >=, target);
+  munit_assert_uint64(end - target, <, 20 * 1000000ULL);
+
+  return MUNIT_OK;
+#else
+  (void) params;
+  (void) data;
+
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_clock_calibrate(const MunitParameter params[], void* data) {
+#if defined(PSNIP_CLOCK_MONOTONIC_METHOD)
+  struct PsnipClockCalibration cal;
+  int r;
+
+  (void) params;
+  (void) data;
+
+  r = psnip_clock_calibrate(PSNIP_CLOCK_TYPE_MONOTONIC, &cal);
+  munit_assert_int(r, ==, 0);
+
+  munit_logf(MUNIT_LOG_DEBUG, "Monotonic clock: %" PRIu64 " ns/call, %" PRIu64 " ns min. step",
+             (uint64_t) cal.call_ns, (uint64_t) cal.min_delta_ns);
+
+  munit_assert_int(cal.method, ==, PSNIP_CLOCK_MONOTONIC_METHOD);
+  munit_assert_uint32(cal.precision, ==, psnip_clock_get_precision(PSNIP_CLOCK_TYPE_MONOTONIC));
+  munit_assert_uint64(cal.call_ns, <, 1000000);
+  munit_assert_uint64(cal.min_delta_ns, >, 0);
+  munit_assert_uint64(cal.min_delta_ns, <, 20 * 1000000ULL);
+
+  return MUNIT_OK;
+#else
+  (void) params;
+  (void) data;
+
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_clock_wall_cache(const MunitParameter params[], void* data) {
+#if defined(PSNIP_CLOCK_WALL_METHOD)
+  struct PsnipClockWallCache cache;
+  psnip_uint64_t ticks[64], stamps[64], before, after, cached;
+  size_t i;
+  int r;
+
+  (void) params;
+  (void) data;
+
+  /* We need to be able to compare against the real thing. */
+  if (psnip_clock_get_precision(PSNIP_CLOCK_TYPE_WALL) < 1000)
+    return MUNIT_SKIP;
+
+  r = psnip_clock_wall_cache_init(&cache, 10 * 1000000ULL);
+  munit_assert_int(r, ==, 0);
+
+  /* Cached times should stay within a millisecond of the real clock,
+   * across several refreshes. */
+  for (i = 0 ; i < 50 ; i++) {
+    r = psnip_clock_get_time_ns(PSNIP_CLOCK_TYPE_WALL, &before);
+    munit_assert_int(r, ==, 0);
+    r = psnip_clock_wall_cache_now(&cache, &cached);
+    munit_assert_int(r, ==, 0);
+    r = psnip_clock_get_time_ns(PSNIP_CLOCK_TYPE_WALL, &after);
+    munit_assert_int(r, ==, 0);
+
+    munit_assert_uint64(cached + 1000000, >=, before);
+    munit_assert_uint64(cached, <=, after + 1000000);
+
+    sleep_msec(1);
+  }
+
+  /* Capture ticks, then convert them in one go. */
+  r = psnip_clock_get_time_ns(PSNIP_CLOCK_TYPE_WALL, &before);
+  munit_assert_int(r, ==, 0);
+  for (i = 0 ; i < (sizeof(ticks) / sizeof(ticks[0])) ; i++)
+    ticks[i] = psnip_clock_ticks();
+  r = psnip_clock_get_time_ns(PSNIP_CLOCK_TYPE_WALL, &after);
+  munit_assert_int(r, ==, 0);
+
+  r = psnip_clock_wall_cache_refresh(&cache);
+  munit_assert_int(r, ==, 0);
+  psnip_clock_wall_cache_convert_batch(&cache, ticks, stamps, sizeof(ticks) / sizeof(ticks[0]));
+
+  for (i = 0 ; i < (sizeof(ticks) / sizeof(ticks[0])) ; i++) {
+    munit_assert_uint64(stamps[i] + 1000000, >=, before);
+    munit_assert_uint64(stamps[i], <=, after + 1000000);
+    if (i != 0)
+      munit_assert_uint64(stamps[i], >=, stamps[i - 1]);
+  }
+
+  return MUNIT_OK;
+#else
+  (void) params;
+  (void) data;
+
+  return MUNIT_SKIP;
+#endif
+}
+
 static MunitTest test_suite_tests[] = {
   { (char*) "/clock/wall/time",     test_clock_wall_time,     NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
   { (char*) "/clock/wall/veracity", test_clock_wall_veracity, NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
   { (char*) "/clock/cpu",           test_clock_cpu,           NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
   { (char*) "/clock/monotonic",     test_clock_monotonic,     NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/clock/boottime",      test_clock_boottime,      NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/clock/ns",            test_clock_ns,            NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/clock/sleep/until",   test_clock_sleep_until,   NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/clock/sleep/spin",    test_clock_sleep_until_spin, NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/clock/calibrate",     test_clock_calibrate,     NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/clock/wall/cache",    test_clock_wall_cache,    NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
   { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
 };
 
@@ -0,0 +1,101 @@
+#if defined(PSNIP_ENABLE_PTHREADS)
+#  include <pthread.h>
+#endif
+#include "../exact-int/exact-int.h"
+#include "../counter/counter.h"
+#include "munit/munit.h"
+
+static MunitResult
+test_counter_basic(const MunitParameter params[], void* data) {
+  static struct PsnipCounter counter;
+  psnip_int64_t expected = 0, v;
+  int i;
+
+  (void) params;
+  (void) data;
+
+  /* Each slot gets a cache line to itself. */
+  munit_assert_size(sizeof(counter), >=, (size_t) PSNIP_COUNTER_SHARDS * PSNIP_CACHE_LINE_SIZE);
+#if defined(__GNUC__) || defined(_MSC_VER)
+  munit_assert_size(((size_t) &(counter.shards[1].value)) % PSNIP_CACHE_LINE_SIZE, ==, 0);
+#endif
+
+  psnip_counter_init(&counter);
+  munit_assert_int64(psnip_counter_read(&counter), ==, 0);
+
+  for (i = 0 ; i < 1000 ; i++) {
+    v = (psnip_int64_t) munit_rand_int_range(-1000, 1000);
+    psnip_counter_add(&counter, v);
+    expected += v;
+  }
+  munit_assert_int64(psnip_counter_read(&counter), ==, expected);
+
+  munit_assert_int64(psnip_counter_read_and_reset(&counter), ==, expected);
+  munit_assert_int64(psnip_counter_read(&counter), ==, 0);
+
+  return MUNIT_OK;
+}
+
+#if defined(PSNIP_ENABLE_PTHREADS)
+
+#define COUNTER_THREADS 8
+#define COUNTER_ITERATIONS 100000
+
+static struct PsnipCounter shared_counter;
+
+static void*
+counter_thread(void* arg) {
+  int i;
+
+  (void) arg;
+
+  for (i = 0 ; i < COUNTER_ITERATIONS ; i++)
+    psnip_counter_add(&shared_counter, 1);
+
+  return NULL;
+}
+
+static MunitResult
+test_counter_threads(const MunitParameter params[], void* data) {
+  pthread_t threads[COUNTER_THREADS];
+  psnip_int64_t total = 0;
+  size_t i;
+
+  (void) params;
+  (void) data;
+
+  psnip_counter_init(&shared_counter);
+  for (i = 0 ; i < COUNTER_THREADS ; i++)
+    munit_assert_int(pthread_create(&(threads[i]), NULL, counter_thread, NULL), ==, 0);
+
+  /* Reading and resetting while the threads are running mustn't lose
+   * anything. */
+  for (i = 0 ; i < 100 ; i++)
+    total += psnip_counter_read_and_reset(&shared_counter);
+
+  for (i = 0 ; i < COUNTER_THREADS ; i++)
+    pthread_join(threads[i], NULL);
+  total += psnip_counter_read(&shared_counter);
+
+  munit_assert_int64(total, ==, (psnip_int64_t) COUNTER_THREADS * COUNTER_ITERATIONS);
+
+  return MUNIT_OK;
+}
+
+#endif /* defined(PSNIP_ENABLE_PTHREADS) */
+
+static MunitTest test_suite_tests[] = {
+  { (char*) "/counter/basic",   test_counter_basic,   NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+#if defined(PSNIP_ENABLE_PTHREADS)
+  { (char*) "/counter/threads", test_counter_threads, NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+#endif
+  { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
+};
+
+static const MunitSuite test_suite = {
+  (char*) "", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE
+};
+
+int main(int argc, char* argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
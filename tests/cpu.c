@@ -32,6 +32,45 @@ test_cpu_info(const MunitParameter params[], void* data) {
   return MUNIT_SKIP;
 }
 
+static MunitResult
+test_cpu_usable(const MunitParameter params[], void* data) {
+  static const enum PSnipCPUFeature features[] = {
+    PSNIP_CPU_FEATURE_X86_SSE2,
+    PSNIP_CPU_FEATURE_X86_AVX,
+    PSNIP_CPU_FEATURE_X86_AVX2,
+    PSNIP_CPU_FEATURE_X86_AVX512F,
+    PSNIP_CPU_FEATURE_X86_AVX512VPOPCNTDQ,
+    PSNIP_CPU_FEATURE_ARM_NEON
+  };
+  size_t i;
+
+  (void) params;
+  (void) data;
+
+  for (i = 0 ; i < sizeof(features) / sizeof(features[0]) ; i++)
+    if (psnip_cpu_feature_usable(features[i]))
+      munit_assert_int(psnip_cpu_feature_check(features[i]), ==, 1);
+
+  munit_assert_int(psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_SSE2), ==, psnip_cpu_feature_check(PSNIP_CPU_FEATURE_X86_SSE2));
+  if (psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX512F))
+    munit_assert_int(psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX), ==, 1);
+
+#if defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ > 7))
+#  if defined(PSNIP_CPU_ARCH_X86_64) || defined(PSNIP_CPU_ARCH_X86)
+  /* GCC checks XCR0 too. */
+  __builtin_cpu_init();
+
+  munit_assert_int(__builtin_cpu_supports("avx")     != 0, ==, psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX));
+  munit_assert_int(__builtin_cpu_supports("avx2")    != 0, ==, psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX2));
+#if __GNUC__ >= 5
+  munit_assert_int(__builtin_cpu_supports("avx512f") != 0, ==, psnip_cpu_feature_usable(PSNIP_CPU_FEATURE_X86_AVX512F));
+#endif
+#  endif
+#endif
+
+  return MUNIT_OK;
+}
+
 static MunitResult
 test_cpu_count(const MunitParameter params[], void* data) {
   (void) params;
@@ -42,9 +81,32 @@ test_cpu_count(const MunitParameter params[], void* data) {
   return MUNIT_OK;
 }
 
+static MunitResult
+test_cpu_cache_line(const MunitParameter params[], void* data) {
+  static struct {
+    char c;
+    PSNIP_CACHE_LINE_ALIGNED int aligned;
+  } s;
+
+  (void) params;
+  (void) data;
+
+  munit_assert_int(PSNIP_CACHE_LINE_SIZE, >=, 32);
+  munit_assert_int(PSNIP_CACHE_LINE_SIZE & (PSNIP_CACHE_LINE_SIZE - 1), ==, 0);
+#if defined(__GNUC__) || defined(_MSC_VER)
+  munit_assert_size(((size_t) &(s.aligned)) % PSNIP_CACHE_LINE_SIZE, ==, 0);
+#endif
+  s.c = 0;
+  s.aligned = 0;
+
+  return MUNIT_OK;
+}
+
 static MunitTest test_suite_tests[] = {
-  { (char*) "/cpu/info",  test_cpu_info,  NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
-  { (char*) "/cpu/count", test_cpu_count, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/cpu/info",       test_cpu_info,       NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/cpu/usable",     test_cpu_usable,     NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/cpu/count",      test_cpu_count,      NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/cpu/cache-line", test_cpu_cache_line, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
   { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
 };
 
@@ -1,5 +1,6 @@
 #if defined(PSNIP_ENABLE_PTHREADS)
 #  include <pthread.h>
+#  include <sched.h>
 #endif
 #include "../exact-int/exact-int.h"
 #include "../once/once.h"
@@ -29,10 +30,151 @@ test_once_basic(const MunitParameter params[], void* data) {
   return MUNIT_OK;
 }
 
-/* TODO: thread safety test. */
+static void test_once_ctx_init(void* ctx) {
+  int* times_called = (int*) ctx;
+  (*times_called)++;
+}
+
+static MunitResult
+test_once_ctx(const MunitParameter params[], void* data) {
+  psnip_once once;
+  int a = 0, b = 0;
+
+  (void) params;
+  (void) data;
+
+  psnip_once_init(&once);
+  psnip_once_call_ctx(&once, &test_once_ctx_init, &a);
+  psnip_once_call_ctx(&once, &test_once_ctx_init, &a);
+  psnip_once_call_ctx(&once, &test_once_ctx_init, &b);
+  munit_assert_int(a, ==, 1);
+  munit_assert_int(b, ==, 0);
+
+  /* Re-initializing lets it run again. */
+  psnip_once_init(&once);
+  psnip_once_call_ctx(&once, &test_once_ctx_init, &b);
+  munit_assert_int(a, ==, 1);
+  munit_assert_int(b, ==, 1);
+
+  return MUNIT_OK;
+}
+
+static void* test_once_lazy_create(void* ctx) {
+  int* times_called = (int*) ctx;
+  (*times_called)++;
+  return times_called;
+}
+
+static MunitResult
+test_once_lazy(const MunitParameter params[], void* data) {
+  static struct PsnipOnceLazy lazy = PSNIP_ONCE_LAZY_INIT;
+  struct PsnipOnceLazy dynamic;
+  int times_called = 0, other = 0;
+
+  (void) params;
+  (void) data;
+
+  munit_assert_ptr_equal(psnip_once_lazy_get(&lazy, &test_once_lazy_create, &times_called), &times_called);
+  munit_assert_ptr_equal(psnip_once_lazy_get(&lazy, &test_once_lazy_create, &times_called), &times_called);
+  munit_assert_ptr_equal(psnip_once_lazy_get(&lazy, &test_once_lazy_create, &other), &times_called);
+  munit_assert_int(times_called, ==, 1);
+  munit_assert_int(other, ==, 0);
+
+  psnip_once_lazy_init(&dynamic);
+  munit_assert_ptr_equal(psnip_once_lazy_get(&dynamic, &test_once_lazy_create, &other), &other);
+  munit_assert_ptr_equal(psnip_once_lazy_get(&dynamic, &test_once_lazy_create, &other), &other);
+  munit_assert_int(other, ==, 1);
+
+  return MUNIT_OK;
+}
+
+/* Fails until *ctx gets to 3. */
+static int test_once_fallible_init(void* ctx) {
+  int* attempts = (int*) ctx;
+  return (++(*attempts) < 3) ? -(*attempts) : 0;
+}
+
+static MunitResult
+test_once_fallible(const MunitParameter params[], void* data) {
+  static psnip_once_fallible once = PSNIP_ONCE_FALLIBLE_INIT;
+  psnip_once_fallible dynamic;
+  int attempts = 0;
+
+  (void) params;
+  (void) data;
+
+  munit_assert_int(psnip_once_fallible_call(&once, &test_once_fallible_init, &attempts), ==, -1);
+  munit_assert_int(psnip_once_fallible_call(&once, &test_once_fallible_init, &attempts), ==, -2);
+  munit_assert_int(psnip_once_fallible_call(&once, &test_once_fallible_init, &attempts), ==, 0);
+  munit_assert_int(psnip_once_fallible_call(&once, &test_once_fallible_init, &attempts), ==, 0);
+  munit_assert_int(attempts, ==, 3);
+
+  psnip_once_fallible_init(&dynamic);
+  attempts = 2;
+  munit_assert_int(psnip_once_fallible_call(&dynamic, &test_once_fallible_init, &attempts), ==, 0);
+  munit_assert_int(psnip_once_fallible_call(&dynamic, &test_once_fallible_init, &attempts), ==, 0);
+  munit_assert_int(attempts, ==, 3);
+
+  return MUNIT_OK;
+}
+
+#if defined(PSNIP_ENABLE_PTHREADS)
+
+#define ONCE_THREADS 8
+
+static psnip_once test_once_threads_once = PSNIP_ONCE_INIT;
+static psnip_atomic_int32 test_once_threads_times_called = PSNIP_ATOMIC_VAR_INIT(0);
+static int test_once_threads_value = 0;
+
+/* Slow enough that the other threads end up waiting for it. */
+static void test_once_threads_init(void) {
+  int i;
+
+  psnip_atomic_int32_fetch_add(&test_once_threads_times_called, 1);
+  for (i = 0 ; i < 100 ; i++)
+    sched_yield();
+  test_once_threads_value = 1729;
+}
+
+static void*
+test_once_threads_thread(void* arg) {
+  (void) arg;
+
+  psnip_once_call(&test_once_threads_once, &test_once_threads_init);
+  /* Whoever ran the initializer, its writes must be visible. */
+  munit_assert_int(test_once_threads_value, ==, 1729);
+
+  return NULL;
+}
+
+static MunitResult
+test_once_threads(const MunitParameter params[], void* data) {
+  pthread_t threads[ONCE_THREADS];
+  size_t i;
+
+  (void) params;
+  (void) data;
+
+  for (i = 0 ; i < ONCE_THREADS ; i++)
+    munit_assert_int(pthread_create(&(threads[i]), NULL, test_once_threads_thread, NULL), ==, 0);
+  for (i = 0 ; i < ONCE_THREADS ; i++)
+    pthread_join(threads[i], NULL);
+
+  munit_assert_int32(psnip_atomic_int32_load(&test_once_threads_times_called), ==, 1);
+
+  return MUNIT_OK;
+}
+
+#endif /* defined(PSNIP_ENABLE_PTHREADS) */
 
 static MunitTest test_suite_tests[] = {
   { (char*) "/once/basic", test_once_basic, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/once/ctx", test_once_ctx, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/once/lazy", test_once_lazy, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/once/fallible", test_once_fallible, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+#if defined(PSNIP_ENABLE_PTHREADS)
+  { (char*) "/once/threads", test_once_threads, NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+#endif
   { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
 };
 
@@ -0,0 +1,245 @@
+#if defined(PSNIP_ENABLE_PTHREADS)
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+#include "../exact-int/exact-int.h"
+#include "../ring/ring.h"
+#include "munit/munit.h"
+
+#define RING_CAPACITY 64
+
+static MunitResult
+test_ring_spsc_basic(const MunitParameter params[], void* data) {
+  void* buffer[RING_CAPACITY];
+  void* items[RING_CAPACITY + 8];
+  struct PsnipRingSPSC ring;
+  size_t i, j, n, next_in = 1, next_out = 1;
+  void* item;
+
+  (void) params;
+  (void) data;
+
+  munit_assert_int(psnip_ring_spsc_init(&ring, buffer, 48), ==, -1);
+  munit_assert_int(psnip_ring_spsc_init(&ring, buffer, RING_CAPACITY), ==, 0);
+  munit_assert_false(psnip_ring_spsc_dequeue(&ring, &item));
+
+  /* Fill it up. */
+  for (i = 0 ; i < RING_CAPACITY ; i++)
+    munit_assert_true(psnip_ring_spsc_enqueue(&ring, (void*) next_in++));
+  munit_assert_false(psnip_ring_spsc_enqueue(&ring, (void*) next_in));
+  munit_assert_size(psnip_ring_spsc_size(&ring), ==, RING_CAPACITY);
+
+  munit_assert_true(psnip_ring_spsc_dequeue(&ring, &item));
+  munit_assert_ptr_equal(item, (void*) next_out++);
+
+  /* Random batches, wrapping around many times. */
+  for (i = 0 ; i < 1000 ; i++) {
+    const size_t want_in = (size_t) munit_rand_int_range(0, RING_CAPACITY + 8);
+    const size_t want_out = (size_t) munit_rand_int_range(0, RING_CAPACITY + 8);
+    const size_t size = psnip_ring_spsc_size(&ring);
+
+    for (n = 0 ; n < want_in ; n++)
+      items[n] = (void*) (next_in + n);
+    n = psnip_ring_spsc_enqueue_batch(&ring, items, want_in);
+    munit_assert_size(n, ==, (want_in < RING_CAPACITY - size) ? want_in : RING_CAPACITY - size);
+    next_in += n;
+
+    n = psnip_ring_spsc_dequeue_batch(&ring, items, want_out);
+    munit_assert_size(n, <=, want_out);
+    munit_assert_size(n, ==, (want_out < next_in - next_out) ? want_out : next_in - next_out);
+    for (j = 0 ; j < n ; j++)
+      munit_assert_ptr_equal(items[j], (void*) next_out++);
+  }
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_ring_mpmc_basic(const MunitParameter params[], void* data) {
+  struct PsnipRingMPMCCell cells[RING_CAPACITY];
+  void* items[RING_CAPACITY + 8];
+  struct PsnipRingMPMC ring;
+  size_t i, j, n, next_in = 1, next_out = 1;
+  void* item;
+
+  (void) params;
+  (void) data;
+
+  munit_assert_int(psnip_ring_mpmc_init(&ring, cells, 0), ==, -1);
+  munit_assert_int(psnip_ring_mpmc_init(&ring, cells, RING_CAPACITY), ==, 0);
+  munit_assert_false(psnip_ring_mpmc_dequeue(&ring, &item));
+
+  for (i = 0 ; i < RING_CAPACITY ; i++)
+    munit_assert_true(psnip_ring_mpmc_enqueue(&ring, (void*) next_in++));
+  munit_assert_false(psnip_ring_mpmc_enqueue(&ring, (void*) next_in));
+
+  munit_assert_true(psnip_ring_mpmc_dequeue(&ring, &item));
+  munit_assert_ptr_equal(item, (void*) next_out++);
+
+  for (i = 0 ; i < 1000 ; i++) {
+    const size_t want_in = (size_t) munit_rand_int_range(0, RING_CAPACITY + 8);
+    const size_t want_out = (size_t) munit_rand_int_range(0, RING_CAPACITY + 8);
+    const size_t size = next_in - next_out;
+
+    for (n = 0 ; n < want_in ; n++)
+      items[n] = (void*) (next_in + n);
+    n = psnip_ring_mpmc_enqueue_batch(&ring, items, want_in);
+    munit_assert_size(n, ==, (want_in < RING_CAPACITY - size) ? want_in : RING_CAPACITY - size);
+    next_in += n;
+
+    n = psnip_ring_mpmc_dequeue_batch(&ring, items, want_out);
+    munit_assert_size(n, ==, (want_out < next_in - next_out) ? want_out : next_in - next_out);
+    for (j = 0 ; j < n ; j++)
+      munit_assert_ptr_equal(items[j], (void*) next_out++);
+  }
+
+  return MUNIT_OK;
+}
+
+#if defined(PSNIP_ENABLE_PTHREADS)
+
+#define RING_THREADS 4
+#define RING_MESSAGES 100000
+
+static struct PsnipRingSPSC spsc;
+static struct PsnipRingMPMC mpmc;
+static psnip_atomic_int64 mpmc_received_sum = PSNIP_ATOMIC_VAR_INIT(0);
+static psnip_atomic_int64 mpmc_received = PSNIP_ATOMIC_VAR_INIT(0);
+
+static void*
+spsc_producer(void* arg) {
+  void* items[16];
+  size_t next = 1, i, n;
+
+  (void) arg;
+
+  while (next <= RING_MESSAGES) {
+    n = (next % 16) + 1;
+    for (i = 0 ; i < n ; i++)
+      items[i] = (void*) (next + i);
+    if (next + n > RING_MESSAGES + 1)
+      n = RING_MESSAGES + 1 - next;
+    n = psnip_ring_spsc_enqueue_batch(&spsc, items, n);
+    if (n == 0)
+      sched_yield();
+    next += n;
+  }
+
+  return NULL;
+}
+
+static MunitResult
+test_ring_spsc_threads(const MunitParameter params[], void* data) {
+  void* buffer[RING_CAPACITY];
+  void* items[16];
+  pthread_t producer;
+  size_t expected = 1, i, n;
+
+  (void) params;
+  (void) data;
+
+  psnip_ring_spsc_init(&spsc, buffer, RING_CAPACITY);
+  munit_assert_int(pthread_create(&producer, NULL, spsc_producer, NULL), ==, 0);
+
+  /* Messages must come out in order, with nothing lost. */
+  while (expected <= RING_MESSAGES) {
+    n = psnip_ring_spsc_dequeue_batch(&spsc, items, 16);
+    if (n == 0)
+      sched_yield();
+    for (i = 0 ; i < n ; i++)
+      munit_assert_ptr_equal(items[i], (void*) expected++);
+  }
+
+  pthread_join(producer, NULL);
+  munit_assert_size(psnip_ring_spsc_size(&spsc), ==, 0);
+
+  return MUNIT_OK;
+}
+
+static void*
+mpmc_producer(void* arg) {
+  const size_t first = (size_t) arg;
+  size_t next = first;
+
+  while (next < first + RING_MESSAGES) {
+    if (psnip_ring_mpmc_enqueue(&mpmc, (void*) next))
+      next++;
+    else
+      sched_yield();
+  }
+
+  return NULL;
+}
+
+static void*
+mpmc_consumer(void* arg) {
+  void* items[8];
+  size_t i, n;
+
+  (void) arg;
+
+  while (psnip_atomic_int64_load(&mpmc_received) < (psnip_int64_t) RING_THREADS * RING_MESSAGES) {
+    n = psnip_ring_mpmc_dequeue_batch(&mpmc, items, 8);
+    if (n == 0)
+      sched_yield();
+    for (i = 0 ; i < n ; i++)
+      psnip_atomic_int64_fetch_add(&mpmc_received_sum, (psnip_int64_t) (size_t) items[i]);
+    psnip_atomic_int64_fetch_add(&mpmc_received, (psnip_int64_t) n);
+  }
+
+  return NULL;
+}
+
+static MunitResult
+test_ring_mpmc_threads(const MunitParameter params[], void* data) {
+  static struct PsnipRingMPMCCell cells[RING_CAPACITY];
+  pthread_t producers[RING_THREADS], consumers[RING_THREADS];
+  psnip_int64_t expected_sum = 0;
+  size_t i, j;
+
+  (void) params;
+  (void) data;
+
+  psnip_ring_mpmc_init(&mpmc, cells, RING_CAPACITY);
+  psnip_atomic_int64_store(&mpmc_received, 0);
+  psnip_atomic_int64_store(&mpmc_received_sum, 0);
+
+  for (i = 0 ; i < RING_THREADS ; i++) {
+    munit_assert_int(pthread_create(&(consumers[i]), NULL, mpmc_consumer, NULL), ==, 0);
+    munit_assert_int(pthread_create(&(producers[i]), NULL, mpmc_producer, (void*) (1 + i * RING_MESSAGES)), ==, 0);
+  }
+  for (i = 0 ; i < RING_THREADS ; i++) {
+    pthread_join(producers[i], NULL);
+    pthread_join(consumers[i], NULL);
+  }
+
+  /* Every message exactly once. */
+  for (i = 0 ; i < RING_THREADS ; i++)
+    for (j = 0 ; j < RING_MESSAGES ; j++)
+      expected_sum += (psnip_int64_t) (1 + i * RING_MESSAGES + j);
+
+  munit_assert_int64(psnip_atomic_int64_load(&mpmc_received), ==, (psnip_int64_t) RING_THREADS * RING_MESSAGES);
+  munit_assert_int64(psnip_atomic_int64_load(&mpmc_received_sum), ==, expected_sum);
+
+  return MUNIT_OK;
+}
+
+#endif /* defined(PSNIP_ENABLE_PTHREADS) */
+
+static MunitTest test_suite_tests[] = {
+  { (char*) "/ring/spsc/basic",   test_ring_spsc_basic,   NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/ring/mpmc/basic",   test_ring_mpmc_basic,   NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+#if defined(PSNIP_ENABLE_PTHREADS)
+  { (char*) "/ring/spsc/threads", test_ring_spsc_threads, NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/ring/mpmc/threads", test_ring_mpmc_threads, NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+#endif
+  { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
+};
+
+static const MunitSuite test_suite = {
+  (char*) "", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE
+};
+
+int main(int argc, char* argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
@@ -0,0 +1,157 @@
+#if defined(PSNIP_ENABLE_PTHREADS)
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+#include "../exact-int/exact-int.h"
+#include "../seqlock/seqlock.h"
+#include "munit/munit.h"
+
+/* Every field is derived from a, so a torn read is easy to spot. */
+struct SeqlockData {
+  psnip_int64_t a;
+  psnip_int64_t b;
+  psnip_int64_t c;
+  psnip_int64_t d;
+};
+
+static void
+seqlock_data_set(struct SeqlockData* data, psnip_int64_t a) {
+  data->a = a;
+  data->b = a * 2;
+  data->c = a * 3;
+  data->d = ~a;
+}
+
+static void
+seqlock_data_check(const struct SeqlockData* data) {
+  munit_assert_int64(data->b, ==, data->a * 2);
+  munit_assert_int64(data->c, ==, data->a * 3);
+  munit_assert_int64(data->d, ==, ~(data->a));
+}
+
+static MunitResult
+test_seqlock_basic(const MunitParameter params[], void* data) {
+  struct PsnipSeqlock lock;
+  struct SeqlockData shared, tmp;
+  psnip_int64_t seq;
+
+  (void) params;
+  (void) data;
+
+  psnip_seqlock_init(&lock);
+  seqlock_data_set(&shared, 0);
+
+  seqlock_data_set(&tmp, 42);
+  psnip_seqlock_write(&lock, &shared, &tmp, sizeof(tmp));
+  memset(&tmp, 0, sizeof(tmp));
+  psnip_seqlock_read(&lock, &tmp, &shared, sizeof(tmp));
+  munit_assert_int64(tmp.a, ==, 42);
+  seqlock_data_check(&tmp);
+
+  /* A read with no write in between doesn't need a retry... */
+  seq = psnip_seqlock_read_begin(&lock);
+  munit_assert_int64(seq & 1, ==, 0);
+  munit_assert_false(psnip_seqlock_read_retry(&lock, seq));
+
+  /* ... but one which overlaps a write does. */
+  seq = psnip_seqlock_read_begin(&lock);
+  psnip_seqlock_write_begin(&lock);
+  shared.a = 7;
+  munit_assert_true(psnip_seqlock_read_retry(&lock, seq));
+  psnip_seqlock_write_end(&lock);
+  munit_assert_true(psnip_seqlock_read_retry(&lock, seq));
+
+  return MUNIT_OK;
+}
+
+#if defined(PSNIP_ENABLE_PTHREADS)
+
+#define SEQLOCK_READERS 3
+#define SEQLOCK_WRITES 20000
+
+static struct PsnipSeqlock seqlock;
+static struct SeqlockData seqlock_shared;
+static psnip_atomic_int32 seqlock_done = PSNIP_ATOMIC_VAR_INIT(0);
+
+static void*
+seqlock_reader(void* arg) {
+  struct SeqlockData copy;
+  psnip_int64_t last = 0;
+
+  (void) arg;
+
+  while (psnip_atomic_int32_load(&seqlock_done) == 0) {
+    psnip_seqlock_read(&seqlock, &copy, &seqlock_shared, sizeof(copy));
+    seqlock_data_check(&copy);
+    /* There's only one writer, so values never go backwards. */
+    munit_assert_int64(copy.a, >=, last);
+    last = copy.a;
+    sched_yield();
+  }
+
+  return NULL;
+}
+
+static void*
+seqlock_writer(void* arg) {
+  psnip_int64_t i;
+
+  (void) arg;
+
+  for (i = 1 ; i <= SEQLOCK_WRITES ; i++) {
+    psnip_seqlock_write_begin(&seqlock);
+    seqlock_data_set(&seqlock_shared, i);
+    psnip_seqlock_write_end(&seqlock);
+    if ((i % 16) == 0)
+      sched_yield();
+  }
+
+  return NULL;
+}
+
+static MunitResult
+test_seqlock_threads(const MunitParameter params[], void* data) {
+  pthread_t readers[SEQLOCK_READERS], writer;
+  struct SeqlockData copy;
+  size_t i;
+
+  (void) params;
+  (void) data;
+
+  psnip_seqlock_init(&seqlock);
+  seqlock_data_set(&seqlock_shared, 0);
+  psnip_atomic_int32_store(&seqlock_done, 0);
+
+  for (i = 0 ; i < SEQLOCK_READERS ; i++)
+    munit_assert_int(pthread_create(&(readers[i]), NULL, seqlock_reader, NULL), ==, 0);
+  munit_assert_int(pthread_create(&writer, NULL, seqlock_writer, NULL), ==, 0);
+
+  pthread_join(writer, NULL);
+  psnip_atomic_int32_store(&seqlock_done, 1);
+  for (i = 0 ; i < SEQLOCK_READERS ; i++)
+    pthread_join(readers[i], NULL);
+
+  psnip_seqlock_read(&seqlock, &copy, &seqlock_shared, sizeof(copy));
+  munit_assert_int64(copy.a, ==, SEQLOCK_WRITES);
+  munit_assert_int64(psnip_atomic_int64_load(&(seqlock.sequence)), ==, (psnip_int64_t) SEQLOCK_WRITES * 2);
+
+  return MUNIT_OK;
+}
+
+#endif /* defined(PSNIP_ENABLE_PTHREADS) */
+
+static MunitTest test_suite_tests[] = {
+  { (char*) "/seqlock/basic",   test_seqlock_basic,   NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+#if defined(PSNIP_ENABLE_PTHREADS)
+  { (char*) "/seqlock/threads", test_seqlock_threads, NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+#endif
+  { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
+};
+
+static const MunitSuite test_suite = {
+  (char*) "", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE
+};
+
+int main(int argc, char* argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
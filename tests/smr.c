@@ -0,0 +1,242 @@
+#if defined(PSNIP_ENABLE_PTHREADS)
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+#include "../exact-int/exact-int.h"
+#include "../smr/smr.h"
+#include "munit/munit.h"
+
+#define SMR_ALIVE 0x600d
+#define SMR_DEAD  0xdead
+
+/* Objects are never really freed, just marked dead, so a reader which
+ * sees a dead object has caught the module freeing something too
+ * early. */
+struct SmrObject {
+  psnip_atomic_int32 magic;
+  struct PsnipSmrNode smr;
+};
+
+static psnip_atomic_int64 smr_freed = PSNIP_ATOMIC_VAR_INIT(0);
+
+static void
+smr_object_free(void* ptr) {
+  struct SmrObject* obj = (struct SmrObject*) ptr;
+
+  munit_assert_int32(psnip_atomic_int32_load(&(obj->magic)), ==, SMR_ALIVE);
+  psnip_atomic_int32_store(&(obj->magic), SMR_DEAD);
+  psnip_atomic_int64_fetch_add(&smr_freed, 1);
+}
+
+static MunitResult
+test_smr_epoch(const MunitParameter params[], void* data) {
+  static struct SmrObject objects[PSNIP_SMR_BATCH * 4];
+  struct PsnipSmrDomain domain;
+  struct PsnipSmrThread a, b;
+  size_t i;
+
+  (void) params;
+  (void) data;
+
+  psnip_atomic_int64_store(&smr_freed, 0);
+  psnip_smr_domain_init(&domain);
+  psnip_smr_register(&domain, &a);
+  psnip_smr_register(&domain, &b);
+
+  /* Nothing can be freed while b sits in a critical section. */
+  psnip_smr_enter(&b);
+  for (i = 0 ; i < PSNIP_SMR_BATCH * 2 ; i++) {
+    psnip_atomic_int32_store(&(objects[i].magic), SMR_ALIVE);
+    psnip_smr_retire(&a, &(objects[i].smr), &(objects[i]), smr_object_free);
+  }
+  psnip_smr_collect(&a);
+  psnip_smr_collect(&a);
+  munit_assert_int64(psnip_atomic_int64_load(&smr_freed), ==, 0);
+
+  /* Nested sections only end at the outermost exit. */
+  psnip_smr_enter(&b);
+  psnip_smr_exit(&b);
+  psnip_smr_collect(&a);
+  munit_assert_int64(psnip_atomic_int64_load(&smr_freed), ==, 0);
+  psnip_smr_exit(&b);
+
+  /* Two epochs later everything goes. */
+  psnip_smr_collect(&a);
+  psnip_smr_collect(&a);
+  psnip_smr_collect(&a);
+  munit_assert_int64(psnip_atomic_int64_load(&smr_freed), ==, PSNIP_SMR_BATCH * 2);
+
+  /* Unregistered records come back from recycle, and leftovers are
+   * freed when the domain is destroyed. */
+  for (i = PSNIP_SMR_BATCH * 2 ; i < PSNIP_SMR_BATCH * 2 + 10 ; i++) {
+    psnip_atomic_int32_store(&(objects[i].magic), SMR_ALIVE);
+    psnip_smr_retire(&b, &(objects[i].smr), &(objects[i]), smr_object_free);
+  }
+  munit_assert_null(psnip_smr_recycle(&domain));
+  psnip_smr_unregister(&b);
+  munit_assert_ptr_equal(psnip_smr_recycle(&domain), &b);
+  munit_assert_null(psnip_smr_recycle(&domain));
+
+  psnip_smr_domain_destroy(&domain);
+  munit_assert_int64(psnip_atomic_int64_load(&smr_freed), ==, PSNIP_SMR_BATCH * 2 + 10);
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_smr_hazard(const MunitParameter params[], void* data) {
+  static struct SmrObject object;
+  struct PsnipSmrDomain domain;
+  struct PsnipSmrThread a, b;
+  psnip_atomic_ptr source;
+  int i;
+
+  (void) params;
+  (void) data;
+
+  psnip_atomic_int64_store(&smr_freed, 0);
+  psnip_smr_domain_init(&domain);
+  psnip_smr_register(&domain, &a);
+  psnip_smr_register(&domain, &b);
+
+  psnip_atomic_int32_store(&(object.magic), SMR_ALIVE);
+  psnip_atomic_ptr_store(&source, &object);
+  munit_assert_ptr_equal(psnip_smr_protect(&b, 1, &source), &object);
+
+  /* b isn't in a critical section, so the epoch moves along, but the
+   * hazard pointer keeps the object alive. */
+  psnip_atomic_ptr_store(&source, NULL);
+  psnip_smr_retire(&a, &(object.smr), &object, smr_object_free);
+  for (i = 0 ; i < 4 ; i++)
+    psnip_smr_collect(&a);
+  munit_assert_int64(psnip_atomic_int64_load(&smr_freed), ==, 0);
+
+  psnip_smr_clear(&b, 1);
+  psnip_smr_collect(&a);
+  munit_assert_int64(psnip_atomic_int64_load(&smr_freed), ==, 1);
+
+  return MUNIT_OK;
+}
+
+#if defined(PSNIP_ENABLE_PTHREADS)
+
+#define SMR_READERS 3
+#define SMR_UPDATES 20000
+
+static struct SmrObject smr_pool[SMR_UPDATES + 1];
+static struct PsnipSmrDomain smr_domain;
+static psnip_atomic_ptr smr_current;
+static psnip_atomic_int32 smr_done = PSNIP_ATOMIC_VAR_INIT(0);
+
+static void*
+smr_reader(void* arg) {
+  const int use_hazards = (arg != NULL);
+  struct PsnipSmrThread* thread = psnip_smr_recycle(&smr_domain);
+  struct SmrObject* obj;
+  int i;
+
+  munit_assert_not_null(thread);
+
+  while (psnip_atomic_int32_load(&smr_done) == 0) {
+    if (use_hazards) {
+      obj = (struct SmrObject*) psnip_smr_protect(thread, 0, &smr_current);
+      for (i = 0 ; i < 8 ; i++)
+        munit_assert_int32(psnip_atomic_int32_load_explicit(&(obj->magic), PSNIP_ATOMIC_ORDER_RELAXED), ==, SMR_ALIVE);
+      psnip_smr_clear(thread, 0);
+    } else {
+      psnip_smr_enter(thread);
+      obj = (struct SmrObject*) psnip_atomic_ptr_load_explicit(&smr_current, PSNIP_ATOMIC_ORDER_ACQUIRE);
+      for (i = 0 ; i < 8 ; i++)
+        munit_assert_int32(psnip_atomic_int32_load_explicit(&(obj->magic), PSNIP_ATOMIC_ORDER_RELAXED), ==, SMR_ALIVE);
+      psnip_smr_exit(thread);
+    }
+    sched_yield();
+  }
+
+  psnip_smr_unregister(thread);
+  return NULL;
+}
+
+static void
+smr_run_threads(int use_hazards) {
+  static struct PsnipSmrThread records[SMR_READERS + 1];
+  pthread_t readers[SMR_READERS];
+  struct SmrObject* old;
+  size_t i;
+
+  psnip_atomic_int64_store(&smr_freed, 0);
+  psnip_atomic_int32_store(&smr_done, 0);
+  psnip_smr_domain_init(&smr_domain);
+  for (i = 0 ; i < SMR_READERS + 1 ; i++) {
+    psnip_smr_register(&smr_domain, &(records[i]));
+    if (i != 0)
+      psnip_smr_unregister(&(records[i]));
+  }
+
+  for (i = 0 ; i < SMR_UPDATES + 1 ; i++)
+    psnip_atomic_int32_store(&(smr_pool[i].magic), SMR_ALIVE);
+  psnip_atomic_ptr_store(&smr_current, &(smr_pool[0]));
+
+  for (i = 0 ; i < SMR_READERS ; i++)
+    munit_assert_int(pthread_create(&(readers[i]), NULL, smr_reader, use_hazards ? (void*) &smr_pool : NULL), ==, 0);
+
+  /* Swap in a new object over and over, retiring the old one. */
+  for (i = 1 ; i < SMR_UPDATES + 1 ; i++) {
+    old = (struct SmrObject*) psnip_atomic_ptr_exchange(&smr_current, &(smr_pool[i]));
+    psnip_smr_retire(&(records[0]), &(old->smr), old, smr_object_free);
+    if ((i % 64) == 0)
+      sched_yield();
+  }
+
+  psnip_atomic_int32_store(&smr_done, 1);
+  for (i = 0 ; i < SMR_READERS ; i++)
+    pthread_join(readers[i], NULL);
+
+  /* With the readers gone everything but the current object is
+   * reclaimable. */
+  psnip_smr_collect(&(records[0]));
+  psnip_smr_collect(&(records[0]));
+  psnip_smr_collect(&(records[0]));
+  munit_assert_int64(psnip_atomic_int64_load(&smr_freed), ==, SMR_UPDATES);
+  munit_assert_int32(psnip_atomic_int32_load(&(smr_pool[SMR_UPDATES].magic)), ==, SMR_ALIVE);
+}
+
+static MunitResult
+test_smr_epoch_threads(const MunitParameter params[], void* data) {
+  (void) params;
+  (void) data;
+
+  smr_run_threads(0);
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_smr_hazard_threads(const MunitParameter params[], void* data) {
+  (void) params;
+  (void) data;
+
+  smr_run_threads(1);
+
+  return MUNIT_OK;
+}
+
+#endif /* defined(PSNIP_ENABLE_PTHREADS) */
+
+static MunitTest test_suite_tests[] = {
+  { (char*) "/smr/epoch",          test_smr_epoch,          NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/smr/hazard",         test_smr_hazard,         NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+#if defined(PSNIP_ENABLE_PTHREADS)
+  { (char*) "/smr/epoch/threads",  test_smr_epoch_threads,  NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/smr/hazard/threads", test_smr_hazard_threads, NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+#endif
+  { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
+};
+
+static const MunitSuite test_suite = {
+  (char*) "", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE
+};
+
+int main(int argc, char* argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
@@ -0,0 +1,255 @@
+#if defined(PSNIP_ENABLE_PTHREADS)
+#  include <pthread.h>
+#endif
+#include "../exact-int/exact-int.h"
+#include "../spinlock/spinlock.h"
+#include "munit/munit.h"
+
+static MunitResult
+test_spinlock_spinlock_basic(const MunitParameter params[], void* data) {
+  struct PsnipSpinlock lock;
+  struct PsnipSpinlockStats stats;
+
+  (void) params;
+  (void) data;
+
+  psnip_spinlock_init(&lock);
+  munit_assert_true(psnip_spinlock_trylock(&lock));
+  munit_assert_false(psnip_spinlock_trylock(&lock));
+  psnip_spinlock_unlock(&lock);
+
+  psnip_spinlock_lock(&lock);
+  munit_assert_false(psnip_spinlock_trylock(&lock));
+  psnip_spinlock_unlock(&lock);
+
+  psnip_spinlock_stats(&lock, &stats);
+#if !defined(PSNIP_SPINLOCK_NO_STATS)
+  munit_assert_int64(stats.acquisitions, ==, 2);
+#endif
+  munit_assert_int64(stats.contended, ==, 0);
+  munit_assert_int64(stats.spins, ==, 0);
+  munit_assert_int64(stats.sleeps, ==, 0);
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_spinlock_ticket_basic(const MunitParameter params[], void* data) {
+  struct PsnipSpinlockTicket lock;
+  struct PsnipSpinlockStats stats;
+  int i;
+
+  (void) params;
+  (void) data;
+
+  psnip_spinlock_ticket_init(&lock);
+  munit_assert_true(psnip_spinlock_ticket_trylock(&lock));
+  munit_assert_false(psnip_spinlock_ticket_trylock(&lock));
+  psnip_spinlock_ticket_unlock(&lock);
+
+  for (i = 0 ; i < 100 ; i++) {
+    psnip_spinlock_ticket_lock(&lock);
+    munit_assert_false(psnip_spinlock_ticket_trylock(&lock));
+    psnip_spinlock_ticket_unlock(&lock);
+  }
+
+  /* The tickets have to survive wrapping around. */
+  psnip_atomic_int32_store(&(lock.next), munit_rand_int_range(0x7ffffff0, 0x7fffffff));
+  psnip_atomic_int32_store(&(lock.serving), psnip_atomic_int32_load(&(lock.next)));
+  for (i = 0 ; i < 32 ; i++) {
+    psnip_spinlock_ticket_lock(&lock);
+    psnip_spinlock_ticket_unlock(&lock);
+    munit_assert_true(psnip_spinlock_ticket_trylock(&lock));
+    psnip_spinlock_ticket_unlock(&lock);
+  }
+
+  psnip_spinlock_ticket_stats(&lock, &stats);
+#if !defined(PSNIP_SPINLOCK_NO_STATS)
+  munit_assert_int64(stats.acquisitions, ==, 1 + 100 + 64);
+#endif
+  munit_assert_int64(stats.contended, ==, 0);
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_spinlock_mutex_basic(const MunitParameter params[], void* data) {
+  struct PsnipSpinlockMutex mutex;
+  struct PsnipSpinlockStats stats;
+
+  (void) params;
+  (void) data;
+
+  psnip_spinlock_mutex_init(&mutex);
+  munit_assert_true(psnip_spinlock_mutex_trylock(&mutex));
+  munit_assert_false(psnip_spinlock_mutex_trylock(&mutex));
+  psnip_spinlock_mutex_unlock(&mutex);
+
+  psnip_spinlock_mutex_lock(&mutex);
+  munit_assert_false(psnip_spinlock_mutex_trylock(&mutex));
+  psnip_spinlock_mutex_unlock(&mutex);
+  munit_assert_int32(psnip_atomic_int32_load(&(mutex.state)), ==, 0);
+
+  psnip_spinlock_mutex_stats(&mutex, &stats);
+#if !defined(PSNIP_SPINLOCK_NO_STATS)
+  munit_assert_int64(stats.acquisitions, ==, 2);
+#endif
+  munit_assert_int64(stats.contended, ==, 0);
+
+  return MUNIT_OK;
+}
+
+#if defined(PSNIP_ENABLE_PTHREADS)
+
+#define SPINLOCK_THREADS 4
+#define SPINLOCK_ITERATIONS 20000
+
+/* Each thread increments a plain counter with the lock held; if the
+ * lock works none of the increments get lost. */
+static struct PsnipSpinlock spinlock;
+static struct PsnipSpinlockTicket ticket;
+static struct PsnipSpinlockMutex mutex;
+static psnip_int64_t counter = 0;
+
+static void*
+spinlock_thread(void* arg) {
+  int i;
+
+  (void) arg;
+
+  for (i = 0 ; i < SPINLOCK_ITERATIONS ; i++) {
+    psnip_spinlock_lock(&spinlock);
+    counter++;
+    psnip_spinlock_unlock(&spinlock);
+  }
+
+  return NULL;
+}
+
+static void*
+ticket_thread(void* arg) {
+  int i;
+
+  (void) arg;
+
+  for (i = 0 ; i < SPINLOCK_ITERATIONS ; i++) {
+    psnip_spinlock_ticket_lock(&ticket);
+    counter++;
+    psnip_spinlock_ticket_unlock(&ticket);
+  }
+
+  return NULL;
+}
+
+static void*
+mutex_thread(void* arg) {
+  int i;
+
+  (void) arg;
+
+  for (i = 0 ; i < SPINLOCK_ITERATIONS ; i++) {
+    psnip_spinlock_mutex_lock(&mutex);
+    counter++;
+    psnip_spinlock_mutex_unlock(&mutex);
+  }
+
+  return NULL;
+}
+
+static void
+run_threads(void* (*func)(void*)) {
+  pthread_t threads[SPINLOCK_THREADS];
+  size_t i;
+
+  counter = 0;
+  for (i = 0 ; i < SPINLOCK_THREADS ; i++)
+    munit_assert_int(pthread_create(&(threads[i]), NULL, func, NULL), ==, 0);
+  for (i = 0 ; i < SPINLOCK_THREADS ; i++)
+    pthread_join(threads[i], NULL);
+
+  munit_assert_int64(counter, ==, (psnip_int64_t) SPINLOCK_THREADS * SPINLOCK_ITERATIONS);
+}
+
+static void
+check_stats(const struct PsnipSpinlockStats* stats) {
+#if !defined(PSNIP_SPINLOCK_NO_STATS)
+  munit_assert_int64(stats->acquisitions, ==, (psnip_int64_t) SPINLOCK_THREADS * SPINLOCK_ITERATIONS);
+  munit_assert_int64(stats->contended, <=, stats->acquisitions);
+  if (stats->contended == 0) {
+    munit_assert_int64(stats->spins, ==, 0);
+    munit_assert_int64(stats->sleeps, ==, 0);
+  } else {
+    munit_assert_int64(stats->spins + stats->sleeps, >=, stats->contended);
+  }
+#else
+  (void) stats;
+#endif
+}
+
+static MunitResult
+test_spinlock_spinlock_threads(const MunitParameter params[], void* data) {
+  struct PsnipSpinlockStats stats;
+
+  (void) params;
+  (void) data;
+
+  psnip_spinlock_init(&spinlock);
+  run_threads(spinlock_thread);
+  psnip_spinlock_stats(&spinlock, &stats);
+  check_stats(&stats);
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_spinlock_ticket_threads(const MunitParameter params[], void* data) {
+  struct PsnipSpinlockStats stats;
+
+  (void) params;
+  (void) data;
+
+  psnip_spinlock_ticket_init(&ticket);
+  run_threads(ticket_thread);
+  psnip_spinlock_ticket_stats(&ticket, &stats);
+  check_stats(&stats);
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_spinlock_mutex_threads(const MunitParameter params[], void* data) {
+  struct PsnipSpinlockStats stats;
+
+  (void) params;
+  (void) data;
+
+  psnip_spinlock_mutex_init(&mutex);
+  run_threads(mutex_thread);
+  munit_assert_int32(psnip_atomic_int32_load(&(mutex.state)), ==, 0);
+  psnip_spinlock_mutex_stats(&mutex, &stats);
+  check_stats(&stats);
+
+  return MUNIT_OK;
+}
+
+#endif /* defined(PSNIP_ENABLE_PTHREADS) */
+
+static MunitTest test_suite_tests[] = {
+  { (char*) "/spinlock/spinlock/basic",   test_spinlock_spinlock_basic,   NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/spinlock/ticket/basic",     test_spinlock_ticket_basic,     NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/spinlock/mutex/basic",      test_spinlock_mutex_basic,      NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+#if defined(PSNIP_ENABLE_PTHREADS)
+  { (char*) "/spinlock/spinlock/threads", test_spinlock_spinlock_threads, NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/spinlock/ticket/threads",   test_spinlock_ticket_threads,   NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/spinlock/mutex/threads",    test_spinlock_mutex_threads,    NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+#endif
+  { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
+};
+
+static const MunitSuite test_suite = {
+  (char*) "", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE
+};
+
+int main(int argc, char* argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
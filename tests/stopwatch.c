@@ -0,0 +1,130 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "../exact-int/exact-int.h"
+#include "../stopwatch/stopwatch.h"
+#include "munit/munit.h"
+
+#if !defined(_WIN32)
+#  include <time.h>
+#  define sleep_msec(n) do { struct timespec ts_ = { 0, (n) * 1000000L }; nanosleep(&ts_, NULL); } while (0)
+#else
+#  include <Windows.h>
+#  define sleep_msec(n) Sleep(n)
+#endif
+
+static MunitResult
+test_stopwatch_elapsed(const MunitParameter params[], void* data) {
+#if defined(PSNIP_CLOCK_MONOTONIC_METHOD)
+  struct PsnipStopwatch sw;
+  psnip_uint64_t elapsed, lap;
+
+  (void) params;
+  (void) data;
+
+  munit_assert_int(psnip_stopwatch_start(&sw), ==, 0);
+  sleep_msec(100);
+  elapsed = psnip_stopwatch_elapsed(&sw);
+
+  munit_assert_uint64(elapsed, >,   90 * 1000000ULL);
+  munit_assert_uint64(elapsed, <,  250 * 1000000ULL);
+
+  lap = psnip_stopwatch_lap(&sw);
+  munit_assert_uint64(lap, >=, elapsed);
+  munit_assert_uint64(psnip_stopwatch_elapsed(&sw), <, lap);
+
+  return MUNIT_OK;
+#else
+  (void) params;
+  (void) data;
+
+  return MUNIT_SKIP;
+#endif
+}
+
+static MunitResult
+test_stopwatch_histogram_buckets(const MunitParameter params[], void* data) {
+  psnip_uint64_t v;
+  unsigned int i, prev = 0;
+
+  (void) params;
+  (void) data;
+
+  /* Small values are exact. */
+  for (v = 0 ; v < 2 * PSNIP_STOPWATCH_HISTOGRAM_SUB_BUCKETS ; v++) {
+    munit_assert_uint(psnip_stopwatch_histogram__index(v), ==, (unsigned int) v);
+    munit_assert_uint64(psnip_stopwatch_histogram__upper_bound((unsigned int) v), ==, v);
+  }
+
+  /* Indices never decrease, and every value is within its bucket. */
+  for (i = 0 ; i < 4096 ; i++) {
+    munit_rand_memory(sizeof(v), (psnip_uint8_t*) &v);
+    v >>= munit_rand_int_range(0, 63);
+
+    prev = psnip_stopwatch_histogram__index(v);
+    munit_assert_uint(prev, <, PSNIP_STOPWATCH_HISTOGRAM_BUCKETS);
+    munit_assert_uint64(psnip_stopwatch_histogram__upper_bound(prev), >=, v);
+    munit_assert_uint64(psnip_stopwatch_histogram__upper_bound(prev) - v, <=, v / PSNIP_STOPWATCH_HISTOGRAM_SUB_BUCKETS);
+    if (v != 0)
+      munit_assert_uint(psnip_stopwatch_histogram__index(v - 1), <=, prev);
+  }
+
+  munit_assert_uint(psnip_stopwatch_histogram__index(~((psnip_uint64_t) 0)), ==, PSNIP_STOPWATCH_HISTOGRAM_BUCKETS - 1);
+  munit_assert_uint64(psnip_stopwatch_histogram__upper_bound(PSNIP_STOPWATCH_HISTOGRAM_BUCKETS - 1), ==, ~((psnip_uint64_t) 0));
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_stopwatch_histogram_percentile(const MunitParameter params[], void* data) {
+  static struct PsnipStopwatchHistogram a, b;
+  psnip_uint64_t v, p;
+
+  (void) params;
+  (void) data;
+
+  psnip_stopwatch_histogram_reset(&a);
+  psnip_stopwatch_histogram_reset(&b);
+
+  munit_assert_uint64(psnip_stopwatch_histogram_percentile(&a, 50.0), ==, 0);
+
+  /* Split 1 - 10000 between two histograms, then merge. */
+  for (v = 1 ; v <= 10000 ; v++)
+    psnip_stopwatch_histogram_record((v % 2) ? &a : &b, v);
+  psnip_stopwatch_histogram_merge(&a, &b);
+
+  munit_assert_uint64(a.count, ==, 10000);
+  munit_assert_uint64(a.min, ==, 1);
+  munit_assert_uint64(a.max, ==, 10000);
+  munit_assert_double(psnip_stopwatch_histogram_mean(&a), ==, 5000.5);
+
+  munit_assert_uint64(psnip_stopwatch_histogram_percentile(&a,   0.0), ==,     1);
+  munit_assert_uint64(psnip_stopwatch_histogram_percentile(&a, 100.0), ==, 10000);
+
+  p = psnip_stopwatch_histogram_percentile(&a, 50.0);
+  munit_assert_uint64(p, >=, 5000);
+  munit_assert_uint64(p, <=, 5000 + (5000 / PSNIP_STOPWATCH_HISTOGRAM_SUB_BUCKETS));
+
+  p = psnip_stopwatch_histogram_percentile(&a, 99.0);
+  munit_assert_uint64(p, >=, 9900);
+  munit_assert_uint64(p, <=, 10000);
+
+  p = psnip_stopwatch_histogram_percentile(&a, 0.01);
+  munit_assert_uint64(p, ==, 1);
+
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+  { (char*) "/stopwatch/elapsed",              test_stopwatch_elapsed,              NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { (char*) "/stopwatch/histogram/buckets",    test_stopwatch_histogram_buckets,    NULL, NULL, MUNIT_TEST_OPTION_NONE,             NULL },
+  { (char*) "/stopwatch/histogram/percentile", test_stopwatch_histogram_percentile, NULL, NULL, MUNIT_TEST_OPTION_SINGLE_ITERATION, NULL },
+  { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
+};
+
+static const MunitSuite test_suite = {
+  (char*) "", test_suite_tests, NULL, 16, MUNIT_SUITE_OPTION_NONE
+};
+
+int main(int argc, char* argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
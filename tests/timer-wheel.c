@@ -0,0 +1,172 @@
+/* Use fewer levels than the default so timers beyond the wheel's
+ * range are easy to exercise. */
+#define PSNIP_TIMER_WHEEL_LEVELS 3
+
+#include "../exact-int/exact-int.h"
+#include "../timer-wheel/timer-wheel.h"
+#include "munit/munit.h"
+
+#define TICK_NS 1000
+
+struct Timer {
+  struct PsnipTimerWheelNode node;
+  psnip_uint64_t deadline;
+  int fired;
+};
+
+static struct Timer*
+timer_from_node (struct PsnipTimerWheelNode* node) {
+  return (struct Timer*) (((char*) node) - offsetof(struct Timer, node));
+}
+
+static MunitResult
+test_timer_wheel_expire(const MunitParameter params[], void* data) {
+  static struct Timer timers[2048];
+  struct PsnipTimerWheel wheel;
+  struct PsnipTimerWheelNode* expired;
+  struct PsnipTimerWheelNode* node;
+  struct Timer* timer;
+  psnip_uint64_t now = 0, prev, fired = 0;
+  size_t i, n;
+
+  (void) params;
+  (void) data;
+
+  psnip_timer_wheel_init(&wheel, TICK_NS, now);
+
+  /* The wheel covers 2^18 ticks; go well past that. */
+  for (i = 0 ; i < (sizeof(timers) / sizeof(timers[0])) ; i++) {
+    psnip_timer_wheel_node_init(&(timers[i].node));
+    timers[i].deadline = (psnip_uint64_t) munit_rand_int_range(0, 1 << 20) * (TICK_NS / 4);
+    timers[i].fired = 0;
+    psnip_timer_wheel_insert(&wheel, &(timers[i].node), timers[i].deadline);
+    munit_assert_true(psnip_timer_wheel_node_pending(&(timers[i].node)));
+  }
+  munit_assert_uint64(wheel.count, ==, sizeof(timers) / sizeof(timers[0]));
+
+  while (wheel.count != 0) {
+    prev = now;
+    now += (psnip_uint64_t) munit_rand_int_range(0, 4096) * (TICK_NS / 2);
+
+    n = psnip_timer_wheel_advance(&wheel, now, &expired);
+    for (i = 0, node = expired ; node != NULL ; node = node->next, i++) {
+      timer = timer_from_node(node);
+      munit_assert_false(psnip_timer_wheel_node_pending(node));
+      munit_assert_int(timer->fired, ==, 0);
+      timer->fired = 1;
+
+      /* Never early, and at most a tick late. */
+      munit_assert_uint64(timer->deadline, <=, now);
+      munit_assert_uint64(timer->deadline + TICK_NS, >, prev);
+    }
+    munit_assert_size(i, ==, n);
+    fired += n;
+  }
+
+  munit_assert_uint64(fired, ==, sizeof(timers) / sizeof(timers[0]));
+  munit_assert_uint64(psnip_timer_wheel_next_expiry(&wheel), ==, PSNIP_TIMER_WHEEL_NEVER);
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_timer_wheel_exact(const MunitParameter params[], void* data) {
+  static struct Timer timers[512];
+  struct PsnipTimerWheel wheel;
+  struct PsnipTimerWheelNode* expired;
+  psnip_uint64_t now;
+  size_t i;
+
+  (void) params;
+  (void) data;
+
+  psnip_timer_wheel_init(&wheel, TICK_NS, 12345 * TICK_NS);
+
+  for (i = 0 ; i < (sizeof(timers) / sizeof(timers[0])) ; i++) {
+    psnip_timer_wheel_node_init(&(timers[i].node));
+    timers[i].deadline = (12345 + (psnip_uint64_t) munit_rand_int_range(1, 1 << 19)) * TICK_NS;
+    psnip_timer_wheel_insert(&wheel, &(timers[i].node), timers[i].deadline);
+  }
+
+  /* Jump straight to each deadline in turn; the timer must fire
+   * exactly then, and not a tick earlier. */
+  while (wheel.count != 0) {
+    now = psnip_timer_wheel_next_expiry(&wheel);
+    munit_assert_uint64(now, !=, PSNIP_TIMER_WHEEL_NEVER);
+
+    if (psnip_timer_wheel_advance(&wheel, now - 1, &expired) != 0)
+      munit_errorf("timer fired early (%" PRIu64 ")", timer_from_node(expired)->deadline);
+
+    psnip_timer_wheel_advance(&wheel, now, &expired);
+    for ( ; expired != NULL ; expired = expired->next)
+      munit_assert_uint64(timer_from_node(expired)->deadline, ==, now);
+  }
+
+  return MUNIT_OK;
+}
+
+static MunitResult
+test_timer_wheel_cancel(const MunitParameter params[], void* data) {
+  static struct Timer timers[1024];
+  struct PsnipTimerWheel wheel;
+  struct PsnipTimerWheelNode* expired;
+  struct PsnipTimerWheelNode* next;
+  size_t i, n = 0;
+
+  (void) params;
+  (void) data;
+
+  psnip_timer_wheel_init(&wheel, TICK_NS, 0);
+
+  for (i = 0 ; i < (sizeof(timers) / sizeof(timers[0])) ; i++) {
+    psnip_timer_wheel_node_init(&(timers[i].node));
+    timers[i].fired = 0;
+    psnip_timer_wheel_insert(&wheel, &(timers[i].node), (psnip_uint64_t) munit_rand_int_range(1, 1 << 16) * TICK_NS);
+  }
+
+  /* Cancel the odd timers, and reschedule some even ones. */
+  for (i = 0 ; i < (sizeof(timers) / sizeof(timers[0])) ; i++) {
+    if (i % 2)
+      munit_assert_int(psnip_timer_wheel_cancel(&wheel, &(timers[i].node)), ==, 1);
+    else if (i % 3 == 0)
+      psnip_timer_wheel_insert(&wheel, &(timers[i].node), (psnip_uint64_t) munit_rand_int_range(1, 1 << 16) * TICK_NS);
+  }
+  munit_assert_int(psnip_timer_wheel_cancel(&wheel, &(timers[1].node)), ==, 0);
+  munit_assert_uint64(wheel.count, ==, sizeof(timers) / sizeof(timers[0]) / 2);
+
+  /* Re-arm timers from the expiry loop; they should fire once more. */
+  psnip_timer_wheel_advance(&wheel, (1 << 16) * TICK_NS, &expired);
+  for ( ; expired != NULL ; expired = next) {
+    next = expired->next;
+    timer_from_node(expired)->fired++;
+    psnip_timer_wheel_insert(&wheel, expired, (1 << 17) * TICK_NS);
+  }
+  munit_assert_uint64(wheel.count, ==, sizeof(timers) / sizeof(timers[0]) / 2);
+
+  n += psnip_timer_wheel_advance(&wheel, (1 << 17) * TICK_NS, &expired);
+  for ( ; expired != NULL ; expired = expired->next)
+    timer_from_node(expired)->fired++;
+  munit_assert_size(n, ==, sizeof(timers) / sizeof(timers[0]) / 2);
+
+  for (i = 0 ; i < (sizeof(timers) / sizeof(timers[0])) ; i++)
+    munit_assert_int(timers[i].fired, ==, (i % 2) ? 0 : 2);
+
+  munit_assert_uint64(wheel.count, ==, 0);
+
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+  { (char*) "/timer-wheel/expire", test_timer_wheel_expire, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/timer-wheel/exact",  test_timer_wheel_exact,  NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { (char*) "/timer-wheel/cancel", test_timer_wheel_cancel, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+  { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
+};
+
+static const MunitSuite test_suite = {
+  (char*) "", test_suite_tests, NULL, 16, MUNIT_SUITE_OPTION_NONE
+};
+
+int main(int argc, char* argv[MUNIT_ARRAY_PARAM(argc + 1)]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
@@ -0,0 +1,332 @@
+/* Hierarchical timer wheel (v1)
+ * Portable Snippets - https://github.com/nemequ/portable-snippets
+ * Created by Evan Nemerson <evan@nemerson.com>
+ *
+ *   To the extent possible under law, the authors have waived all
+ *   copyright and related or neighboring rights to this code.  For
+ *   details, see the Creative Commons Zero 1.0 Universal license at
+ *   https://creativecommons.org/publicdomain/zero/1.0/
+ *
+ * A timer wheel keeps track of a large number of timeouts (think one
+ * per connection) where most are cancelled or rescheduled before they
+ * ever fire.  Inserting and cancelling a timer are O(1), as is
+ * expiring a tick's worth of timers, compared to O(log n) for a heap.
+ *
+ * The wheel has PSNIP_TIMER_WHEEL_LEVELS levels of 64 slots each.
+ * Level 0 holds timers due within the next 64 ticks, one slot per
+ * tick; each level above covers 64 times the range of the one below,
+ * and its timers are moved ("cascaded") down a level as the wheel
+ * reaches them.  Occupancy bitmaps let the wheel skip over empty
+ * stretches, so advancing after a long idle period is cheap too.
+ *
+ * Timers are intrusive: embed a struct PsnipTimerWheelNode in your
+ * own structure, so the wheel never allocates.  Time is supplied by
+ * the caller as nanoseconds from any clock which doesn't go
+ * backwards (such as psnip_clock_get_time_ns with the monotonic
+ * clock), so you can drive the wheel from an existing event loop.
+ *
+ * A wheel isn't thread-safe.
+ */
+
+#if !defined(PSNIP_TIMER_WHEEL_H)
+#define PSNIP_TIMER_WHEEL_H
+
+#if !defined(PSNIP_CLOCK_H)
+#  include "../clock/clock.h"
+#endif
+
+#if !defined(PSNIP_BUILTIN_H)
+#  include "../builtin/builtin.h"
+#endif
+
+#include <string.h>
+
+#if !defined(PSNIP_TIMER_WHEEL_STATIC_INLINE)
+#  if defined(__GNUC__)
+#    define PSNIP_TIMER_WHEEL__COMPILER_ATTRIBUTES __attribute__((__unused__))
+#  else
+#    define PSNIP_TIMER_WHEEL__COMPILER_ATTRIBUTES
+#  endif
+
+#  if defined(HEDLEY_INLINE)
+#    define PSNIP_TIMER_WHEEL__INLINE HEDLEY_INLINE
+#  elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#    define PSNIP_TIMER_WHEEL__INLINE inline
+#  elif defined(__GNUC_STDC_INLINE__)
+#    define PSNIP_TIMER_WHEEL__INLINE __inline__
+#  elif defined(_MSC_VER) && _MSC_VER >= 1200
+#    define PSNIP_TIMER_WHEEL__INLINE __inline
+#  else
+#    define PSNIP_TIMER_WHEEL__INLINE
+#  endif
+
+#  define PSNIP_TIMER_WHEEL__FUNCTION PSNIP_TIMER_WHEEL__COMPILER_ATTRIBUTES static PSNIP_TIMER_WHEEL__INLINE
+#endif
+
+/* With the default of 6 levels the wheel covers 2^36 ticks (a bit
+ * over two years with 1 ms ticks).  Timers further out than that are
+ * parked in the top level and re-evaluated each time it comes
+ * around, so they still fire at the right time. */
+#if !defined(PSNIP_TIMER_WHEEL_LEVELS)
+#  define PSNIP_TIMER_WHEEL_LEVELS 6
+#endif
+
+#define PSNIP_TIMER_WHEEL_SLOT_BITS 6
+#define PSNIP_TIMER_WHEEL_SLOTS (1 << PSNIP_TIMER_WHEEL_SLOT_BITS)
+#define PSNIP_TIMER_WHEEL__SLOT_MASK ((psnip_uint64_t) (PSNIP_TIMER_WHEEL_SLOTS - 1))
+#define PSNIP_TIMER_WHEEL__RANGE (((psnip_uint64_t) 1) << (PSNIP_TIMER_WHEEL_SLOT_BITS * PSNIP_TIMER_WHEEL_LEVELS))
+
+#define PSNIP_TIMER_WHEEL_NEVER (~((psnip_uint64_t) 0))
+
+struct PsnipTimerWheelNode {
+  struct PsnipTimerWheelNode* next;
+  /* Points at whatever points at us (the slot head, or the previous
+   * node's next), or NULL if the timer isn't pending. */
+  struct PsnipTimerWheelNode** pprev;
+  /* Tick at which the timer expires. */
+  psnip_uint64_t expires;
+  unsigned char level;
+  unsigned char slot;
+};
+
+struct PsnipTimerWheel {
+  /* Length of a tick, in nanoseconds. */
+  psnip_uint64_t tick_ns;
+  /* Last tick which has been processed. */
+  psnip_uint64_t now;
+  /* Number of pending timers. */
+  psnip_uint64_t count;
+  psnip_uint64_t occupied[PSNIP_TIMER_WHEEL_LEVELS];
+  struct PsnipTimerWheelNode* slots[PSNIP_TIMER_WHEEL_LEVELS][PSNIP_TIMER_WHEEL_SLOTS];
+};
+
+/* Initialize a wheel with the given tick length, starting at now_ns.
+ * Timers are rounded up to a whole tick, so they never fire early,
+ * but may fire up to one tick late. */
+PSNIP_TIMER_WHEEL__FUNCTION void
+psnip_timer_wheel_init (struct PsnipTimerWheel* wheel, psnip_uint64_t tick_ns, psnip_uint64_t now_ns) {
+  assert(wheel != NULL);
+  assert(tick_ns != 0);
+
+  memset(wheel, 0, sizeof(*wheel));
+  wheel->tick_ns = tick_ns;
+  wheel->now = now_ns / tick_ns;
+}
+
+PSNIP_TIMER_WHEEL__FUNCTION void
+psnip_timer_wheel_node_init (struct PsnipTimerWheelNode* node) {
+  node->next = NULL;
+  node->pprev = NULL;
+  node->expires = 0;
+  node->level = 0;
+  node->slot = 0;
+}
+
+/* Non-zero if the timer is waiting to fire. */
+PSNIP_TIMER_WHEEL__FUNCTION int
+psnip_timer_wheel_node_pending (const struct PsnipTimerWheelNode* node) {
+  return node->pprev != NULL;
+}
+
+PSNIP_TIMER_WHEEL__FUNCTION void
+psnip_timer_wheel__link (struct PsnipTimerWheel* wheel, struct PsnipTimerWheelNode* node) {
+  psnip_uint64_t delta, effective = node->expires;
+  struct PsnipTimerWheelNode** head;
+  unsigned int level = 0, slot;
+
+  /* Cascading passes in timers which are due right now, which go in
+   * the current level 0 slot; it's processed right after. */
+  if (effective < wheel->now)
+    effective = wheel->now;
+
+  delta = effective - wheel->now;
+  if (delta >= PSNIP_TIMER_WHEEL__RANGE) {
+    delta = PSNIP_TIMER_WHEEL__RANGE - 1;
+    effective = wheel->now + delta;
+  }
+
+  if (delta >= PSNIP_TIMER_WHEEL_SLOTS)
+    level = (unsigned int) (63 - psnip_builtin_clz64(delta)) / PSNIP_TIMER_WHEEL_SLOT_BITS;
+  slot = (unsigned int) ((effective >> (level * PSNIP_TIMER_WHEEL_SLOT_BITS)) & PSNIP_TIMER_WHEEL__SLOT_MASK);
+
+  head = &(wheel->slots[level][slot]);
+  node->next = *head;
+  if (node->next != NULL)
+    node->next->pprev = &(node->next);
+  node->pprev = head;
+  *head = node;
+
+  node->level = (unsigned char) level;
+  node->slot = (unsigned char) slot;
+  wheel->occupied[level] |= ((psnip_uint64_t) 1) << slot;
+}
+
+PSNIP_TIMER_WHEEL__FUNCTION void
+psnip_timer_wheel__unlink (struct PsnipTimerWheel* wheel, struct PsnipTimerWheelNode* node) {
+  *(node->pprev) = node->next;
+  if (node->next != NULL)
+    node->next->pprev = node->pprev;
+
+  if (wheel->slots[node->level][node->slot] == NULL)
+    wheel->occupied[node->level] &= ~(((psnip_uint64_t) 1) << node->slot);
+
+  node->next = NULL;
+  node->pprev = NULL;
+}
+
+/* Cancel a pending timer.  Returns 1 if the timer was pending, or 0
+ * if it had already fired (or was never scheduled). */
+PSNIP_TIMER_WHEEL__FUNCTION int
+psnip_timer_wheel_cancel (struct PsnipTimerWheel* wheel, struct PsnipTimerWheelNode* node) {
+  assert(wheel != NULL);
+  assert(node != NULL);
+
+  if (node->pprev == NULL)
+    return 0;
+
+  psnip_timer_wheel__unlink (wheel, node);
+  wheel->count--;
+
+  return 1;
+}
+
+/* Schedule a timer to fire once the wheel reaches expires_ns.  If the
+ * timer is already pending it is rescheduled.  Deadlines which have
+ * already passed fire on the next call to psnip_timer_wheel_advance. */
+PSNIP_TIMER_WHEEL__FUNCTION void
+psnip_timer_wheel_insert (struct PsnipTimerWheel* wheel, struct PsnipTimerWheelNode* node, psnip_uint64_t expires_ns) {
+  psnip_uint64_t expires;
+
+  assert(wheel != NULL);
+  assert(node != NULL);
+
+  psnip_timer_wheel_cancel (wheel, node);
+
+  expires = (expires_ns / wheel->tick_ns) + (((expires_ns % wheel->tick_ns) != 0) ? 1 : 0);
+  if (expires <= wheel->now)
+    expires = wheel->now + 1;
+
+  node->expires = expires;
+  psnip_timer_wheel__link (wheel, node);
+  wheel->count++;
+}
+
+/* The next tick at which the wheel has something to do (either fire
+ * timers or cascade them to a lower level), or
+ * PSNIP_TIMER_WHEEL_NEVER if it's empty. */
+PSNIP_TIMER_WHEEL__FUNCTION psnip_uint64_t
+psnip_timer_wheel__next_tick (const struct PsnipTimerWheel* wheel) {
+  const psnip_uint64_t tick = wheel->now + 1;
+  psnip_uint64_t pending, boundary;
+  unsigned int level;
+
+  if (wheel->occupied[0] != 0) {
+    pending = psnip_intrin_rotr64(wheel->occupied[0], (int) (tick & PSNIP_TIMER_WHEEL__SLOT_MASK));
+    boundary = (wheel->now | PSNIP_TIMER_WHEEL__SLOT_MASK) + 1;
+    return ((tick + (psnip_uint64_t) psnip_builtin_ctz64(pending)) < boundary) ?
+      (tick + (psnip_uint64_t) psnip_builtin_ctz64(pending)) : boundary;
+  }
+
+  /* Nothing is due in the next 64 ticks, so we can skip ahead to the
+   * next time the lowest occupied level cascades. */
+  for (level = 1 ; level < PSNIP_TIMER_WHEEL_LEVELS ; level++) {
+    if (wheel->occupied[level] != 0)
+      return ((wheel->now >> (level * PSNIP_TIMER_WHEEL_SLOT_BITS)) + 1) << (level * PSNIP_TIMER_WHEEL_SLOT_BITS);
+  }
+
+  return PSNIP_TIMER_WHEEL_NEVER;
+}
+
+/* Earliest time (in nanoseconds) at which psnip_timer_wheel_advance
+ * might have work to do, or PSNIP_TIMER_WHEEL_NEVER if there are no
+ * pending timers.  This is a lower bound, suitable for computing a
+ * poll timeout; when no timer is due within 64 ticks it may just be
+ * the next time timers need to be cascaded. */
+PSNIP_TIMER_WHEEL__FUNCTION psnip_uint64_t
+psnip_timer_wheel_next_expiry (const struct PsnipTimerWheel* wheel) {
+  const psnip_uint64_t tick = psnip_timer_wheel__next_tick (wheel);
+
+  return (tick == PSNIP_TIMER_WHEEL_NEVER) ? PSNIP_TIMER_WHEEL_NEVER : (tick * wheel->tick_ns);
+}
+
+/* Advance the wheel to now_ns, removing every timer which has expired
+ * and appending them to *expired (linked through their next members,
+ * roughly in order of expiry).  Expired timers are no longer pending,
+ * so it's safe to reschedule them while walking the list as long as
+ * you read next first.  Returns the number of expired timers. */
+PSNIP_TIMER_WHEEL__FUNCTION size_t
+psnip_timer_wheel_advance (struct PsnipTimerWheel* wheel, psnip_uint64_t now_ns, struct PsnipTimerWheelNode** expired) {
+  const psnip_uint64_t target = now_ns / wheel->tick_ns;
+  struct PsnipTimerWheelNode** tail = expired;
+  struct PsnipTimerWheelNode* node;
+  struct PsnipTimerWheelNode* next;
+  psnip_uint64_t tick;
+  unsigned int level, slot;
+  size_t n = 0;
+
+  assert(wheel != NULL);
+  assert(expired != NULL);
+
+  *expired = NULL;
+
+  while (wheel->now < target) {
+    tick = psnip_timer_wheel__next_tick (wheel);
+    if (tick > target) {
+      wheel->now = target;
+      break;
+    }
+    wheel->now = tick;
+
+    /* Cascade any higher levels which have come around. */
+    for (level = 1 ; level < PSNIP_TIMER_WHEEL_LEVELS ; level++) {
+      if ((tick & ((((psnip_uint64_t) 1) << (level * PSNIP_TIMER_WHEEL_SLOT_BITS)) - 1)) != 0)
+        break;
+
+      slot = (unsigned int) ((tick >> (level * PSNIP_TIMER_WHEEL_SLOT_BITS)) & PSNIP_TIMER_WHEEL__SLOT_MASK);
+      node = wheel->slots[level][slot];
+      wheel->slots[level][slot] = NULL;
+      wheel->occupied[level] &= ~(((psnip_uint64_t) 1) << slot);
+
+      for ( ; node != NULL ; node = next) {
+        next = node->next;
+        psnip_timer_wheel__link (wheel, node);
+      }
+    }
+
+    slot = (unsigned int) (tick & PSNIP_TIMER_WHEEL__SLOT_MASK);
+    node = wheel->slots[0][slot];
+    if (node == NULL)
+      continue;
+    wheel->slots[0][slot] = NULL;
+    wheel->occupied[0] &= ~(((psnip_uint64_t) 1) << slot);
+
+    for ( ; node != NULL ; node = next) {
+      next = node->next;
+      node->next = NULL;
+      node->pprev = NULL;
+      *tail = node;
+      tail = &(node->next);
+      n++;
+    }
+  }
+
+  wheel->count -= n;
+
+  return n;
+}
+
+/* Like psnip_timer_wheel_advance, but reads the monotonic clock for
+ * you.  Returns 0 if the clock isn't available. */
+PSNIP_TIMER_WHEEL__FUNCTION size_t
+psnip_timer_wheel_poll (struct PsnipTimerWheel* wheel, struct PsnipTimerWheelNode** expired) {
+  psnip_uint64_t now;
+
+  if (psnip_clock_get_time_ns (PSNIP_CLOCK_TYPE_MONOTONIC, &now) != 0) {
+    *expired = NULL;
+    return 0;
+  }
+
+  return psnip_timer_wheel_advance (wheel, now, expired);
+}
+
+#endif /* !defined(PSNIP_TIMER_WHEEL_H) */